@@ -0,0 +1,166 @@
+// Microbenchmark: ThreadSafeQueue (mutex + condition_variable) so với BoundedRingQueue dưới tải MPMC.
+// Mỗi lần chạy P producer đẩy tổng cộng N item, C consumer lấy hết; kiểm tra checksum để chắc không mất / lặp item.
+// Bulk: producer push_bulk / consumer pop_bulk theo lô (ThreadSafeQueue không có bulk nên chỉ đo push / try_pop).
+//
+//   ./queue_bench [items] [capacity] [bulk]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ThreadSafeQueue.h"
+#include "BoundedRingQueue.h"
+
+namespace {
+
+struct RunResult {
+    double seconds = 0;
+    bool ok = false;
+};
+
+// Item i của producer p mang giá trị p * items + i + 1 (khác 0) → tổng cố định
+uint64_t expectedSum(uint64_t totalItems) { return totalItems * (totalItems + 1) / 2; }
+
+template<typename Queue, typename ProduceFn, typename ConsumeFn>
+RunResult runOnce(Queue& queue, size_t producers, size_t consumers, uint64_t totalItems,
+                  ProduceFn produce, ConsumeFn consume) {
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+
+    const uint64_t perProducer = totalItems / producers;
+    for (size_t p = 0; p < producers; ++p) {
+        const uint64_t first = p * perProducer + 1;
+        const uint64_t last = p + 1 == producers ? totalItems : first + perProducer - 1;
+        threads.emplace_back([&, first, last] {
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            produce(queue, first, last);
+        });
+    }
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.emplace_back([&] {
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            uint64_t localSum = 0;
+            consume(queue, consumed, totalItems, localSum);
+            sum.fetch_add(localSum, std::memory_order_relaxed);
+        });
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto& t : threads) t.join();
+    const auto end = std::chrono::steady_clock::now();
+
+    RunResult result;
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+    result.ok = consumed.load() == totalItems && sum.load() == expectedSum(totalItems);
+    return result;
+}
+
+// Consumer dừng khi đã lấy đủ totalItems (timeout ngắn để thoát nhanh khi consumer khác lấy item cuối)
+template<typename Queue>
+void consumeSingle(Queue& queue, std::atomic<uint64_t>& consumed, uint64_t totalItems, uint64_t& localSum) {
+    uint64_t value = 0;
+    while (consumed.load(std::memory_order_relaxed) < totalItems) {
+        if (queue.try_pop(value, std::chrono::milliseconds(1))) {
+            localSum += value;
+            consumed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename Queue>
+void produceSingle(Queue& queue, uint64_t first, uint64_t last) {
+    for (uint64_t v = first; v <= last; ++v) queue.push(uint64_t(v));
+}
+
+struct Scenario {
+    const char* name;
+    size_t producers;
+    size_t consumers;
+};
+
+template<typename Fn>
+double bestOf(int repeats, Fn run, bool& ok) {
+    double best = 1e30;
+    for (int i = 0; i < repeats; ++i) {
+        RunResult r = run();
+        ok = ok && r.ok;
+        best = std::min(best, r.seconds);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint64_t items = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    const size_t capacity = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1024;
+    const size_t bulk = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 32;
+    const int repeats = 3;
+
+    const Scenario scenarios[] = {
+        {"1P/1C", 1, 1},
+        {"1P/8C", 1, 8},
+        {"4P/4C", 4, 4},
+        {"8P/8C", 8, 8},
+    };
+
+    std::printf("items=%llu capacity=%zu bulk=%zu hw_threads=%u (best of %d, Mitems/s)\n",
+                static_cast<unsigned long long>(items), capacity, bulk, std::thread::hardware_concurrency(), repeats);
+    std::printf("%-8s %16s %16s %16s\n", "threads", "ThreadSafeQueue", "Ring push/pop", "Ring bulk");
+
+    bool allOk = true;
+    for (const auto& s : scenarios) {
+        const double tsq = bestOf(repeats, [&] {
+            ThreadSafeQueue<uint64_t> queue(capacity);
+            return runOnce(queue, s.producers, s.consumers, items,
+                           produceSingle<ThreadSafeQueue<uint64_t>>, consumeSingle<ThreadSafeQueue<uint64_t>>);
+        }, allOk);
+
+        const double ring = bestOf(repeats, [&] {
+            BoundedRingQueue<uint64_t> queue(capacity);
+            return runOnce(queue, s.producers, s.consumers, items,
+                           produceSingle<BoundedRingQueue<uint64_t>>, consumeSingle<BoundedRingQueue<uint64_t>>);
+        }, allOk);
+
+        const double ringBulk = bestOf(repeats, [&] {
+            BoundedRingQueue<uint64_t> queue(capacity);
+            auto produce = [bulk](BoundedRingQueue<uint64_t>& q, uint64_t first, uint64_t last) {
+                std::vector<uint64_t> chunk;
+                chunk.reserve(bulk);
+                for (uint64_t v = first; v <= last; ++v) {
+                    chunk.push_back(v);
+                    if (chunk.size() == bulk) q.push_bulk(chunk);
+                }
+                if (!chunk.empty()) q.push_bulk(chunk);
+            };
+            auto consume = [bulk](BoundedRingQueue<uint64_t>& q, std::atomic<uint64_t>& consumed,
+                                  uint64_t totalItems, uint64_t& localSum) {
+                std::vector<uint64_t> out;
+                out.reserve(bulk);
+                while (consumed.load(std::memory_order_relaxed) < totalItems) {
+                    out.clear();
+                    const size_t n = q.pop_bulk(out, bulk, std::chrono::milliseconds(1));
+                    for (uint64_t v : out) localSum += v;
+                    if (n > 0) consumed.fetch_add(n, std::memory_order_relaxed);
+                }
+            };
+            return runOnce(queue, s.producers, s.consumers, items, produce, consume);
+        }, allOk);
+
+        const double mitems = static_cast<double>(items) / 1e6;
+        std::printf("%-8s %16.2f %16.2f %16.2f\n", s.name, mitems / tsq, mitems / ring, mitems / ringBulk);
+    }
+
+    if (!allOk) {
+        std::fprintf(stderr, "checksum mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -9,6 +9,8 @@
 #include "../db/oracle/OracleConnector.h"
 #include "../db/postgresql/PostgreSQLConnector.h"
 #include "../initialload/InitialLoaderOracleToPostgreSQL.h"
+#include "../utils/SQLUtils.h"
+#include <algorithm>
 
 
 std::unique_ptr<AppComponents> AppInitializer::initialize(const std::string& configPath) {
@@ -93,6 +95,8 @@ std::unique_ptr<AppComponents> AppInitializer::initialize(const std::string& con
         components->processor->addFilter(f);
     }
     components->processor->enableISODebugLog = components->config->getBool("debug_iso_log", false);
+    SQLUtils::setUTF8RepairPolicy(SQLUtils::parseUTF8RepairPolicy(
+        components->config->getConfig("utf8_repair_policy", "replace")));
     components->processor->setActiveDbType(dbType);
     
     // Initial Load from Oracle to PostgreSQL
@@ -154,6 +158,32 @@ std::unique_ptr<AppComponents> AppInitializer::initialize(const std::string& con
 
     // WriteDataToDB and register DBConnector factory
     components->writeData = std::make_unique<WriteDataToDB>();
+    {
+        // Pool connection cho DB writer: idle tối thiểu đủ cho mọi writer để warm-up / reconnect không phải handshake lại
+        const ConfigLoader& cfg = *components->config;
+        ConnectionPool::Options poolOptions;
+        const int numDBWriters = cfg.getInt("num_db_writers", 1);
+        poolOptions.maxIdle = static_cast<size_t>(std::max({cfg.getInt("db_pool.max_idle", 8), numDBWriters, 1}));
+        poolOptions.maxTotal = static_cast<size_t>(std::max(cfg.getInt("db_pool.max_total", 0), 0));
+        poolOptions.healthCheckIntervalSec = std::max(cfg.getInt("db_pool.health_check_interval_sec", 30), 1);
+        poolOptions.idleTimeoutSec = std::max(cfg.getInt("db_pool.idle_timeout_sec", 300), 0);
+        poolOptions.checkoutTimeoutMs = std::max(cfg.getInt("db_pool.checkout_timeout_ms", 30000), 0);
+        components->writeData->setConnectionPoolOptions(poolOptions);
+
+        // Lỗi tạm thời (failover, timeout): ghi lại với backoff; lỗi liên tiếp → circuit breaker OPEN, pause consumer
+        WriteDataToDB::RetryOptions retryOptions;
+        retryOptions.baseDelayMs = std::max(cfg.getInt("db_retry.base_delay_ms", 100), 1);
+        retryOptions.maxDelayMs = std::max(cfg.getInt("db_retry.max_delay_ms", 10000), retryOptions.baseDelayMs);
+        retryOptions.maxAttempts = std::max(cfg.getInt("db_retry.max_attempts", 0), 0);
+        components->writeData->setRetryOptions(retryOptions);
+
+        CircuitBreaker::Options breakerOptions;
+        breakerOptions.failureThreshold = std::max(cfg.getInt("circuit_breaker.failure_threshold", 5), 1);
+        breakerOptions.probeIntervalMs = std::max(cfg.getInt("circuit_breaker.probe_interval_ms", 1000), 1);
+        breakerOptions.maxProbeIntervalMs = std::max(cfg.getInt("circuit_breaker.max_probe_interval_ms", 30000),
+                                                     breakerOptions.probeIntervalMs);
+        components->writeData->setCircuitBreakerOptions(breakerOptions);
+    }
     if (dbType == "oracle") {
         components->writeData->addDatabaseConnectorFactory("oracle", [config = components->config.get()]() {
             return std::make_unique<OracleConnector>(
@@ -166,13 +196,18 @@ std::unique_ptr<AppComponents> AppInitializer::initialize(const std::string& con
         });
     } else if (dbType == "postgresql") {
         components->writeData->addDatabaseConnectorFactory("postgresql", [config = components->config.get()]() {
-            return std::make_unique<PostgreSQLConnector>(
+            auto connector = std::make_unique<PostgreSQLConnector>(
                 config->getDBConfig("postgresql", "host"),
                 std::stoi(config->getDBConfig("postgresql", "port")),
                 config->getDBConfig("postgresql", "user"),
                 config->getDBConfig("postgresql", "password"),
                 config->getDBConfig("postgresql", "dbname")
             );
+            // Batch gửi trong một round trip (libpq pipeline mode)
+            connector->setPipelineEnabled(config->getBool("pg_pipeline", true));
+            // Row lỗi bỏ qua được chỉ làm chạy lại tối đa pg_savepoint_interval statement thay vì cả batch
+            connector->setSavepointInterval(static_cast<size_t>(std::max(config->getInt("pg_savepoint_interval", 100), 0)));
+            return connector;
         });
     }
 
@@ -2,11 +2,87 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <rapidjson/document.h>
+
+// FK tới bảng cha: giá trị các cột columns (bảng con) = PK của parentOwner.parentTable
+struct ForeignKeyRef {
+    std::vector<std::string> columns;
+    std::string parentOwner;
+    std::string parentTable;
+};
 
 struct FilterEntry {
     std::string owner;
     std::string table;
-    std::string primaryKey;
+    // Một hoặc nhiều cột khóa (composite PK), theo thứ tự khai báo
+    std::vector<std::string> primaryKey;
     std::string pkIndex;
-};
+    // "insert" (mặc định) hoặc "upsert": op=c được apply bằng MERGE / ON CONFLICT thay vì INSERT
+    std::string applyMode = "insert";
+    // Chỉ dùng cho apply song song (apply_dependency_tracking): row con phải apply sau row cha
+    std::vector<ForeignKeyRef> foreignKeys;
+    // "auto" (mặc định): quarantine khi batch lỗi liên tiếp; "on": giữ mọi batch của bảng ra file hold
+    // (bảo trì bảng đích); "off": không bao giờ quarantine. Đổi bằng hot reload filter config
+    std::string quarantine = "auto";
+
+    bool isUpsert() const { return applyMode == "upsert"; }
+    bool hasPrimaryKey() const { return !primaryKey.empty(); }
 
+    // "primaryKey": "A" | "A,B" | ["A", "B"]
+    static std::vector<std::string> parsePrimaryKey(const rapidjson::Value& value) {
+        std::vector<std::string> keys;
+        auto addKey = [&keys](const std::string& raw) {
+            size_t begin = raw.find_first_not_of(" \t");
+            size_t end = raw.find_last_not_of(" \t");
+            if (begin != std::string::npos) keys.push_back(raw.substr(begin, end - begin + 1));
+        };
+
+        if (value.IsArray()) {
+            for (const auto& col : value.GetArray()) {
+                if (col.IsString()) addKey(col.GetString());
+            }
+        } else if (value.IsString()) {
+            const std::string text = value.GetString();
+            size_t start = 0;
+            while (start <= text.size()) {
+                size_t comma = text.find(',', start);
+                if (comma == std::string::npos) comma = text.size();
+                addKey(text.substr(start, comma - start));
+                start = comma + 1;
+            }
+        }
+        return keys;
+    }
+
+    // "foreignKeys": [{ "columns": "A" | "A,B" | ["A", "B"], "references": "OWNER.TABLE" }]
+    static std::vector<ForeignKeyRef> parseForeignKeys(const rapidjson::Value& value) {
+        std::vector<ForeignKeyRef> refs;
+        if (!value.IsArray()) return refs;
+        for (const auto& item : value.GetArray()) {
+            if (!item.IsObject() || !item.HasMember("columns") || !item.HasMember("references") ||
+                !item["references"].IsString()) {
+                continue;
+            }
+            ForeignKeyRef ref;
+            ref.columns = parsePrimaryKey(item["columns"]);
+            const std::string target = item["references"].GetString();
+            const size_t dot = target.find('.');
+            if (ref.columns.empty() || dot == std::string::npos) continue;
+            ref.parentOwner = target.substr(0, dot);
+            ref.parentTable = target.substr(dot + 1);
+            refs.push_back(std::move(ref));
+        }
+        return refs;
+    }
+
+    // "A, B" để log / DDL
+    static std::string joinKeys(const std::vector<std::string>& keys, const std::string& delimiter = ", ") {
+        std::string out;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (i) out += delimiter;
+            out += keys[i];
+        }
+        return out;
+    }
+};
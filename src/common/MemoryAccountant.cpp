@@ -0,0 +1,126 @@
+#include "MemoryAccountant.h"
+#include "../metrics/MetricsExporter.h"
+#include "../logger/Logger.h"
+#include <algorithm>
+
+MemoryAccountant& MemoryAccountant::getInstance() {
+    static MemoryAccountant instance;
+    return instance;
+}
+
+void MemoryAccountant::configure(size_t budget, int pausePercent, int resumePercent) {
+    pausePercent = std::clamp(pausePercent, 1, 100);
+    resumePercent = std::clamp(resumePercent, 0, pausePercent);
+
+    budgetBytes.store(budget, std::memory_order_relaxed);
+    pauseBytes.store(budget / 100 * static_cast<size_t>(pausePercent), std::memory_order_relaxed);
+    resumeBytes.store(budget / 100 * static_cast<size_t>(resumePercent), std::memory_order_relaxed);
+
+    if (budget > 0) {
+        OpenSync::Logger::info("🧮 Memory budget: " + std::to_string(budget / (1024 * 1024)) + " MB (pause at " +
+                               std::to_string(pausePercent) + "%, resume at " + std::to_string(resumePercent) + "%)");
+    }
+}
+
+void MemoryAccountant::release(Component component, size_t bytes) {
+    if (!bytes) return;
+    // Không để counter underflow nếu charge / release lệch nhau
+    size_t current = used[component].load(std::memory_order_relaxed);
+    size_t next;
+    do {
+        next = current > bytes ? current - bytes : 0;
+    } while (!used[component].compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+size_t MemoryAccountant::totalUsage() const {
+    size_t total = 0;
+    for (const auto& counter : used) total += counter.load(std::memory_order_relaxed);
+    return total;
+}
+
+size_t MemoryAccountant::pipelineUsage() const {
+    size_t total = 0;
+    for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+        if (i != BATCH_POOL) total += used[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+bool MemoryAccountant::shouldPause() {
+    const size_t budget = budgetBytes.load(std::memory_order_relaxed);
+    if (budget == 0) return false;
+
+    const size_t total = pipelineUsage();
+    bool isPaused = paused.load(std::memory_order_relaxed);
+    if (!isPaused && total >= pauseBytes.load(std::memory_order_relaxed)) {
+        paused.store(true, std::memory_order_relaxed);
+        MetricsExporter::getInstance().incrementCounter("memory_budget_pauses_total");
+        OpenSync::Logger::warn("⏸️ Memory budget reached (" + std::to_string(total / (1024 * 1024)) + " / " +
+                               std::to_string(budget / (1024 * 1024)) + " MB), pausing Kafka consumption");
+        isPaused = true;
+    } else if (isPaused && total <= resumeBytes.load(std::memory_order_relaxed)) {
+        paused.store(false, std::memory_order_relaxed);
+        OpenSync::Logger::info("▶️ Memory back to " + std::to_string(total / (1024 * 1024)) +
+                               " MB, resuming Kafka consumption");
+        isPaused = false;
+    }
+    return isPaused;
+}
+
+void MemoryAccountant::trackMessage(rd_kafka_message_t* msg) {
+    if (msg) charge(KAFKA_INFLIGHT, msg->len);
+}
+
+void MemoryAccountant::addMessageRefs(rd_kafka_message_t* msg, int refs) {
+    if (!msg || refs <= 0) return;
+    std::lock_guard<std::mutex> lock(refsMutex);
+    shared[msg].extraRefs += refs;
+}
+
+bool MemoryAccountant::dropReference(rd_kafka_message_t* msg, bool& success) {
+    std::lock_guard<std::mutex> lock(refsMutex);
+    auto it = shared.find(msg);
+    if (it == shared.end()) return true;
+
+    if (it->second.extraRefs > 0) {
+        if (!success) it->second.failed = true;
+        --it->second.extraRefs;
+        return false;
+    }
+    success = success && !it->second.failed;
+    shared.erase(it);
+    return true;
+}
+
+bool MemoryAccountant::detachMessage(rd_kafka_message_t* msg) {
+    {
+        std::lock_guard<std::mutex> lock(refsMutex);
+        if (shared.count(msg)) return false;
+    }
+    release(KAFKA_INFLIGHT, msg->len);
+    rd_kafka_message_destroy(msg);
+    return true;
+}
+
+const char* MemoryAccountant::componentName(Component component) {
+    switch (component) {
+        case KAFKA_INFLIGHT: return "kafka_inflight";
+        case KAFKA_QUEUE:    return "kafka_queue";
+        case PARSED_DOCS:    return "parsed_docs";
+        case SQL_PENDING:    return "sql_pending";
+        case APPLY_QUEUE:    return "apply_queue";
+        case BATCH_POOL:     return "batch_pool";
+        default:             return "unknown";
+    }
+}
+
+void MemoryAccountant::reportMetrics() const {
+    auto& metrics = MetricsExporter::getInstance();
+    for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+        const auto component = static_cast<Component>(i);
+        metrics.setGauge("memory_usage_bytes", static_cast<double>(usage(component)), {{"component", componentName(component)}});
+    }
+    metrics.setGauge("memory_accounted_bytes", static_cast<double>(totalUsage()), {});
+    metrics.setGauge("memory_budget_bytes", static_cast<double>(budget()), {});
+    metrics.setGauge("kafka_consumption_paused", paused.load(std::memory_order_relaxed) ? 1.0 : 0.0, {});
+}
@@ -0,0 +1,105 @@
+#ifndef MEMORY_ACCOUNTANT_H
+#define MEMORY_ACCOUNTANT_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <librdkafka/rdkafka.h>
+
+// Ngân sách bộ nhớ theo byte cho toàn pipeline: mỗi stage charge / release số byte đang giữ
+// (Kafka payload, message chờ worker, JSON đã parse, SQL đang gom batch, task chờ DB writer).
+// Consumer pause partition khi tổng vượt mức cao và resume khi xuống dưới mức thấp (hysteresis),
+// thay vì chờ RSS vượt ngưỡng rồi mới shrink như MonitorManager.
+class MemoryAccountant {
+public:
+    enum Component : size_t {
+        KAFKA_INFLIGHT = 0,   // payload rd_kafka_message_t giữ tới khi commit offset
+        KAFKA_QUEUE,          // bản copy message trong kafkaMessageQueue
+        PARSED_DOCS,          // rapidjson Document worker đang xử lý
+        SQL_PENDING,          // SQL trong batch của TableBatchAggregator
+        APPLY_QUEUE,          // SQL trong task của ApplyLaneRouter / đang ghi
+        BATCH_POOL,           // vector / string rảnh TableBatchPool giữ lại để tái sử dụng
+        COMPONENT_COUNT
+    };
+
+    // Charge kiểu RAII cho dữ liệu sống trong một scope
+    class Scoped {
+    public:
+        Scoped(Component component, size_t bytes) : component(component), bytes(bytes) {
+            MemoryAccountant::getInstance().charge(component, bytes);
+        }
+        ~Scoped() { MemoryAccountant::getInstance().release(component, bytes); }
+        Scoped(const Scoped&) = delete;
+        Scoped& operator=(const Scoped&) = delete;
+
+    private:
+        Component component;
+        size_t bytes;
+    };
+
+    static MemoryAccountant& getInstance();
+
+    // budgetBytes = 0: chỉ đếm (gauge), không bao giờ pause
+    void configure(size_t budgetBytes, int pausePercent, int resumePercent);
+
+    void charge(Component component, size_t bytes) {
+        if (bytes) used[component].fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void release(Component component, size_t bytes);
+
+    size_t usage(Component component) const { return used[component].load(std::memory_order_relaxed); }
+    size_t totalUsage() const;
+    // Byte của dữ liệu đang chảy qua pipeline (không tính BATCH_POOL): cơ sở để pause / resume
+    size_t pipelineUsage() const;
+    size_t budget() const { return budgetBytes.load(std::memory_order_relaxed); }
+
+    // Consumer gọi mỗi vòng poll: true = nên pause, cập nhật trạng thái theo hysteresis.
+    // Buffer rảnh của TableBatchPool không giảm khi pause (chỉ tái sử dụng khi có dữ liệu mới) nên không được tính,
+    // nếu không pool đầy có thể giữ tổng trên mức resume và consumer không bao giờ resume
+    bool shouldPause();
+
+    // Kafka message giữ tới khi commit. Message có row của nhiều bảng nằm trong nhiều batch →
+    // refs > 1: chỉ reference cuối commit (khi mọi batch chứa message đều ghi thành công) và destroy.
+    void trackMessage(rd_kafka_message_t* msg);
+    void addMessageRefs(rd_kafka_message_t* msg, int extraRefs);
+
+    template <typename CommitFn>
+    void releaseMessage(rd_kafka_message_t* msg, bool success, CommitFn&& commit) {
+        if (!msg || !dropReference(msg, success)) return;
+        if (success) commit(msg);
+        release(KAFKA_INFLIGHT, msg->len);
+        rd_kafka_message_destroy(msg);
+    }
+
+    // Giải phóng sớm message không dùng chung (batch bị spill xuống đĩa): true nếu đã destroy,
+    // caller giữ topic / partition / offset để commit sau
+    bool detachMessage(rd_kafka_message_t* msg);
+
+    void reportMetrics() const;
+
+    static const char* componentName(Component component);
+
+private:
+    MemoryAccountant() = default;
+
+    std::array<std::atomic<size_t>, COMPONENT_COUNT> used{};
+    std::atomic<size_t> budgetBytes{0};
+    std::atomic<size_t> pauseBytes{0};
+    std::atomic<size_t> resumeBytes{0};
+    std::atomic<bool> paused{false};
+
+    // true nếu là reference cuối; success = false nếu có reference nào thất bại
+    bool dropReference(rd_kafka_message_t* msg, bool& success);
+
+    struct SharedMessage {
+        int extraRefs = 0;
+        bool failed = false;
+    };
+
+    std::mutex refsMutex;
+    std::unordered_map<rd_kafka_message_t*, SharedMessage> shared;   // chỉ message có refs > 1
+};
+
+#endif // MEMORY_ACCOUNTANT_H
@@ -1,9 +1,7 @@
 #include "Queues.h"
 
 // Định nghĩa cụ thể queues
-ThreadSafeQueue<std::tuple<
+// 5000 → 8192 slot (ring luỹ thừa 2); bộ nhớ thực tế do giới hạn byte quyết định
+BoundedRingQueue<std::tuple<
     std::string, int, int64_t, int64_t, rd_kafka_message_t*>> kafkaMessageQueue(5000);
 
-ThreadSafeQueue<std::tuple<
-    std::string, TableBatch>> dbWriteQueue(2500);
-
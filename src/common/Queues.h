@@ -4,17 +4,14 @@
 #include <string>
 #include <librdkafka/rdkafka.h>
 #include "TableBatch.h"
-#include "../thread/ThreadSafeQueue.h"
+#include "../thread/BoundedRingQueue.h"
 
-// Queue chứa message thô từ Kafka
-extern ThreadSafeQueue<std::tuple<
+// Queue chứa message thô từ Kafka (consumer thread → worker), giới hạn thêm theo byte (kafka_queue_max_bytes)
+extern BoundedRingQueue<std::tuple<
     std::string,      // message (json string)
     int,              // partition
     int64_t,          // offset
     int64_t,          // timestamp
     rd_kafka_message_t*>> kafkaMessageQueue;
 
-// Queue chứa batch SQL theo table (TableBatch)
-extern ThreadSafeQueue<std::tuple<
-    std::string,      // tableKey (owner.table)
-    TableBatch>> dbWriteQueue;
+// Batch SQL theo table đi qua ApplyLaneRouter (queue riêng cho từng DB writer)
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <charconv>
+#include <rapidjson/document.h>
+
+// Hash ổn định của (table, giá trị các cột PK) để các stage sau partition / phát hiện xung đột theo row.
+// Không dùng std::hash → giá trị giống nhau giữa các process và các lần chạy.
+namespace RowKeyHash {
+
+    // Row thiếu cột PK (hoặc bảng không khai báo PK) → caller phải coi như xung đột với mọi row của bảng
+    constexpr uint64_t UNKNOWN = 0;
+
+    namespace detail {
+        constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+        constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+        inline void mix(uint64_t& h, const char* p, size_t len) {
+            for (size_t i = 0; i < len; ++i) {
+                h ^= static_cast<unsigned char>(p[i]);
+                h *= FNV_PRIME;
+            }
+        }
+
+        inline void mixTag(uint64_t& h, char tag) {
+            mix(h, &tag, 1);
+        }
+
+        inline uint64_t finalize(uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            return h == UNKNOWN ? 1 : h;
+        }
+    }
+
+    inline uint64_t compute(const std::string& tableKey, const rapidjson::Value& row, const std::vector<std::string>& keys) {
+        if (keys.empty() || !row.IsObject()) return UNKNOWN;
+
+        uint64_t h = detail::FNV_OFFSET;
+        detail::mix(h, tableKey.data(), tableKey.size());
+
+        for (const auto& key : keys) {
+            auto it = row.FindMember(key.c_str());
+            if (it == row.MemberEnd()) return UNKNOWN;
+
+            const auto& val = it->value;
+            char buffer[32];
+            if (val.IsString()) {
+                // kParseNumbersAsStringsFlag: số cũng đến đây dưới dạng text gốc
+                detail::mixTag(h, 's');
+                detail::mix(h, val.GetString(), val.GetStringLength());
+            } else if (val.IsInt64() || val.IsUint64() || val.IsDouble()) {
+                auto res = val.IsInt64() ? std::to_chars(buffer, buffer + sizeof(buffer), val.GetInt64())
+                         : val.IsUint64() ? std::to_chars(buffer, buffer + sizeof(buffer), val.GetUint64())
+                                          : std::to_chars(buffer, buffer + sizeof(buffer), val.GetDouble());
+                detail::mixTag(h, 's');
+                detail::mix(h, buffer, static_cast<size_t>(res.ptr - buffer));
+            } else if (val.IsBool()) {
+                detail::mixTag(h, val.GetBool() ? 't' : 'f');
+            } else if (val.IsNull()) {
+                detail::mixTag(h, 'n');
+            } else {
+                return UNKNOWN;
+            }
+            detail::mixTag(h, '\x1f');
+        }
+        return detail::finalize(h);
+    }
+}
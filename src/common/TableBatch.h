@@ -3,13 +3,25 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <librdkafka/rdkafka.h>
 
+// Vị trí Kafka của message sinh ra statement (dead-letter ghi lại để tra cứu / replay)
+struct RowOrigin {
+    int32_t partition = -1;
+    int64_t offset = -1;
+};
+
 struct TableBatch {
     //std::string tableKey;
     std::vector<std::string> sqls;
+    // RowKeyHash của từng statement (song song với sqls), RowKeyHash::UNKNOWN nếu không xác định được
+    std::vector<uint64_t> keyHashes;
+    // Message gốc của từng statement (song song với sqls)
+    std::vector<RowOrigin> origins;
+    // RowKeyHash của row cha (theo FK) mà các statement trong batch tham chiếu, dùng cho write-set
+    std::vector<uint64_t> dependencyKeys;
     std::vector<rd_kafka_message_t*> messages;
 };
 
 #endif // TABLE_BATCH_H
-
@@ -0,0 +1,170 @@
+#include "TableBatchAggregator.h"
+#include "TableBatchPool.h"
+#include "MemoryAccountant.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+TableBatchAggregator& TableBatchAggregator::getInstance() {
+    static TableBatchAggregator instance;
+    return instance;
+}
+
+void TableBatchAggregator::configure(size_t rows, size_t bytes, int intervalMs) {
+    maxRows.store(rows > 0 ? rows : 1, std::memory_order_relaxed);
+    maxBytes.store(bytes, std::memory_order_relaxed);
+    flushIntervalMs.store(intervalMs, std::memory_order_relaxed);
+}
+
+void TableBatchAggregator::setDependencyGroups(const std::vector<std::pair<std::string, std::string>>& edges) {
+    // Union-find trên tên bảng
+    std::unordered_map<std::string, std::string> parent;
+    std::function<std::string(const std::string&)> find = [&](const std::string& key) -> std::string {
+        auto it = parent.find(key);
+        if (it == parent.end()) {
+            parent[key] = key;
+            return key;
+        }
+        if (it->second == key) return key;
+        std::string root = find(it->second);
+        parent[key] = root;
+        return root;
+    };
+    for (const auto& [child, parentTable] : edges) {
+        std::string a = find(child);
+        std::string b = find(parentTable);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    }
+
+    groupOf.clear();
+    groupMembers.clear();
+    for (const auto& entry : parent) {
+        std::string root = find(entry.first);
+        groupOf[entry.first] = root;
+        groupMembers[root].push_back(entry.first);
+    }
+}
+
+const std::string& TableBatchAggregator::orderKeyFor(const std::string& tableKey) const {
+    auto group = groupOf.find(tableKey);
+    return group != groupOf.end() ? group->second : tableKey;
+}
+
+TableBatchAggregator::Shard& TableBatchAggregator::shardFor(const std::string& tableKey) {
+    // Cả nhóm FK cùng shard → seq của nhóm được cấp dưới một lock
+    return shards[std::hash<std::string>{}(orderKeyFor(tableKey)) % SHARD_COUNT];
+}
+
+void TableBatchAggregator::takeGroupPeersLocked(Shard& shard, const std::string& tableKey, std::vector<ReadyBatch>& ready) {
+    auto group = groupOf.find(tableKey);
+    if (group == groupOf.end()) return;
+    for (const auto& peer : groupMembers[group->second]) {
+        if (peer == tableKey) continue;
+        auto it = shard.tables.find(peer);
+        if (it != shard.tables.end()) takeLocked(shard, it, ready);
+    }
+}
+
+void TableBatchAggregator::takeLocked(Shard& shard, std::unordered_map<std::string, PendingBatch>::iterator it,
+                                      std::vector<ReadyBatch>& ready) {
+    pendingRowCount.fetch_sub(it->second.batch.sqls.size(), std::memory_order_relaxed);
+    MemoryAccountant::getInstance().release(MemoryAccountant::SQL_PENDING, it->second.bytes);
+    // Dispatch ngoài lock (queue của writer đầy không chặn worker của bảng khác cùng shard);
+    // seq giữ thứ tự lấy ra của bảng / nhóm FK khi nhiều worker dispatch song song
+    const std::string& orderKey = orderKeyFor(it->first);
+    ready.push_back({it->first, std::move(it->second.batch), orderKey, shard.nextSeq[orderKey]++});
+    shard.tables.erase(it);
+}
+
+void TableBatchAggregator::append(const std::string& tableKey, TableBatch&& produced, rd_kafka_message_t* msg,
+                                  std::vector<ReadyBatch>& ready) {
+    size_t bytes = 0;
+    for (const auto& sql : produced.sqls) bytes += sql.size();
+    const size_t rows = produced.sqls.size();
+
+    Shard& shard = shardFor(tableKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    // Row của bảng này đến sau các row đang chờ của bảng cùng nhóm FK → các batch đó phải đi trước
+    takeGroupPeersLocked(shard, tableKey, ready);
+
+    auto [it, inserted] = shard.tables.try_emplace(tableKey);
+    PendingBatch& pending = it->second;
+    if (inserted) {
+        pending.batch = TableBatchPool::getInstance().acquireBatch();
+        pending.generation = nextGeneration.fetch_add(1, std::memory_order_relaxed);
+        scheduleTimer(tableKey, pending.generation);
+    }
+
+    // Batch chung đã reserve sẵn (từ pool): chỉ move string, không cấp phát lại vector
+    auto& batch = pending.batch;
+    batch.sqls.insert(batch.sqls.end(),
+                      std::make_move_iterator(produced.sqls.begin()), std::make_move_iterator(produced.sqls.end()));
+    batch.keyHashes.insert(batch.keyHashes.end(), produced.keyHashes.begin(), produced.keyHashes.end());
+    batch.origins.insert(batch.origins.end(), produced.origins.begin(), produced.origins.end());
+    batch.dependencyKeys.insert(batch.dependencyKeys.end(),
+                                produced.dependencyKeys.begin(), produced.dependencyKeys.end());
+    batch.messages.push_back(msg);
+    TableBatchPool::getInstance().releaseBatch(std::move(produced));
+    pending.bytes += bytes;
+    pendingRowCount.fetch_add(rows, std::memory_order_relaxed);
+    MemoryAccountant::getInstance().charge(MemoryAccountant::SQL_PENDING, bytes);
+
+    const size_t byteLimit = maxBytes.load(std::memory_order_relaxed);
+    if (batch.sqls.size() >= maxRows.load(std::memory_order_relaxed) ||
+        (byteLimit > 0 && pending.bytes >= byteLimit)) {
+        takeLocked(shard, it, ready);
+    }
+}
+
+void TableBatchAggregator::scheduleTimer(const std::string& tableKey, uint64_t generation) {
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(flushIntervalMs.load(std::memory_order_relaxed));
+    std::lock_guard<std::mutex> lock(timerMutex);
+    timers.push({deadline, generation, tableKey});
+    refreshNextDeadlineLocked();
+}
+
+void TableBatchAggregator::refreshNextDeadlineLocked() {
+    const auto next = timers.empty() ? std::chrono::steady_clock::time_point::max() : timers.top().deadline;
+    nextDeadlineTicks.store(next.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::time_point TableBatchAggregator::nextDeadline() const {
+    return std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(nextDeadlineTicks.load(std::memory_order_relaxed)));
+}
+
+void TableBatchAggregator::collectExpired(std::chrono::steady_clock::time_point now, std::vector<ReadyBatch>& ready) {
+    if (now < nextDeadline()) return;
+
+    std::vector<FlushTimer> due;
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        while (!timers.empty() && timers.top().deadline <= now) {
+            due.push_back(timers.top());
+            timers.pop();
+        }
+        refreshNextDeadlineLocked();
+    }
+
+    for (const auto& timer : due) {
+        Shard& shard = shardFor(timer.tableKey);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.tables.find(timer.tableKey);
+        // Batch đã flush theo size (và có thể đã mở batch mới với generation khác)
+        if (it == shard.tables.end() || it->second.generation != timer.generation) continue;
+        takeLocked(shard, it, ready);
+    }
+}
+
+void TableBatchAggregator::drainAll(std::vector<ReadyBatch>& ready) {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        for (auto it = shard.tables.begin(); it != shard.tables.end();) {
+            auto next = std::next(it);
+            takeLocked(shard, it, ready);
+            it = next;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef TABLE_BATCH_AGGREGATOR_H
+#define TABLE_BATCH_AGGREGATOR_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <librdkafka/rdkafka.h>
+#include "TableBatch.h"
+
+// Batch theo bảng dùng chung cho tất cả worker (thay cho tableBuffers riêng từng worker):
+// N worker cùng append vào một batch / bảng → DB nhận batch đủ batch_size thay vì N batch lẻ.
+// Sharded theo hash(tableKey), mỗi shard một mutex → worker khác bảng không tranh lock.
+class TableBatchAggregator {
+public:
+    // Batch đã lấy ra khỏi aggregator, caller dispatch ngoài shard lock.
+    // seq tăng dần theo orderKey (bảng, hoặc nhóm FK) theo thứ tự lấy ra: ApplyLaneRouter enqueue đúng thứ tự này
+    struct ReadyBatch {
+        std::string tableKey;
+        TableBatch batch;
+        std::string orderKey;
+        uint64_t seq = 0;
+    };
+
+    static TableBatchAggregator& getInstance();
+
+    // maxRows: batch_size; maxBytes: batch_max_bytes (0 = không giới hạn); flushIntervalMs: tuổi tối đa của batch
+    void configure(size_t maxRows, size_t maxBytes, int flushIntervalMs);
+
+    // Các bảng nối với nhau bằng FK (cạnh child → parent) thành một nhóm: cùng shard, và tại mỗi thời điểm
+    // chỉ một bảng trong nhóm có batch đang chờ → batch được lấy ra đúng thứ tự nguồn giữa bảng cha / con.
+    void setDependencyGroups(const std::vector<std::pair<std::string, std::string>>& edges);
+
+    // Gộp kết quả của một Kafka message vào batch chung của bảng.
+    // Batch đạt maxRows / maxBytes được move ra ready (caller dispatch ngoài lock, theo đúng thứ tự trong ready).
+    void append(const std::string& tableKey, TableBatch&& produced, rd_kafka_message_t* msg,
+                std::vector<ReadyBatch>& ready);
+
+    // Move ra các batch đã quá flushIntervalMs kể từ lần append đầu tiên.
+    // Chỉ pop các deadline đã tới trong min-heap, không quét toàn bộ bảng.
+    void collectExpired(std::chrono::steady_clock::time_point now, std::vector<ReadyBatch>& ready);
+
+    // Deadline flush gần nhất (time_point::max() nếu không có batch nào đang chờ)
+    std::chrono::steady_clock::time_point nextDeadline() const;
+
+    // Shutdown: lấy hết batch còn lại
+    void drainAll(std::vector<ReadyBatch>& ready);
+
+    size_t pendingRows() const { return pendingRowCount.load(std::memory_order_relaxed); }
+
+private:
+    TableBatchAggregator() = default;
+
+    struct PendingBatch {
+        TableBatch batch;
+        size_t bytes = 0;
+        uint64_t generation = 0;   // khớp với FlushTimer.generation; batch flush theo size → timer cũ tự hết hiệu lực
+    };
+
+    // Cancel O(1): không xoá khỏi heap, timer có generation cũ bị bỏ qua khi pop
+    struct FlushTimer {
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t generation;
+        std::string tableKey;
+        bool operator>(const FlushTimer& other) const { return deadline > other.deadline; }
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, PendingBatch> tables;
+        std::unordered_map<std::string, uint64_t> nextSeq;     // orderKey → seq của batch lấy ra kế tiếp
+    };
+
+    static constexpr size_t SHARD_COUNT = 16;
+
+    Shard& shardFor(const std::string& tableKey);
+    const std::string& orderKeyFor(const std::string& tableKey) const;
+    void takeGroupPeersLocked(Shard& shard, const std::string& tableKey, std::vector<ReadyBatch>& ready);
+    void takeLocked(Shard& shard, std::unordered_map<std::string, PendingBatch>::iterator it,
+                    std::vector<ReadyBatch>& ready);
+
+    void scheduleTimer(const std::string& tableKey, uint64_t generation);
+    void refreshNextDeadlineLocked();
+
+    std::array<Shard, SHARD_COUNT> shards;
+
+    // Chỉ ghi trong setDependencyGroups (trước khi worker chạy)
+    std::unordered_map<std::string, std::string> groupOf;                  // tableKey → tên nhóm
+    std::unordered_map<std::string, std::vector<std::string>> groupMembers; // tên nhóm → tableKey
+
+    // Lock order: shard.mtx → timerMutex (collectExpired không giữ timerMutex khi lock shard)
+    mutable std::mutex timerMutex;
+    std::priority_queue<FlushTimer, std::vector<FlushTimer>, std::greater<FlushTimer>> timers;
+    std::atomic<std::chrono::steady_clock::rep> nextDeadlineTicks{std::chrono::steady_clock::time_point::max().time_since_epoch().count()};
+    std::atomic<uint64_t> nextGeneration{1};
+    std::atomic<size_t> maxRows{100};
+    std::atomic<size_t> maxBytes{0};
+    std::atomic<int> flushIntervalMs{1000};
+    std::atomic<size_t> pendingRowCount{0};
+};
+
+#endif // TABLE_BATCH_AGGREGATOR_H
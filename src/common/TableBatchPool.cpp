@@ -0,0 +1,85 @@
+#include "TableBatchPool.h"
+#include "MemoryAccountant.h"
+
+TableBatchPool& TableBatchPool::getInstance() {
+    static TableBatchPool instance;
+    return instance;
+}
+
+TableBatchPool::TableBatchPool()
+    : freeBatches(MAX_POOLED_BATCHES), freeStrings(MAX_POOLED_STRINGS) {}
+
+void TableBatchPool::configure(size_t rows, size_t maxRetainedBytes) {
+    reserveRows.store(rows > 0 ? rows : 1, std::memory_order_relaxed);
+    maxRetained.store(maxRetainedBytes, std::memory_order_relaxed);
+}
+
+size_t TableBatchPool::footprint(const TableBatch& batch) {
+    return batch.sqls.capacity() * sizeof(std::string) +
+           batch.keyHashes.capacity() * sizeof(uint64_t) +
+           batch.origins.capacity() * sizeof(RowOrigin) +
+           batch.dependencyKeys.capacity() * sizeof(uint64_t) +
+           batch.messages.capacity() * sizeof(rd_kafka_message_t*);
+}
+
+bool TableBatchPool::retain(size_t bytes) {
+    const size_t limit = maxRetained.load(std::memory_order_relaxed);
+    size_t current = retained.load(std::memory_order_relaxed);
+    do {
+        if (current + bytes > limit) return false;
+    } while (!retained.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+    MemoryAccountant::getInstance().charge(MemoryAccountant::BATCH_POOL, bytes);
+    return true;
+}
+
+void TableBatchPool::unretain(size_t bytes) {
+    retained.fetch_sub(bytes, std::memory_order_relaxed);
+    MemoryAccountant::getInstance().release(MemoryAccountant::BATCH_POOL, bytes);
+}
+
+TableBatch TableBatchPool::acquireBatch() {
+    TableBatch batch;
+    if (freeBatches.try_pop_nowait(batch)) {
+        unretain(footprint(batch));
+        return batch;
+    }
+
+    const size_t rows = reserveRows.load(std::memory_order_relaxed);
+    batch.sqls.reserve(rows);
+    batch.keyHashes.reserve(rows);
+    batch.origins.reserve(rows);
+    return batch;
+}
+
+void TableBatchPool::releaseBatch(TableBatch&& batch) {
+    for (auto& sql : batch.sqls) {
+        releaseString(std::move(sql));
+    }
+    batch.sqls.clear();
+    batch.keyHashes.clear();
+    batch.origins.clear();
+    batch.dependencyKeys.clear();
+    batch.messages.clear();
+
+    // Vỏ rỗng (vector đã bị move đi) không có gì để tái sử dụng; batch phình quá lớn (bảng nóng,
+    // batch_max_bytes lớn) thì không giữ, tránh pool chiếm RAM
+    const size_t capacity = batch.sqls.capacity();
+    if (capacity == 0 || capacity > reserveRows.load(std::memory_order_relaxed) * 4) return;
+    const size_t bytes = footprint(batch);
+    if (!retain(bytes)) return;
+    if (!freeBatches.try_push(std::move(batch))) unretain(bytes);
+}
+
+std::string TableBatchPool::acquireString() {
+    std::string str;
+    if (freeStrings.try_pop_nowait(str)) unretain(str.capacity() + 1);
+    return str;
+}
+
+void TableBatchPool::releaseString(std::string&& str) {
+    const size_t capacity = str.capacity();
+    if (capacity < MIN_STRING_CAPACITY || capacity > MAX_STRING_CAPACITY) return;
+    if (!retain(capacity + 1)) return;
+    str.clear();
+    if (!freeStrings.try_push(std::move(str))) unretain(capacity + 1);
+}
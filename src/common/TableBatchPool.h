@@ -0,0 +1,53 @@
+#ifndef TABLE_BATCH_POOL_H
+#define TABLE_BATCH_POOL_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "TableBatch.h"
+#include "../thread/BoundedRingQueue.h"
+
+// Tái sử dụng TableBatch (vector đã reserve) và buffer SQL giữa worker và DB writer:
+// builder lấy string từ pool để render statement, writer trả cả batch (và từng string) về pool sau khi
+// ghi xong → đường batch không cấp phát ở trạng thái ổn định, không cần malloc_trim chống phân mảnh.
+// Free list là BoundedRingQueue (lock-free), pool đầy (theo số object hoặc tổng byte giữ lại) thì object
+// bị giải phóng bình thường. Byte giữ lại được charge vào MemoryAccountant::BATCH_POOL.
+class TableBatchPool {
+public:
+    static TableBatchPool& getInstance();
+
+    // reserveRows: capacity reserve cho batch mới (thường = batch_size)
+    // maxRetainedBytes: tổng capacity (vector + string) pool được giữ khi rảnh
+    void configure(size_t reserveRows, size_t maxRetainedBytes);
+
+    TableBatch acquireBatch();
+    // Clear (giữ capacity) và trả về pool; các SQL string còn trong batch được trả về string pool
+    void releaseBatch(TableBatch&& batch);
+
+    // String rỗng, có thể đã có capacity từ statement trước
+    std::string acquireString();
+    void releaseString(std::string&& str);
+
+    size_t retainedBytes() const { return retained.load(std::memory_order_relaxed); }
+
+private:
+    TableBatchPool();
+
+    static size_t footprint(const TableBatch& batch);
+    // false nếu vượt maxRetainedBytes (caller bỏ object thay vì đưa vào pool)
+    bool retain(size_t bytes);
+    void unretain(size_t bytes);
+
+    static constexpr size_t MAX_POOLED_BATCHES = 1024;
+    static constexpr size_t MAX_POOLED_STRINGS = 65536;
+    static constexpr size_t MIN_STRING_CAPACITY = 64;          // nhỏ hơn: SSO / không đáng giữ
+    static constexpr size_t MAX_STRING_CAPACITY = 64 * 1024;   // statement LOB lớn: không giữ lại
+
+    std::atomic<size_t> reserveRows{100};
+    std::atomic<size_t> maxRetained{64 * 1024 * 1024};
+    std::atomic<size_t> retained{0};
+    BoundedRingQueue<TableBatch> freeBatches;
+    BoundedRingQueue<std::string> freeStrings;
+};
+
+#endif // TABLE_BATCH_POOL_H
@@ -224,58 +224,172 @@ namespace TimeUtils {
         return "INVALID_TIMESTAMP";
     }
  }
-  std::string convertMicrosecondsToTimestamp(int64_t microseconds) {
-    try {
-        auto dur = std::chrono::microseconds(microseconds);
-        auto tp = std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds>(dur);
+  // ---------- Civil calendar (proleptic Gregorian, năm thiên văn: 1 BC = 0) ----------
+  // Thuật toán days_from_civil / civil_from_days của H. Hinnant, chỉ dùng phép chia nguyên
+
+  int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+  }
 
-        std::ostringstream oss;
-        oss << date::format("%F %T", tp);  // yyyy-MM-dd HH:mm:ss
-        return oss.str();
-    } catch (const std::exception& e) {
-        std::cerr << "[TimeUtils] Timestamp conversion failed: " << e.what() << std::endl;
-        return "INVALID_TIMESTAMP";
-    }
+  void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
   }
 
-   std::string convertMicrosecondsToDate(int64_t microseconds) {
-    try {
-        auto dur = std::chrono::microseconds(microseconds);
-        auto tp = std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds>(dur);
+  namespace {
 
-        sys_days dp = floor<days>(tp);
-        year_month_day ymd(dp);
+    constexpr int64_t MICROS_PER_SECOND = 1000000;
+    constexpr int64_t MICROS_PER_DAY = 86400LL * MICROS_PER_SECOND;
 
-        std::ostringstream oss;
-        oss << ymd;  // yyyy-MM-dd
-        return oss.str();
-    } catch (const std::exception& e) {
-        std::cerr << "[TimeUtils] Date conversion failed: " << e.what() << std::endl;
-        return "INVALID_DATE";
+    constexpr char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    inline char* writePair(char* p, unsigned v) {
+        p[0] = DIGIT_PAIRS[v * 2];
+        p[1] = DIGIT_PAIRS[v * 2 + 1];
+        return p + 2;
     }
-  }
 
-  std::string epochToIso8601(int64_t microseconds) {
-    try {
-        auto dur = std::chrono::microseconds(microseconds);
-        auto tp = std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds>(dur);
+    // Năm có ít nhất 4 chữ số, năm âm có dấu '-' (giống date::format "%F": -0044)
+    char* writeYear(char* p, int64_t year) {
+        uint64_t y = static_cast<uint64_t>(year);
+        if (year < 0) {
+            *p++ = '-';
+            y = 0 - y;
+        }
+        if (y < 10000) {
+            p = writePair(p, static_cast<unsigned>(y / 100));
+            return writePair(p, static_cast<unsigned>(y % 100));
+        }
+        char tmp[20];
+        int n = 0;
+        while (y) {
+            tmp[n++] = static_cast<char>('0' + y % 10);
+            y /= 10;
+        }
+        while (n) *p++ = tmp[--n];
+        return p;
+    }
 
-        std::ostringstream oss;
-        oss << date::format("%FT%T", tp);  // YYYY-MM-DDTHH:MM:SS
-        int64_t us_part = microseconds % 1000000;
-        if (us_part < 0) us_part += 1000000;
+    // floor division: micro âm (trước 1970) vẫn ra đúng ngày
+    inline void splitMicros(int64_t microseconds, int64_t& days, int64_t& microsOfDay) {
+        days = microseconds / MICROS_PER_DAY;
+        microsOfDay = microseconds % MICROS_PER_DAY;
+        if (microsOfDay < 0) {
+            microsOfDay += MICROS_PER_DAY;
+            --days;
+        }
+    }
 
-        // Thêm phần .FFFFFF
-        char fractional[16];
-        snprintf(fractional, sizeof(fractional), ".%06ld", us_part);
-        oss << fractional;
+    // CDC batch thường dồn trong cùng một ngày → cache "YYYY-MM-DD" của ngày gần nhất theo thread
+    struct DatePrefixCache {
+        int64_t days = INT64_MIN;
+        char text[DATE_BUFFER_SIZE];
+        size_t length = 0;
+    };
 
-        oss << "Z";  // UTC
-        return oss.str();
-    } catch (const std::exception& e) {
-        std::cerr << "[TimeUtils] ISO 8601 conversion failed: " << e.what() << std::endl;
-        return "INVALID_ISO8601";
+    thread_local DatePrefixCache datePrefixCache;
+
+    inline char* writeDatePrefix(char* p, int64_t days) {
+        DatePrefixCache& cache = datePrefixCache;
+        if (cache.days != days) {
+            int64_t year;
+            unsigned month, day;
+            civilFromDays(days, year, month, day);
+            char* q = writeYear(cache.text, year);
+            *q++ = '-';
+            q = writePair(q, month);
+            *q++ = '-';
+            q = writePair(q, day);
+            cache.length = static_cast<size_t>(q - cache.text);
+            cache.days = days;
+        }
+        std::memcpy(p, cache.text, cache.length);
+        return p + cache.length;
     }
+
+    // "HH:MM:SS.ffffff"
+    inline char* writeTimeOfDay(char* p, int64_t microsOfDay) {
+        const unsigned secs = static_cast<unsigned>(microsOfDay / MICROS_PER_SECOND);
+        unsigned frac = static_cast<unsigned>(microsOfDay % MICROS_PER_SECOND);
+        p = writePair(p, secs / 3600);
+        *p++ = ':';
+        p = writePair(p, (secs / 60) % 60);
+        *p++ = ':';
+        p = writePair(p, secs % 60);
+        *p++ = '.';
+        p = writePair(p, frac / 10000);
+        frac %= 10000;
+        p = writePair(p, frac / 100);
+        return writePair(p, frac % 100);
+    }
+
+    inline bool readDigits(const char*& p, const char* end, int count, int64_t& out) {
+        int64_t v = 0;
+        for (int i = 0; i < count; ++i, ++p) {
+            if (p == end || *p < '0' || *p > '9') return false;
+            v = v * 10 + (*p - '0');
+        }
+        out = v;
+        return true;
+    }
+
+  } // namespace
+
+  size_t formatMicrosecondsToDate(int64_t microseconds, char* buffer) {
+    int64_t days, microsOfDay;
+    splitMicros(microseconds, days, microsOfDay);
+    return static_cast<size_t>(writeDatePrefix(buffer, days) - buffer);
+  }
+
+  size_t formatMicrosecondsToTimestamp(int64_t microseconds, char* buffer, char separator) {
+    int64_t days, microsOfDay;
+    splitMicros(microseconds, days, microsOfDay);
+    char* p = writeDatePrefix(buffer, days);
+    *p++ = separator;
+    p = writeTimeOfDay(p, microsOfDay);
+    return static_cast<size_t>(p - buffer);
+  }
+
+  void appendMicrosecondsToTimestamp(std::string& out, int64_t microseconds) {
+    char buffer[TIMESTAMP_BUFFER_SIZE];
+    out.append(buffer, formatMicrosecondsToTimestamp(microseconds, buffer));
+  }
+
+  void appendMicrosecondsToDate(std::string& out, int64_t microseconds) {
+    char buffer[DATE_BUFFER_SIZE];
+    out.append(buffer, formatMicrosecondsToDate(microseconds, buffer));
+  }
+
+  std::string convertMicrosecondsToTimestamp(int64_t microseconds) {
+    char buffer[TIMESTAMP_BUFFER_SIZE];
+    return std::string(buffer, formatMicrosecondsToTimestamp(microseconds, buffer));
+  }
+
+  std::string convertMicrosecondsToDate(int64_t microseconds) {
+    char buffer[DATE_BUFFER_SIZE];
+    return std::string(buffer, formatMicrosecondsToDate(microseconds, buffer));
+  }
+
+  std::string epochToIso8601(int64_t microseconds) {
+    char buffer[TIMESTAMP_BUFFER_SIZE + 1];
+    size_t length = formatMicrosecondsToTimestamp(microseconds, buffer, 'T');
+    buffer[length++] = 'Z';  // UTC
+    return std::string(buffer, length);
   }
 
   /*
@@ -650,73 +764,72 @@ int64_t parseOracleTimestampToMicroseconds(const std::string& ts) {
     }
 }*/
 
+// "[-]YYYY-MM-DD[( |T)HH:MM:SS[.f{1,9}]][Z|±HH:MM]" → micro giây UTC; -1 nếu sai định dạng
 int64_t parseISOTimestampToMicros(const std::string& value) {
-    try {
-        // Split value into datetime and microsecond parts
-        size_t dotPos = value.find('.');
-        std::string datetimePart = (dotPos != std::string::npos)
-            ? value.substr(0, dotPos)
-            : value;
+    const char* p = value.data();
+    const char* end = p + value.size();
 
-        std::string microPart = (dotPos != std::string::npos)
-            ? value.substr(dotPos + 1)
-            : "0";
+    while (p != end && *p == ' ') ++p;
 
-        // Parse datetime
-        std::tm tm = {};
-        std::istringstream ss(datetimePart);
-        ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-        if (ss.fail()) {
-            return -1;
-        }
-
-        tm.tm_isdst = -1;
-        std::time_t timeSec = std::mktime(&tm);
-
-        // If mktime fails and year < 1970, fallback manually
-        if (timeSec == -1 && tm.tm_year + 1900 < 1970) {
-            std::tm epoch_tm = {};
-            epoch_tm.tm_year = 70;  // 1970
-            epoch_tm.tm_mon = 0;
-            epoch_tm.tm_mday = 1;
-            epoch_tm.tm_hour = 0;
-            epoch_tm.tm_min = 0;
-            epoch_tm.tm_sec = 0;
-
-            std::time_t epochSec = std::mktime(&epoch_tm);
-            std::time_t adjusted = std::mktime(&tm);
-
-            if (epochSec == -1 || adjusted == -1) return -1;
-
-            int64_t diffSec = static_cast<int64_t>(std::difftime(adjusted, epochSec));
-            int micros = 0;
-            try {
-                micros = std::stoi(microPart.substr(0, 6));
-            } catch (...) {}
-
-            int64_t result = diffSec * 1000000LL + micros;
+    bool negativeYear = false;
+    if (p != end && *p == '-') {
+        negativeYear = true;
+        ++p;
+    }
 
-            // ✅ Log timestamp âm
-            OpenSync::Logger::debug("🕒 Parsed pre-1970 timestamp: " + value + " → micros = " + std::to_string(result));
-            return result;
+    int64_t year = 0;
+    int yearDigits = 0;
+    while (p != end && *p >= '0' && *p <= '9' && yearDigits < 6) {
+        year = year * 10 + (*p++ - '0');
+        ++yearDigits;
+    }
+    if (yearDigits < 4) return -1;
+    if (negativeYear) year = -year;
+
+    int64_t month, day;
+    if (p == end || *p++ != '-' || !readDigits(p, end, 2, month)) return -1;
+    if (p == end || *p++ != '-' || !readDigits(p, end, 2, day)) return -1;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return -1;
+
+    int64_t hour = 0, minute = 0, second = 0, micros = 0;
+    if (p != end && (*p == ' ' || *p == 'T')) {
+        ++p;
+        if (!readDigits(p, end, 2, hour)) return -1;
+        if (p == end || *p++ != ':' || !readDigits(p, end, 2, minute)) return -1;
+        if (p == end || *p++ != ':' || !readDigits(p, end, 2, second)) return -1;
+        if (hour > 23 || minute > 59 || second > 60) return -1;
+
+        if (p != end && *p == '.') {
+            ++p;
+            int digits = 0;
+            while (p != end && *p >= '0' && *p <= '9') {
+                if (digits < 6) {
+                    micros = micros * 10 + (*p - '0');
+                }
+                ++digits;
+                ++p;
+            }
+            for (int i = digits; i < 6; ++i) micros *= 10;  // ".5" = 500000us
         }
+    }
 
-        // Normal path
-        auto tp = std::chrono::system_clock::from_time_t(timeSec);
-        int micros = std::stoi(microPart.substr(0, 6));
-        int64_t result = std::chrono::duration_cast<std::chrono::microseconds>(
-                             tp.time_since_epoch()).count() + micros;
-
-        // ✅ Optional: log if timestamp is negative
-        if (result < 0) {
-            OpenSync::Logger::debug("🕒 Parsed negative timestamp: " + value + " → micros = " + std::to_string(result));
+    // Offset tùy chọn; phần còn lại (nếu có) bỏ qua như trước
+    int64_t offsetSeconds = 0;
+    while (p != end && *p == ' ') ++p;
+    if (p != end && (*p == '+' || *p == '-')) {
+        const int sign = (*p == '-') ? -1 : 1;
+        const char* q = p + 1;
+        int64_t tzHour, tzMin = 0;
+        if (readDigits(q, end, 2, tzHour)) {
+            if (q != end && *q == ':') ++q;
+            readDigits(q, end, 2, tzMin);
+            offsetSeconds = sign * (tzHour * 3600 + tzMin * 60);
         }
-
-        return result;
-
-    } catch (...) {
-        return -1;
     }
+
+    const int64_t days = daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+    const int64_t seconds = days * 86400 + hour * 3600 + minute * 60 + second - offsetSeconds;
+    return seconds * MICROS_PER_SECOND + micros;
 }
 
 } // namespace TimeUtils
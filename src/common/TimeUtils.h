@@ -3,15 +3,30 @@
 
 #include <string>
 #include <cstdint>
+#include <cstddef>
 #include <ctime>
 
 namespace TimeUtils {
 
+    // Đủ cho năm có dấu + 6 chữ số (toàn dải int64 micro giây)
+    constexpr size_t DATE_BUFFER_SIZE = 16;        // "YYYY-MM-DD"
+    constexpr size_t TIMESTAMP_BUFFER_SIZE = 32;   // "YYYY-MM-DD HH:MM:SS.ffffff"
+
     std::string convertTimestamp(int64_t value, int unit); // Xử lý nanosecond, microsecond, millisecond
 
     std::string convertMicrosecondsToTimestamp(int64_t microseconds);
     std::string convertMicrosecondsToDate(int64_t microseconds);
 
+    // Ghi vào buffer của caller (không cấp phát), trả về số byte đã ghi (không có '\0')
+    size_t formatMicrosecondsToTimestamp(int64_t microseconds, char* buffer, char separator = ' ');
+    size_t formatMicrosecondsToDate(int64_t microseconds, char* buffer);
+    void appendMicrosecondsToTimestamp(std::string& out, int64_t microseconds);
+    void appendMicrosecondsToDate(std::string& out, int64_t microseconds);
+
+    // Proleptic Gregorian, năm thiên văn (1 BC = 0, 4713 BC = -4712)
+    int64_t daysFromCivil(int64_t year, unsigned month, unsigned day);
+    void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day);
+
     // Trả về định dạng ISO 8601 với microsecond và UTC (Z)
     std::string epochToIso8601(int64_t microseconds);
 
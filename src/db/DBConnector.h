@@ -4,6 +4,7 @@
 #include "string"
 #include "vector"
 #include "memory"
+#include "DBException.h"
 
 class DBConnector {
 public:
@@ -18,6 +19,15 @@ public:
     // Kiểm tra trạng thái kết nối
     virtual bool isConnected() = 0;
 
+    // Kiểm tra kết nối còn sống bằng một round trip (pool gọi định kỳ); mặc định chỉ xem trạng thái
+    virtual bool ping() { return isConnected(); }
+
+    // Đóng connection cũ rồi mở lại (pool gọi khi khôi phục sau mất kết nối)
+    virtual bool reconnect() {
+        disconnect();
+        return connect();
+    }
+
     // Thực thi câu lệnh SQL
     virtual bool executeQuery(const std::string& sql) = 0;
     
@@ -26,6 +36,24 @@ public:
     
     // 
     virtual std::unique_ptr<DBConnector> clone() const = 0;
+
+    // Lỗi của lần executeBatchQuery gần nhất (SUCCESS nếu thành công)
+    const std::string& getLastError() const { return lastError; }
+    DBExecResult getLastErrorClass() const { return lastErrorClass; }
+
+protected:
+    void setLastError(DBExecResult errorClass, const std::string& message) {
+        lastErrorClass = errorClass;
+        lastError = message;
+    }
+    void clearLastError() {
+        lastErrorClass = DBExecResult::SUCCESS;
+        lastError.clear();
+    }
+
+private:
+    std::string lastError;
+    DBExecResult lastErrorClass = DBExecResult::SUCCESS;
 };
 
 #endif
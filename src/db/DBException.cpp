@@ -10,6 +10,22 @@ DBExecResult DBExceptionHelper::classifyOracleError(int errorCode, const std::st
         case 3113:  // ORA-03113
         case 3114:  return DBExecResult::CONNECTION_LOST;
 	case 1839:  return DBExecResult::INVALID_DATA; // ORA-01839
+        case 1012:  // ORA-01012 not logged on
+        case 1033:  // ORA-01033 initialization or shutdown in progress
+        case 1034:  // ORA-01034 ORACLE not available
+        case 1089:  // ORA-01089 immediate shutdown in progress
+        case 1092:  // ORA-01092 instance terminated
+        case 3135:  // ORA-03135 connection lost contact
+        case 12514: // ORA-12514 listener does not know of service (failover đang diễn ra)
+        case 12528: // ORA-12528 instance blocking new connections
+        case 12537: // ORA-12537 TNS connection closed
+        case 12541: // ORA-12541 no listener
+        case 12547: // ORA-12547 TNS lost contact
+        case 25408: return DBExecResult::CONNECTION_LOST; // ORA-25408 cannot safely replay call
+        case 51:    // ORA-00051 timeout waiting for resource
+        case 54:    // ORA-00054 resource busy
+        case 60:    // ORA-00060 deadlock
+        case 1013:  // ORA-01013 user requested cancel (call timeout)
         case 12170: return DBExecResult::TIMEOUT;
         default:    break;
     }
@@ -23,6 +39,39 @@ DBExecResult DBExceptionHelper::classifyOracleError(int errorCode, const std::st
     return DBExecResult::UNKNOWN_ERROR;
 }
 
+DBExecResult DBExceptionHelper::classifyPostgreSQLState(const std::string& sqlState, const std::string& message) {
+    if (sqlState == "23505") return DBExecResult::DUPLICATE_PK;
+    if (sqlState.size() == 5) {
+        const std::string cls = sqlState.substr(0, 2);
+        if (cls == "08") return DBExecResult::CONNECTION_LOST;                      // connection exception
+        if (cls == "57") return sqlState == "57014" ? DBExecResult::TIMEOUT          // statement timeout
+                                                    : DBExecResult::CONNECTION_LOST; // admin shutdown, crash
+        if (cls == "40" || sqlState == "55P03") return DBExecResult::TIMEOUT;        // deadlock, serialization, lock
+        if (cls == "53") return DBExecResult::TIMEOUT;                               // insufficient resources
+        if (cls == "22" || cls == "23") return DBExecResult::INVALID_DATA;          // data exception, constraint
+        if (cls == "42") return DBExecResult::SCHEMA_MISMATCH;                       // undefined column / table
+        if (cls == "58") return DBExecResult::CONNECTION_LOST;                      // system / I/O error
+        if (sqlState == "25006") return DBExecResult::CONNECTION_LOST;              // read-only: standby sau failover
+    }
+
+    std::string lowerMsg = message;
+    std::transform(lowerMsg.begin(), lowerMsg.end(), lowerMsg.begin(), ::tolower);
+    if (lowerMsg.find("duplicate key") != std::string::npos) return DBExecResult::DUPLICATE_PK;
+    if (lowerMsg.find("server closed the connection") != std::string::npos ||
+        lowerMsg.find("no connection to the server") != std::string::npos ||
+        lowerMsg.find("could not connect") != std::string::npos ||
+        lowerMsg.find("pipeline aborted") != std::string::npos ||
+        lowerMsg.find("terminating connection") != std::string::npos ||
+        lowerMsg.find("connection timed out") != std::string::npos ||
+        lowerMsg.find("ssl syscall error") != std::string::npos) return DBExecResult::CONNECTION_LOST;
+
+    return DBExecResult::UNKNOWN_ERROR;
+}
+
+bool DBExceptionHelper::isTransient(DBExecResult result) {
+    return result == DBExecResult::CONNECTION_LOST || result == DBExecResult::TIMEOUT;
+}
+
 std::string DBExceptionHelper::toString(DBExecResult result) {
     switch (result) {
         case DBExecResult::SUCCESS: return "SUCCESS";
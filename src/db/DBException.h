@@ -14,6 +14,10 @@ enum class DBExecResult {
 class DBExceptionHelper {
 public:
     static DBExecResult classifyOracleError(int errorCode, const std::string& message);
+    // SQLSTATE 5 ký tự (PG_DIAG_SQLSTATE); rỗng → đoán theo message
+    static DBExecResult classifyPostgreSQLState(const std::string& sqlState, const std::string& message);
+    // Lỗi không do dữ liệu của row (mất kết nối, timeout): ghi lại cả batch sau, không cô lập row
+    static bool isTransient(DBExecResult result);
     static std::string toString(DBExecResult result);
 };
 
@@ -47,10 +47,16 @@ bool OracleConnector::connect() {
     try {
         env = Environment::createEnvironment(Environment::DEFAULT);
         conn = env->createConnection(user, password, "//" + host + ":" + std::to_string(port) + "/" + service);
+        connected = true;
 	OpenSync::Logger::info("✅ Connected to Oracle successfully!");
         return true;
     } catch (SQLException& e) {
 	OpenSync::Logger::error("❌ Oracle connection failed: " + std::string(e.getMessage()));
+        if (env) {
+            Environment::terminateEnvironment(env);
+            env = nullptr;
+        }
+        conn = nullptr;
         return false;
     }
 }
@@ -69,16 +75,55 @@ bool OracleConnector::connect() {
 
 void OracleConnector::disconnect() {
     if (conn) {
-        env->terminateConnection(conn);
-        Environment::terminateEnvironment(env);
+        // Session đã chết (failover) thì terminateConnection cũng ném lỗi, vẫn phải giải phóng environment
+        try {
+            env->terminateConnection(conn);
+        } catch (SQLException& e) {
+            OpenSync::Logger::warn("⚠️ Oracle terminateConnection failed: " + std::string(e.getMessage()));
+        }
+        try {
+            Environment::terminateEnvironment(env);
+        } catch (SQLException& e) {
+            OpenSync::Logger::warn("⚠️ Oracle terminateEnvironment failed: " + std::string(e.getMessage()));
+        }
         conn = nullptr;
         env = nullptr;
+        connected = false;
 	OpenSync::Logger::info("🔌 Disconnected from Oracle.");
     }
 }
 
 bool OracleConnector::isConnected() {
-    return conn != nullptr;
+    return conn != nullptr && connected;
+}
+
+DBExecResult OracleConnector::classifyAndTrack(const SQLException& e) {
+    const DBExecResult result = DBExceptionHelper::classifyOracleError(e.getErrorCode(), e.getMessage());
+    if (result == DBExecResult::CONNECTION_LOST && connected) {
+        connected = false;
+        OpenSync::Logger::warn("⚠️ Oracle session lost (ORA-" + std::to_string(e.getErrorCode()) + ")");
+    }
+    return result;
+}
+
+bool OracleConnector::ping() {
+    if (!isConnected()) return false;
+    Statement* stmt = nullptr;
+    try {
+        stmt = conn->createStatement("SELECT 1 FROM DUAL");
+        ResultSet* rs = stmt->executeQuery();
+        rs->next();
+        stmt->closeResultSet(rs);
+        conn->terminateStatement(stmt);
+        return true;
+    } catch (SQLException& e) {
+        OpenSync::Logger::warn("⚠️ Oracle ping failed: " + std::string(e.getMessage()));
+        connected = false;  // SELECT 1 FROM DUAL lỗi: session không dùng được nữa, dù mã lỗi là gì
+        if (stmt) {
+            try { conn->terminateStatement(stmt); } catch (...) {}
+        }
+        return false;
+    }
 }
 
 bool OracleConnector::reconnect() {
@@ -106,12 +151,17 @@ bool OracleConnector::executeQuery(const std::string& sql) {
         return true;
     } catch (SQLException& e) {
 	OpenSync::Logger::error("❌ Oracle query failed: " + std::string(e.getMessage()));
+        classifyAndTrack(e);
         return false;
     }
 }
 
 bool OracleConnector::executeBatchQuery(const std::vector<std::string>& sqlBatch) {
-    if (!isConnected()) return false;
+    if (!isConnected()) {
+        setLastError(DBExecResult::CONNECTION_LOST, "not connected");
+        return false;
+    }
+    clearLastError();
 
     Statement* stmt = nullptr;
 
@@ -126,8 +176,7 @@ bool OracleConnector::executeBatchQuery(const std::vector<std::string>& sqlBatch
                 successCount++;
             } catch (SQLException& e) {
                 std::string errMsg = e.getMessage();
-                int errCode = e.getErrorCode();
-                DBExecResult result = DBExceptionHelper::classifyOracleError(errCode, errMsg);
+                DBExecResult result = classifyAndTrack(e);
 
                 std::string tableKey = SQLUtils::extractTableFromInsert(sql);
 
@@ -151,8 +200,12 @@ bool OracleConnector::executeBatchQuery(const std::vector<std::string>& sqlBatch
                     MetricsExporter::getInstance().incrementCounter("oracle_batch_failed", {
                         {"error", DBExceptionHelper::toString(result)}
                     });
-                    conn->terminateStatement(stmt);
-                    conn->rollback();  // ⚠️ Lỗi nghiêm trọng → rollback toàn batch
+                    setLastError(result, errMsg);
+                    // ⚠️ Lỗi nghiêm trọng → rollback toàn batch (session đã chết thì không còn gì để rollback)
+                    try {
+                        conn->terminateStatement(stmt);
+                        if (connected) conn->rollback();
+                    } catch (SQLException&) {}
                     return false;
                 }
             }
@@ -171,8 +224,13 @@ bool OracleConnector::executeBatchQuery(const std::vector<std::string>& sqlBatch
 
     } catch (SQLException& e) {
         OpenSync::Logger::error("❌ Batch execution failed: " + std::string(e.getMessage()));
-        conn->rollback();
-        if (stmt) conn->terminateStatement(stmt);
+        setLastError(classifyAndTrack(e), e.getMessage());
+        try {
+            if (connected) conn->rollback();
+            if (stmt) conn->terminateStatement(stmt);
+        } catch (SQLException& rollbackError) {
+            classifyAndTrack(rollbackError);
+        }
         return false;
     }
 }
@@ -23,9 +23,10 @@ public:
     ~OracleConnector();
 
     bool connect() override;
-    bool reconnect();
+    bool reconnect() override;
     void disconnect() override;
     bool isConnected() override;
+    bool ping() override;
     bool executeQuery(const std::string& sql) override;
     bool executeBatchQuery(const std::vector<std::string>& sqlBatch) override;
 
@@ -55,7 +56,10 @@ private:
     oracle::occi::Connection* conn;
 
     std::mutex connMutex;
-    bool connected = false;
+    bool connected = false;     // false khi lỗi ORA cho thấy session đã chết (ORA-03113...) dù conn != nullptr
+
+    // Lỗi mất kết nối → đánh dấu connection hỏng để pool / writer bỏ nó thay vì dùng tiếp
+    DBExecResult classifyAndTrack(const oracle::occi::SQLException& e);
 };
 
 #endif
\ No newline at end of file
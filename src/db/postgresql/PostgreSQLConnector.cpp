@@ -2,10 +2,14 @@
 #include "../../schema/PostgreSQLColumnInfo.h"
 #include "../../logger/Logger.h"
 #include "../../utils/SQLUtils.h"
+#include "../../metrics/MetricsExporter.h"
 #include <libpq-fe.h>
 #include <sstream>
 #include <algorithm>
 #include <set>
+#include <poll.h>
+#include <cerrno>
+#include <cstring>
 
 /*PostgreSQLConnector::PostgreSQLConnector(const std::string& host,
                                          int port,
@@ -54,7 +58,10 @@ PostgreSQLConnector::~PostgreSQLConnector() {
     disconnect();
 }
 
-bool PostgreSQLConnector::connect() {
+std::string PostgreSQLConnector::buildConnInfo(const std::string& host, int port, const std::string& user,
+                                               const std::string& password, const std::string& dbname,
+                                               const std::string& sslmode, const std::string& sslrootcert,
+                                               const std::string& sslcert, const std::string& sslkey) {
     std::ostringstream connStr;
     connStr << "host=" << host << " port=" << port
             << " user=" << user << " password=" << password
@@ -63,8 +70,12 @@ bool PostgreSQLConnector::connect() {
     if (!sslrootcert.empty()) connStr << " sslrootcert=" << sslrootcert;
     if (!sslcert.empty()) connStr << " sslcert=" << sslcert;
     if (!sslkey.empty()) connStr << " sslkey=" << sslkey;
+    return connStr.str();
+}
 
-    conn = PQconnectdb(connStr.str().c_str());
+bool PostgreSQLConnector::connect() {
+    const std::string connInfo = buildConnInfo(host, port, user, password, dbname, sslmode, sslrootcert, sslcert, sslkey);
+    conn = PQconnectdb(connInfo.c_str());
 
     if (PQstatus(conn) != CONNECTION_OK) {
         OpenSync::Logger::error("❌ PostgreSQL connection failed: " + std::string(PQerrorMessage(conn)));
@@ -93,6 +104,15 @@ bool PostgreSQLConnector::isConnected() {
     return conn && PQstatus(conn) == CONNECTION_OK;
 }
 
+bool PostgreSQLConnector::ping() {
+    if (!isConnected()) return false;
+    // Empty query: một round trip tới server, không mở transaction / lock
+    PGresult* res = PQexec(conn, "");
+    bool alive = PQresultStatus(res) == PGRES_EMPTY_QUERY;
+    PQclear(res);
+    return alive && PQstatus(conn) == CONNECTION_OK;
+}
+
 bool PostgreSQLConnector::executeQuery(const std::string& sql) {
     if (!isConnected()) return false;
 
@@ -237,59 +257,241 @@ bool PostgreSQLConnector::executeBatchQuery(const std::vector<std::string>& sqlB
     std::lock_guard<std::mutex> lock(connMutex);
     if (!isConnected() && !connect()) {
         OpenSync::Logger::error("❌ PostgreSQLConnector not connected.");
+        setLastError(DBExecResult::CONNECTION_LOST, "not connected");
         return false;
     }
+    clearLastError();
+
+    // Lỗi đầu tiên làm transaction aborted: statement duplicate key / not null chỉ bỏ qua được bằng cách
+    // ROLLBACK TO SAVEPOINT gần nhất (đặt mỗi savepointInterval statement) rồi chạy lại đoạn đã thành công
+    // sau savepoint đó, không có savepoint thì ROLLBACK và chạy lại cả batch
+    std::vector<uint8_t> skip(sqlBatch.size(), 0);
+    size_t skippedCount = 0;
+    size_t from = 0;
+    bool resume = false;
+
+    for (;;) {
+        BatchRunResult result;
+        const bool ok = pipelineEnabled ? runPipeline(sqlBatch, skip, from, resume, result)
+                                        : runSequential(sqlBatch, skip, from, resume, result);
+        if (ok) {
+            OpenSync::Logger::info(std::string("✅ Batch executed") + (pipelineEnabled ? " (pipeline)" : "") + ": " +
+                                   std::to_string(sqlBatch.size() - skippedCount) + " succeeded, " +
+                                   std::to_string(skippedCount) + " skipped.");
+            return true;
+        }
 
-    if (!executeQuery("BEGIN")) {
-        OpenSync::Logger::error("❌ Failed to start transaction.");
-        return false;
+        if (result.failedIndex < 0 || !result.skippable) {
+            if (result.failedIndex >= 0) {
+                OpenSync::Logger::error("🔎 PostgreSQL error message: " + result.error + " | SQL: " +
+                                        sqlBatch[static_cast<size_t>(result.failedIndex)]);
+            } else {
+                OpenSync::Logger::error("🔎 PostgreSQL error message: " + result.error);
+            }
+            setLastError(result.errorClass, result.error);
+            if (isConnected()) executeQuery("ROLLBACK");
+            return false;
+        }
+
+        const std::string& sql = sqlBatch[static_cast<size_t>(result.failedIndex)];
+        if (result.error.find("duplicate key") != std::string::npos) {
+            OpenSync::Logger::warn("⚠️ Duplicate key violation detected. Skipping: " + sql);
+        } else {
+            OpenSync::Logger::warn("⚠️ Not null violation detected. Skipping: " + sql);
+        }
+        skip[static_cast<size_t>(result.failedIndex)] = 1;
+        ++skippedCount;
+
+        if (result.savepointAt >= 0) {
+            // Chỉ chạy lại các statement từ savepoint tới statement lỗi, phần trước đó vẫn nằm trong transaction
+            from = static_cast<size_t>(result.savepointAt);
+            resume = true;
+            MetricsExporter::getInstance().incrementCounter("pg_savepoint_rollbacks_total");
+        } else {
+            executeQuery("ROLLBACK");
+            from = 0;
+            resume = false;
+        }
     }
+}
 
-    int successCount = 0;
-    int skippedCount = 0;
+bool PostgreSQLConnector::isSkippableError(const PGresult* res) {
+    const char* state = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+    if (state && (std::strcmp(state, "23505") == 0 || std::strcmp(state, "23502") == 0)) return true;
 
-    for (size_t i = 0; i < sqlBatch.size(); ++i) {
-        const std::string& sql = sqlBatch[i];
-        OpenSync::Logger::debug("🔢 Executing SQL [" + std::to_string(i + 1) + "/" + 
-                               std::to_string(sqlBatch.size()) + "]: " + sql);
+    const std::string errMsg = PQresultErrorMessage(res);
+    return errMsg.find("duplicate key") != std::string::npos || errMsg.find("23502") != std::string::npos;
+}
 
-        PGresult* res = PQexec(conn, sql.c_str());
-        ExecStatusType status = PQresultStatus(res);
+DBExecResult PostgreSQLConnector::classifyError(const PGresult* res) {
+    const char* state = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+    return DBExceptionHelper::classifyPostgreSQLState(state ? state : "", PQresultErrorMessage(res));
+}
 
-        if (status != PGRES_COMMAND_OK) {
-            std::string errMsg = PQresultErrorMessage(res);
-            PQclear(res);
+void PostgreSQLConnector::planBatch(const std::vector<std::string>& sqlBatch, const std::vector<uint8_t>& skip,
+                                    size_t from, bool resume, size_t savepointInterval, std::vector<BatchStep>& steps) {
+    steps.clear();
+    steps.reserve(sqlBatch.size() - std::min(from, sqlBatch.size()) + 3 +
+                  (savepointInterval ? 2 * (sqlBatch.size() / savepointInterval + 1) : 0));
+
+    // Chỉ giữ một savepoint (RELEASE trước khi đặt cái mới): nhiều subtransaction lồng nhau làm chậm server
+    bool haveSavepoint = resume;
+    size_t sinceSavepoint = 0;
+    steps.push_back(resume ? BatchStep{BatchStepKind::ROLLBACK_TO_SAVEPOINT, from} : BatchStep{BatchStepKind::BEGIN, 0});
+    for (size_t i = from; i < sqlBatch.size(); ++i) {
+        if (skip[i]) continue;
+        if (savepointInterval > 0 && (!haveSavepoint || sinceSavepoint >= savepointInterval)) {
+            if (haveSavepoint) steps.push_back({BatchStepKind::RELEASE_SAVEPOINT, i});
+            steps.push_back({BatchStepKind::SAVEPOINT, i});
+            haveSavepoint = true;
+            sinceSavepoint = 0;
+        }
+        steps.push_back({BatchStepKind::STATEMENT, i});
+        ++sinceSavepoint;
+    }
+    steps.push_back({BatchStepKind::COMMIT, 0});
+}
 
-            if (errMsg.find("duplicate key") != std::string::npos) {
-                OpenSync::Logger::warn("⚠️ Duplicate key violation detected. Skipping: " + sql);
-                skippedCount++;
-                continue;
-            } else if (errMsg.find("23502") != std::string::npos) {
-                OpenSync::Logger::warn("⚠️ Not null violation detected. Skipping: " + sql);
-                skippedCount++;
-                continue;
-            }
+const char* PostgreSQLConnector::stepSQL(const BatchStep& step, const std::vector<std::string>& sqlBatch) {
+    switch (step.kind) {
+        case BatchStepKind::BEGIN:                 return "BEGIN";
+        case BatchStepKind::STATEMENT:             return sqlBatch[step.index].c_str();
+        case BatchStepKind::RELEASE_SAVEPOINT:     return "RELEASE SAVEPOINT opensync_batch";
+        case BatchStepKind::SAVEPOINT:             return "SAVEPOINT opensync_batch";
+        case BatchStepKind::ROLLBACK_TO_SAVEPOINT: return "ROLLBACK TO SAVEPOINT opensync_batch";
+        case BatchStepKind::COMMIT:                return "COMMIT";
+    }
+    return "";
+}
 
-            //OpenSync::Logger::error("❌ PostgreSQL INSERT failed. SQL: " + sql);
-            OpenSync::Logger::error("🔎 PostgreSQL error message: " + errMsg);
-            executeQuery("ROLLBACK");
-            return false;
+void PostgreSQLConnector::recordStepResult(const BatchStep& step, const PGresult* res, BatchRunResult& result) {
+    const ExecStatusType status = PQresultStatus(res);
+    if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK) {
+        if (step.kind == BatchStepKind::SAVEPOINT || step.kind == BatchStepKind::ROLLBACK_TO_SAVEPOINT) {
+            result.savepointAt = static_cast<long>(step.index);
         }
+        return;
+    }
+    if (status != PGRES_FATAL_ERROR || result.failed) return;
+
+    const bool isStatement = step.kind == BatchStepKind::STATEMENT;
+    result.failed = true;
+    result.failedIndex = isStatement ? static_cast<long>(step.index) : -1;
+    result.skippable = isStatement && isSkippableError(res);
+    result.errorClass = classifyError(res);
+    result.error = PQresultErrorMessage(res);
+}
+
+// Không pipeline: mỗi step một round trip, dừng ở step lỗi đầu tiên (transaction để mở cho caller)
+bool PostgreSQLConnector::runSequential(const std::vector<std::string>& sqlBatch, const std::vector<uint8_t>& skip,
+                                        size_t from, bool resume, BatchRunResult& result) {
+    std::vector<BatchStep> steps;
+    planBatch(sqlBatch, skip, from, resume, savepointInterval, steps);
 
+    for (const auto& step : steps) {
+        if (step.kind == BatchStepKind::STATEMENT) {
+            OpenSync::Logger::debug("🔢 Executing SQL [" + std::to_string(step.index + 1) + "/" +
+                                   std::to_string(sqlBatch.size()) + "]: " + sqlBatch[step.index]);
+        }
+        PGresult* res = PQexec(conn, stepSQL(step, sqlBatch));
+        if (!res || !isConnected()) {
+            result.failedIndex = -1;
+            result.errorClass = DBExecResult::CONNECTION_LOST;
+            result.error = conn ? PQerrorMessage(conn) : "not connected";
+            if (res) PQclear(res);
+            return false;
+        }
+        recordStepResult(step, res, result);
         PQclear(res);
-        successCount++;
-        OpenSync::Logger::debug("✅ SQL executed successfully.");
+        if (result.failed) return false;
     }
+    return true;
+}
 
-    if (!executeQuery("COMMIT")) {
-        OpenSync::Logger::error("❌ Failed to commit transaction.");
-        executeQuery("ROLLBACK");
+// Pipeline mode: mọi step gửi liền, một PQpipelineSync → một round trip cho cả batch thay vì một round trip
+// mỗi statement. Step lỗi đầu tiên được ghi nhận, các step sau nó bị server bỏ (PGRES_PIPELINE_ABORTED).
+bool PostgreSQLConnector::runPipeline(const std::vector<std::string>& sqlBatch, const std::vector<uint8_t>& skip,
+                                      size_t from, bool resume, BatchRunResult& result) {
+#ifdef LIBPQ_HAS_PIPELINING
+    // Non-blocking: vừa gửi vừa đọc kết quả, tránh deadlock khi cả hai phía đầy socket buffer
+    if (PQsetnonblocking(conn, 1) != 0 || PQenterPipelineMode(conn) != 1) {
+        result.error = PQerrorMessage(conn);
+        result.errorClass = DBExceptionHelper::classifyPostgreSQLState("", result.error);
+        PQsetnonblocking(conn, 0);
         return false;
     }
 
-    OpenSync::Logger::info("✅ Batch executed: " + std::to_string(successCount) + 
-                          " succeeded, " + std::to_string(skippedCount) + " skipped.");
-    return true;
+    std::vector<BatchStep> steps;
+    planBatch(sqlBatch, skip, from, resume, savepointInterval, steps);
+
+    bool sent = true;
+    for (size_t i = 0; sent && i < steps.size(); ++i) {
+        sent = PQsendQueryParams(conn, stepSQL(steps[i], sqlBatch), 0, nullptr, nullptr, nullptr, nullptr, 0) == 1;
+    }
+    sent = sent && PQpipelineSync(conn) == 1;
+
+    // Đọc kết quả theo thứ tự step: mỗi step kết thúc bằng nullptr, cuối cùng là PGRES_PIPELINE_SYNC
+    bool connectionError = !sent;
+    bool synced = false;
+    size_t cmd = 0;
+    while (!connectionError && !synced) {
+        const int flushed = PQflush(conn);
+        if (flushed < 0) {
+            connectionError = true;
+            break;
+        }
+
+        while (!PQisBusy(conn)) {
+            PGresult* res = PQgetResult(conn);
+            if (!res) {
+                if (++cmd > steps.size()) {
+                    connectionError = true;  // không còn gì để đọc mà chưa thấy sync
+                    break;
+                }
+                continue;
+            }
+            if (PQresultStatus(res) == PGRES_PIPELINE_SYNC) {
+                PQclear(res);
+                synced = true;
+                break;
+            }
+            if (cmd < steps.size()) recordStepResult(steps[cmd], res, result);
+            PQclear(res);
+        }
+        if (connectionError || synced) break;
+
+        pollfd pfd{PQsocket(conn), static_cast<short>(POLLIN | (flushed == 1 ? POLLOUT : 0)), 0};
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            connectionError = true;
+            break;
+        }
+        if ((pfd.revents & (POLLIN | POLLERR | POLLHUP)) && !PQconsumeInput(conn)) {
+            connectionError = true;
+        }
+    }
+
+    if (connectionError) {
+        // Trạng thái pipeline không xác định → bỏ connection, lần sau connect lại
+        result.failedIndex = -1;
+        result.errorClass = DBExecResult::CONNECTION_LOST;
+        result.error = "pipeline aborted: " + std::string(PQerrorMessage(conn));
+        disconnect();
+        return false;
+    }
+
+    PQexitPipelineMode(conn);
+    PQsetnonblocking(conn, 0);
+
+    // Lỗi: transaction vẫn mở ở trạng thái aborted (COMMIT đã bị bỏ qua), caller ROLLBACK / ROLLBACK TO SAVEPOINT
+    return !result.failed;
+#else
+    (void)sqlBatch;
+    (void)skip;
+    (void)from;
+    (void)resume;
+    result.error = "libpq built without pipeline support";
+    return false;
+#endif
 }
 
 // Hàm tiện ích để tạo câu INSERT động
@@ -401,6 +603,8 @@ bool PostgreSQLConnector::executeBatchQuery(const std::vector<BatchInsert>& batc
 
     if (!executeQuery("COMMIT")) {
         OpenSync::Logger::error("❌ Failed to commit transaction.");
+        const std::string errMsg = conn ? PQerrorMessage(conn) : "not connected";
+        setLastError(isConnected() ? DBExceptionHelper::classifyPostgreSQLState("", errMsg) : DBExecResult::CONNECTION_LOST, errMsg);
         executeQuery("ROLLBACK");
         return false;
     }
@@ -5,6 +5,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <cstdint>
 #include <mutex>
 #include <unordered_map>
 #include "../../schema/PostgreSQLColumnInfo.h"
@@ -36,9 +37,16 @@ public:
 
     ~PostgreSQLConnector();
 
+    // libpq conninfo ("host=... port=... sslmode=..."), dùng chung cho AsyncPgWriter
+    static std::string buildConnInfo(const std::string& host, int port, const std::string& user,
+                                     const std::string& password, const std::string& dbname,
+                                     const std::string& sslmode = "prefer", const std::string& sslrootcert = "",
+                                     const std::string& sslcert = "", const std::string& sslkey = "");
+
     bool connect() override;
     void disconnect() override;
     bool isConnected() override;
+    bool ping() override;
 
     bool executeQuery(const std::string& sql) override;
     bool executeBatchQuery(const std::vector<std::string>& sqlBatch) override;
@@ -55,11 +63,47 @@ public:
     //PGconn* conn = nullptr;  // public for schema cache access (or make friend if needed)
 
     bool executeStatementSQL(const std::string& sql);
+
+    // Pipeline mode cho executeBatchQuery (mặc định bật nếu libpq hỗ trợ)
+    void setPipelineEnabled(bool enabled) { pipelineEnabled = enabled; }
+    // SAVEPOINT mỗi interval statement: row lỗi bỏ qua được chỉ phải chạy lại tối đa interval statement (0 = tắt)
+    void setSavepointInterval(size_t interval) { savepointInterval = interval; }
+
+    // Các step của một lần chạy batch trong transaction: BEGIN (hoặc ROLLBACK TO SAVEPOINT khi chạy tiếp sau lỗi),
+    // statement, SAVEPOINT mỗi savepointInterval statement, COMMIT. Dùng chung cho AsyncPgWriter.
+    enum class BatchStepKind { BEGIN, STATEMENT, RELEASE_SAVEPOINT, SAVEPOINT, ROLLBACK_TO_SAVEPOINT, COMMIT };
+    struct BatchStep {
+        BatchStepKind kind;
+        size_t index;   // STATEMENT: index trong sqlBatch; SAVEPOINT / ROLLBACK TO: vị trí savepoint
+    };
+    // resume = true: transaction còn mở với savepoint đặt tại from → ROLLBACK TO SAVEPOINT rồi chạy lại từ from
+    static void planBatch(const std::vector<std::string>& sqlBatch, const std::vector<uint8_t>& skip, size_t from,
+                          bool resume, size_t savepointInterval, std::vector<BatchStep>& steps);
+    static const char* stepSQL(const BatchStep& step, const std::vector<std::string>& sqlBatch);
+    // Lỗi row được bỏ qua trong batch: duplicate key (23505), not null (23502)
+    static bool isSkippableError(const PGresult* res);
+    // Phân loại theo SQLSTATE của result lỗi
+    static DBExecResult classifyError(const PGresult* res);
     // Thêm vào public:
     bool tableExists(const std::string& schema, const std::string& table);
 
 
 private:
+    struct BatchRunResult {
+        bool failed = false;
+        long failedIndex = -1;      // index trong sqlBatch; -1 = BEGIN / SAVEPOINT / COMMIT / lỗi connection
+        long savepointAt = -1;      // vị trí savepoint cuối cùng đặt thành công trước lỗi (-1 = không có)
+        bool skippable = false;
+        DBExecResult errorClass = DBExecResult::UNKNOWN_ERROR;
+        std::string error;
+    };
+
+    static void recordStepResult(const BatchStep& step, const PGresult* res, BatchRunResult& result);
+    bool runSequential(const std::vector<std::string>& sqlBatch, const std::vector<uint8_t>& skip,
+                       size_t from, bool resume, BatchRunResult& result);
+    bool runPipeline(const std::vector<std::string>& sqlBatch, const std::vector<uint8_t>& skip,
+                     size_t from, bool resume, BatchRunResult& result);
+
     std::string host;
     int port;
     std::string user;
@@ -71,5 +115,11 @@ private:
     std::string sslkey;
     PGconn* conn = nullptr;
     std::mutex connMutex;
+    size_t savepointInterval = 100;
+#ifdef LIBPQ_HAS_PIPELINING
+    bool pipelineEnabled = true;
+#else
+    bool pipelineEnabled = false;
+#endif
 };
 
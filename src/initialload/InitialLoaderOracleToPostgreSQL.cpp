@@ -132,7 +132,11 @@ bool InitialLoaderOracleToPostgreSQL::runInitialLoadForTable(
                         jsonVal.SetNull();
                     } else if (colType.find("number") != std::string::npos ||
                                colType == "float" || colType == "decimal") {
-                        jsonVal.SetDouble(std::stod(value));
+                        // Giữ nguyên chuỗi số của Oracle (không round qua double)
+                        if (SQLUtils::isNumericLiteral(value.data(), value.size()))
+                            jsonVal.SetString(value.c_str(), static_cast<rapidjson::SizeType>(value.length()), allocator);
+                        else
+                            jsonVal.SetDouble(std::stod(value));
 		    } else if (colType.find("timestamp") != std::string::npos ||
            			colType == "date") {
 			if (value != "NULL" && value != "0") {
@@ -239,7 +243,11 @@ bool InitialLoaderOracleToPostgreSQL::runInitialLoadForTable(
                     }
                     else if (colType.find("number") != std::string::npos ||
                              colType == "float" || colType == "decimal") {
-                        jsonVal.SetDouble(std::stod(value));
+                        // Giữ nguyên chuỗi số của Oracle (không round qua double)
+                        if (SQLUtils::isNumericLiteral(value.data(), value.size()))
+                            jsonVal.SetString(value.c_str(), static_cast<rapidjson::SizeType>(value.length()), allocator);
+                        else
+                            jsonVal.SetDouble(std::stod(value));
                     }
                     else if (colType.find("timestamp") != std::string::npos ||
                              colType == "date") {
@@ -33,8 +33,8 @@ std::string SchemaMapper::mapOracleToPostgreSQL(
     const std::string fullTable = schema + "." + table;
     const auto& pkMap = FilterConfigLoader::getInstance().getPrimaryKeyColumns();
     auto it = pkMap.find(fullTable);
-    if (it != pkMap.end()) {
-        std::string pkLower = SQLUtils::toLower(it->second);
+    if (it != pkMap.end() && !it->second.empty()) {
+        std::string pkLower = SQLUtils::toLower(FilterEntry::joinKeys(it->second));
         sql += ",\n  primary key (" + pkLower + ")";
     }
 
@@ -0,0 +1,59 @@
+#include "CommitWatermark.h"
+#include "../metrics/MetricsExporter.h"
+#include <algorithm>
+#include <vector>
+
+CommitWatermark& CommitWatermark::getInstance() {
+    static CommitWatermark instance;
+    return instance;
+}
+
+void CommitWatermark::track(const std::string& topic, int32_t partition, int64_t offset) {
+    std::lock_guard<std::mutex> lock(mtx);
+    partitions[{topic, partition}].inflight.insert(offset);
+}
+
+bool CommitWatermark::completeLocked(const std::string& topic, int32_t partition, int64_t offset, bool commit,
+                                     int64_t& upTo) {
+    auto it = partitions.find({topic, partition});
+    // Partition đã reset sau rebalance, hoặc message không được track
+    if (it == partitions.end() || it->second.inflight.erase(offset) == 0) return false;
+
+    Partition& p = it->second;
+    p.highestDone = std::max(p.highestDone, offset);
+    const int64_t mark = p.inflight.empty() ? p.highestDone : *p.inflight.begin() - 1;
+    if (!commit || mark <= p.committed) return false;
+
+    p.committed = mark;
+    upTo = mark;
+    return true;
+}
+
+bool CommitWatermark::complete(const std::string& topic, int32_t partition, int64_t offset, int64_t& upTo) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return completeLocked(topic, partition, offset, true, upTo);
+}
+
+void CommitWatermark::markDone(const std::string& topic, int32_t partition, int64_t offset) {
+    std::lock_guard<std::mutex> lock(mtx);
+    int64_t ignored = 0;
+    completeLocked(topic, partition, offset, false, ignored);
+}
+
+void CommitWatermark::reset(const std::string& topic, int32_t partition) {
+    std::lock_guard<std::mutex> lock(mtx);
+    partitions.erase({topic, partition});
+}
+
+void CommitWatermark::reportMetrics() {
+    std::vector<std::pair<std::pair<std::string, int32_t>, size_t>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& [key, p] : partitions) pending.emplace_back(key, p.inflight.size());
+    }
+    // Số message chưa ghi xong nằm sau watermark; tăng mãi = batch lỗi đang giữ commit của partition
+    for (const auto& [tp, count] : pending) {
+        MetricsExporter::getInstance().setGauge("kafka_uncommitted_messages", static_cast<double>(count),
+                                                {{"topic", tp.first}, {"partition", std::to_string(tp.second)}});
+    }
+}
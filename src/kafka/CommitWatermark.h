@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+// Offset được commit theo watermark liên tục của từng partition: chỉ commit tới offset mà mọi message
+// trước nó (cùng partition) đã ghi xong. Batch khác bảng / khác writer / bị spill xuống đĩa / ghi lỗi
+// hoàn thành không theo thứ tự offset → message chưa xong giữ watermark lại, restart thì Kafka giao lại
+// từ đó thay vì mất row đã bị commit vượt qua.
+class CommitWatermark {
+public:
+    static CommitWatermark& getInstance();
+
+    // Consumer: message vừa được đưa vào pipeline (theo thứ tự offset của partition)
+    void track(const std::string& topic, int32_t partition, int64_t offset);
+
+    // Message đã ghi xong. true: watermark tiến lên, mọi offset ≤ upTo đã xong → caller commit upTo + 1
+    bool complete(const std::string& topic, int32_t partition, int64_t offset, int64_t& upTo);
+    // Message không sinh row nào: xong nhưng không tự commit, watermark được commit ở lần complete kế tiếp
+    void markDone(const std::string& topic, int32_t partition, int64_t offset);
+
+    // Rebalance: bỏ trạng thái của partition (message cũ hoàn thành sau đó bị bỏ qua)
+    void reset(const std::string& topic, int32_t partition);
+
+    void reportMetrics();
+
+private:
+    CommitWatermark() = default;
+
+    struct Partition {
+        std::set<int64_t> inflight;     // đã track, chưa xong (kể cả batch ghi lỗi)
+        int64_t highestDone = -1;
+        int64_t committed = -1;
+    };
+
+    bool completeLocked(const std::string& topic, int32_t partition, int64_t offset, bool commit, int64_t& upTo);
+
+    std::mutex mtx;
+    std::map<std::pair<std::string, int32_t>, Partition> partitions;
+};
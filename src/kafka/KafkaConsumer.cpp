@@ -4,6 +4,7 @@
 #include "../metrics/MetricsServer.h"
 #include "../metrics/MetricsExporter.h"
 #include "../writer/CheckpointManager.h"
+#include "CommitWatermark.h"
 #include "../utils/KafkaMessageWrapper.h"
 
 #include <rapidjson/document.h>
@@ -215,6 +216,7 @@ bool KafkaConsumer::consumeMessage(std::string& message, int& partition, int64_t
 
     if (rawMsg) *rawMsg = msg;
     // Đừng gọi rd_kafka_message_destroy() ở đây nữa — sẽ destroy sau khi ghi thành công
+    CommitWatermark::getInstance().track(rd_kafka_topic_name(msg->rkt), msg->partition, msg->offset);
     return true;
 }
 
@@ -365,22 +367,59 @@ void KafkaConsumer::commitOffset(rd_kafka_message_t* message) {
         return;
     }
 
-    std::string topic = rd_kafka_topic_name(message->rkt);
-    int partition = message->partition;
-    int64_t offset = message->offset;
+    commitOffset(rd_kafka_topic_name(message->rkt), message->partition, message->offset);
+}
+
+void KafkaConsumer::commitOffset(const std::string& topic, int32_t partition, int64_t offset) {
+    if (!consumer) {
+        OpenSync::Logger::error("❌ Consumer not initialized for offset commit.");
+        return;
+    }
+
+    // Chỉ commit khi watermark liên tục của partition tiến lên: message trước đó còn đang ghi / spill / lỗi
+    // thì offset này chưa được commit (được commit cùng watermark sau)
+    int64_t upTo = 0;
+    if (!CommitWatermark::getInstance().complete(topic, partition, offset, upTo)) return;
+
+    rd_kafka_topic_partition_list_t* offsets = rd_kafka_topic_partition_list_new(1);
+    rd_kafka_topic_partition_list_add(offsets, topic.c_str(), partition)->offset = upTo + 1;
+    rd_kafka_resp_err_t err = rd_kafka_commit(consumer, offsets, 0);
+    rd_kafka_topic_partition_list_destroy(offsets);
 
-    rd_kafka_resp_err_t err = rd_kafka_commit_message(consumer, message, 0);
     if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
         OpenSync::Logger::error("❌ Failed to commit offset: " + std::string(rd_kafka_err2str(err)));
     } else {
         //OpenSync::Logger::info("✅ Kafka offset committed: topic=" + topic +
         //                       ", partition=" + std::to_string(partition) +
-        //                       ", offset=" + std::to_string(offset));
+        //                       ", offset=" + std::to_string(upTo));
         // Ghi checkpoint vào file ngay sau khi commit offset
-        CheckpointManager::getInstance(filterConfigPath).updateCheckpoint(topic, partition, offset);
+        CheckpointManager::getInstance(filterConfigPath).updateCheckpoint(topic, partition, upTo);
     }
 }
 
+bool KafkaConsumer::setConsumptionPaused(bool pause) {
+    if (!consumer) return false;
+
+    rd_kafka_topic_partition_list_t* assignment = nullptr;
+    rd_kafka_resp_err_t err = rd_kafka_assignment(consumer, &assignment);
+    if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+        OpenSync::Logger::error("❌ Failed to get Kafka assignment: " + std::string(rd_kafka_err2str(err)));
+        return false;
+    }
+
+    if (assignment->cnt > 0) {
+        err = pause ? rd_kafka_pause_partitions(consumer, assignment) : rd_kafka_resume_partitions(consumer, assignment);
+    }
+    rd_kafka_topic_partition_list_destroy(assignment);
+
+    if (err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+        OpenSync::Logger::error(std::string("❌ Failed to ") + (pause ? "pause" : "resume") +
+                                " Kafka partitions: " + rd_kafka_err2str(err));
+        return false;
+    }
+    return true;
+}
+
 void KafkaConsumer::rebalanceCallback(rd_kafka_t* rk,
                                      rd_kafka_resp_err_t err,
                                      rd_kafka_topic_partition_list_t* partitions,
@@ -396,6 +435,7 @@ void KafkaConsumer::rebalanceCallback(rd_kafka_t* rk,
             rd_kafka_topic_partition_t* p = partitions->elems + i;
             std::string topic = p->topic;
             int partition = p->partition;
+            CommitWatermark::getInstance().reset(topic, partition);
             int64_t offset = checkpointMgr.getLastCheckpoint(topic, partition);
 
             if (offset >= 0) {
@@ -438,6 +478,9 @@ void KafkaConsumer::rebalanceCallback(rd_kafka_t* rk,
         }
     } else if (err == RD_KAFKA_RESP_ERR__REVOKE_PARTITIONS) {
         OpenSync::Logger::info("⚖️ Rebalancing: revoking partitions...");
+        for (int i = 0; i < partitions->cnt; ++i) {
+            CommitWatermark::getInstance().reset(partitions->elems[i].topic, partitions->elems[i].partition);
+        }
         rd_kafka_assign(rk, nullptr);
     } else {
         OpenSync::Logger::error("⚠️ Rebalance error: " + std::string(rd_kafka_err2str(err)));
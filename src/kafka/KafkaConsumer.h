@@ -32,7 +32,13 @@ public:
     bool isTableFiltered(const std::string& owner, const std::string& table);  // 🔹 Thêm khai báo hàm isTableFiltered
     void printPartitionOffset(int partition, int64_t offset, int64_t timestamp, const std::string& table); // Hiển thị partition & offset
     void printFilteredTables(); 
+    // Message đã ghi xong; offset chỉ thực sự được commit tới watermark liên tục của partition (CommitWatermark)
     void commitOffset(rd_kafka_message_t* message);
+    // Commit theo vị trí khi message đã bị destroy (giống commitOffset(message))
+    void commitOffset(const std::string& topic, int32_t partition, int64_t offset);
+    // Pause / resume fetch của mọi partition đang được assign (backpressure theo MemoryAccountant).
+    // Partition mới assign sau rebalance không bị pause → gọi lại setConsumptionPaused(true) định kỳ.
+    bool setConsumptionPaused(bool pause);
 
     //bool isMessageProcessed(const std::string& message);
     //void markMessageProcessed(const std::string& message);
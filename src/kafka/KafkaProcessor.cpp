@@ -6,6 +6,10 @@
 #include "../logger/Logger.h"
 #include "../utils/SQLUtils.h"
 #include "../common/TimeUtils.h"
+#include "../common/RowKeyHash.h"
+#include "../common/TableBatchPool.h"
+#include "../common/MemoryAccountant.h"
+#include "../writer/TableHealthRegistry.h"
 #include "FileWatcher.h"
 #include <sstream>
 #include <iostream>
@@ -36,6 +40,7 @@ namespace fs = std::filesystem;
 KafkaProcessor::KafkaProcessor(ConfigLoader& config) : config(config), stopReloading(false), messagesProcessed(0), lastUpdateTime(std::time(nullptr)) {
     std::string isoLogFlag = config.getConfig("enable_iso_log");
     enableISODebugLog = (isoLogFlag == "true" || isoLogFlag == "1");
+    updateChangedColumnsOnly = config.getBool("update_changed_columns_only", true);
 
     lastModifiedTime = fs::file_time_type::clock::now();
     metricUpdateThread = std::thread(&KafkaProcessor::updateProcessingRate, this);
@@ -62,6 +67,28 @@ void KafkaProcessor::setMapping(const std::unordered_map<std::string, std::strin
     mapping = mappingConfig;
 }
 
+std::string KafkaProcessor::mappedTableKey(const std::string& owner, const std::string& table) const {
+    auto ownerIt = mapping.find(owner);
+    auto tableIt = mapping.find(table);
+    return (ownerIt != mapping.end() ? ownerIt->second : owner) + "." +
+           (tableIt != mapping.end() ? tableIt->second : table);
+}
+
+void KafkaProcessor::appendDependencyKeys(TableBatch& batch, const FilterEntry& filter,
+                                          const rapidjson::Value& row, const rapidjson::Value* previous) const {
+    for (const auto& fk : filter.foreignKeys) {
+        // Cùng hash với RowKeyHash của row cha (table key đã map + giá trị PK)
+        const std::string parentKey = mappedTableKey(fk.parentOwner, fk.parentTable);
+        const uint64_t current = RowKeyHash::compute(parentKey, row, fk.columns);
+        if (current != RowKeyHash::UNKNOWN) batch.dependencyKeys.push_back(current);
+        if (previous) {
+            // Update đổi FK: phụ thuộc cả row cha cũ
+            const uint64_t old = RowKeyHash::compute(parentKey, *previous, fk.columns);
+            if (old != RowKeyHash::UNKNOWN && old != current) batch.dependencyKeys.push_back(old);
+        }
+    }
+}
+
 std::string normalizeString(const std::string& str) {
     std::string result = str;
     std::transform(result.begin(), result.end(), result.begin(), ::toupper);
@@ -70,6 +97,18 @@ std::string normalizeString(const std::string& str) {
     return result;
 }
 
+void KafkaProcessor::applyQuarantineOverrides(const std::vector<FilterEntry>& filterEntries) const {
+    // FilterConfigLoader giữ cả entry của các lần load trước: entry sau (mới nhất) thắng
+    std::unordered_map<std::string, TableHealthRegistry::Override> overrides;
+    for (const auto& f : filterEntries) {
+        overrides[mappedTableKey(f.owner, f.table)] = TableHealthRegistry::parseOverride(f.quarantine);
+    }
+    for (auto it = overrides.begin(); it != overrides.end();) {
+        it = it->second == TableHealthRegistry::Override::AUTO ? overrides.erase(it) : std::next(it);
+    }
+    TableHealthRegistry::getInstance().setOverrides(overrides);
+}
+
 std::optional<FilterEntry> KafkaProcessor::matchFilter(const std::string& owner, const std::string& table) {
     std::lock_guard<std::mutex> lock(filterMutex);
     for (const auto& filter : filters) {
@@ -80,19 +119,75 @@ std::optional<FilterEntry> KafkaProcessor::matchFilter(const std::string& owner,
     return std::nullopt;
 }
 
-std::unordered_map<std::string, std::vector<std::string>> KafkaProcessor::processMessageByTable(
+bool KafkaProcessor::buildChangedRowImage(const rapidjson::Value& before, const rapidjson::Value& after,
+                                          const std::vector<std::string>& primaryKey, rapidjson::Value& out,
+                                          rapidjson::Document::AllocatorType& allocator) {
+    auto addMember = [&](const rapidjson::Value& name, const rapidjson::Value& val) {
+        rapidjson::Value key(rapidjson::StringRef(name.GetString(), name.GetStringLength()));
+        rapidjson::Value copy;
+        if (val.IsString()) copy.SetString(rapidjson::StringRef(val.GetString(), val.GetStringLength()));
+        else copy.CopyFrom(val, allocator);
+        out.AddMember(key, copy, allocator);
+    };
+
+    auto isKeyColumn = [&primaryKey](const rapidjson::Value& name) {
+        for (const auto& key : primaryKey) {
+            if (key.size() == name.GetStringLength() && key.compare(0, key.size(), name.GetString(), name.GetStringLength()) == 0)
+                return true;
+        }
+        return false;
+    };
+
+    out.SetObject();
+    size_t changed = 0;
+    for (auto it = after.MemberBegin(); it != after.MemberEnd(); ++it) {
+        if (isKeyColumn(it->name)) {
+            addMember(it->name, it->value);
+            continue;
+        }
+        // Cột không có trong before (OLR chỉ gửi cột thay đổi) → coi như thay đổi
+        auto prev = before.FindMember(it->name);
+        if (prev != before.MemberEnd() && prev->value == it->value) continue;
+
+        addMember(it->name, it->value);
+        ++changed;
+    }
+
+    // after không mang (đủ) PK (changed-columns-only) → lấy các cột PK còn thiếu từ before
+    for (const auto& key : primaryKey) {
+        if (after.HasMember(key.c_str())) continue;
+        auto pk = before.FindMember(key.c_str());
+        if (pk != before.MemberEnd()) addMember(pk->name, pk->value);
+    }
+    return changed > 0;
+}
+
+bool KafkaProcessor::buildPrimaryKeyText(const rapidjson::Value& row, const std::vector<std::string>& primaryKey, std::string& out) {
+    out.clear();
+    if (primaryKey.empty()) return false;
+    for (const auto& key : primaryKey) {
+        auto it = row.FindMember(key.c_str());
+        if (it == row.MemberEnd()) return false;
+        if (!out.empty()) out += '\x1f';
+        out += SQLUtils::convertToSQLValue(it->value, key);
+    }
+    return true;
+}
+
+std::unordered_map<std::string, TableBatch> KafkaProcessor::processMessageByTable(
     const std::string& jsonMessage, int partition, int64_t offset, int64_t timestamp) {
 
-    (void)partition;
-    (void)offset;
     (void)timestamp;
 
-    std::unordered_map<std::string, std::vector<std::string>> batchMap;
+    std::unordered_map<std::string, TableBatch> batchMap;
     rapidjson::Document doc;
-    if (doc.Parse(jsonMessage.c_str()).HasParseError()) {
+    // Số giữ dạng chuỗi gốc → NUMBER(38) / ID > 2^53 không bị round qua double
+    if (doc.Parse<rapidjson::kParseNumbersAsStringsFlag>(jsonMessage.c_str(), jsonMessage.size()).HasParseError()) {
 	    OpenSync::Logger::error("KafkaProcessor: JSON parse error");
         return batchMap;
     }
+    // DOM đã parse sống tới hết hàm
+    MemoryAccountant::Scoped docCharge(MemoryAccountant::PARSED_DOCS, doc.GetAllocator().Size());
     if (!doc.HasMember("payload") || !doc["payload"].IsArray()) {
 	OpenSync::Logger::warn("⚠️ Missing or invalid payload array");
 	return batchMap;
@@ -174,6 +269,9 @@ std::unordered_map<std::string, std::vector<std::string>> KafkaProcessor::proces
 
         std::string sql;
         std::string opType;
+        uint64_t keyHash = RowKeyHash::UNKNOWN;
+        const rapidjson::Value* keyRow = nullptr;       // row đọc giá trị FK
+        const rapidjson::Value* previousRow = nullptr;  // update: FK cũ (before)
 
         // 💥 NEW: get sqlBuilder safely
         //auto it = sqlBuilders.find("oracle");
@@ -185,10 +283,17 @@ std::unordered_map<std::string, std::vector<std::string>> KafkaProcessor::proces
         }
         SQLBuilderBase* builder = it->second.get();
 
-        if (op == "c" && record.HasMember("after")) {
+        if (op == "c" && record.HasMember("after") && filter->isUpsert()) {
+            // Upsert idempotent khi replay → không cần dedup cache, không còn đường ORA-00001/duplicate key
+            sql = builder->buildUpsertSQL(mappedOwner, mappedTable, record["after"], *filter);
+            keyHash = RowKeyHash::compute(tableKey, record["after"], filter->primaryKey);
+            keyRow = &record["after"];
+            opType = "upsert";
+
+        } else if (op == "c" && record.HasMember("after")) {
             const auto& data = record["after"];
-            if (data.HasMember(filter->primaryKey.c_str())) {
-                std::string pkValue = SQLUtils::convertToSQLValue(data[filter->primaryKey.c_str()], filter->primaryKey);
+            std::string pkValue;
+            if (buildPrimaryKeyText(data, filter->primaryKey, pkValue)) {
                 std::string dedupKey = tableKey + ":" + pkValue;
 
                 if (batchDedupCache[tableKey].count(dedupKey)) {
@@ -214,20 +319,47 @@ std::unordered_map<std::string, std::vector<std::string>> KafkaProcessor::proces
             }
 
             sql = builder->buildInsertSQL(mappedOwner, mappedTable, data);
+            keyHash = RowKeyHash::compute(tableKey, data, filter->primaryKey);
+            keyRow = &data;
 	    OpenSync::Logger::debug("🔎 op=" + op + ", has after=" + std::to_string(record.HasMember("after")));
             opType = "insert";
 
         } else if (op == "u" && record.HasMember("after")) {
-            sql = builder->buildUpdateSQL(mappedOwner, mappedTable, record["after"], filter->primaryKey);
+            const auto& after = record["after"];
+            keyRow = &after;
+            if (record.HasMember("before") && record["before"].IsObject()) previousRow = &record["before"];
+            if (updateChangedColumnsOnly && record.HasMember("before") && record["before"].IsObject()) {
+                // SET chỉ gồm cột thay đổi; statement template tự cache theo column set
+                rapidjson::Value changed;
+                if (!buildChangedRowImage(record["before"], after, filter->primaryKey, changed, doc.GetAllocator())) {
+                    MetricsExporter::getInstance().incrementCounter("kafka_noop_updates_skipped", {{"table", tableKey}});
+                    continue;
+                }
+                sql = builder->buildUpdateSQL(mappedOwner, mappedTable, changed, filter->primaryKey);
+                keyHash = RowKeyHash::compute(tableKey, changed, filter->primaryKey);
+            } else {
+                sql = builder->buildUpdateSQL(mappedOwner, mappedTable, after, filter->primaryKey);
+                keyHash = RowKeyHash::compute(tableKey, after, filter->primaryKey);
+            }
             opType = "update";
 
         } else if (op == "d" && record.HasMember("before")) {
             sql = builder->buildDeleteSQL(mappedOwner, mappedTable, record["before"], filter->primaryKey);
+            keyHash = RowKeyHash::compute(tableKey, record["before"], filter->primaryKey);
+            keyRow = &record["before"];
             opType = "delete";
         }
 
         if (!sql.empty()) {
-            batchMap[tableKey].push_back(sql);
+            auto [entry, inserted] = batchMap.try_emplace(tableKey);
+            if (inserted) entry->second = TableBatchPool::getInstance().acquireBatch();
+            auto& batch = entry->second;
+            batch.sqls.push_back(std::move(sql));
+            batch.keyHashes.push_back(keyHash);
+            batch.origins.push_back({static_cast<int32_t>(partition), offset});
+            if (!filter->foreignKeys.empty() && keyRow) {
+                appendDependencyKeys(batch, *filter, *keyRow, previousRow);
+            }
             MetricsExporter::getInstance().incrementCounter("kafka_messages_processed");
             MetricsExporter::getInstance().incrementCounter("kafka_ops_total", {
                 {"table", tableKey},
@@ -273,10 +405,16 @@ void KafkaProcessor::loadFilterConfig(const std::string& configPath) {
 		        FilterEntry fe;
 		        fe.owner = entry["owner"].GetString();
 		        fe.table = entry["table"].GetString();
-		        fe.primaryKey = entry["primaryKey"].GetString();
+		        fe.primaryKey = FilterEntry::parsePrimaryKey(entry["primaryKey"]);
 		        if (entry.HasMember("pk_index") && entry["pk_index"].IsString()) {
     		        fe.pkIndex = entry["pk_index"].GetString();
 		        }
+		        if (entry.HasMember("apply_mode") && entry["apply_mode"].IsString()) {
+		            fe.applyMode = entry["apply_mode"].GetString();
+		        }
+		        if (entry.HasMember("foreignKeys")) {
+		            fe.foreignKeys = FilterEntry::parseForeignKeys(entry["foreignKeys"]);
+		        }
 		        newFilters.push_back(fe);
             }
         }
@@ -319,6 +457,7 @@ void KafkaProcessor::startAutoReload(const std::string& configPath, KafkaConsume
                 }
 
                 filters = newFilters;
+                applyQuarantineOverrides(newFilters);
                 OpenSync::Logger::info("✅ Processor reloaded filter config.");
 
                 // 👉 Nếu có KafkaConsumer truyền vào, reload luôn
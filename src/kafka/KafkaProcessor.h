@@ -10,6 +10,7 @@
 #include <filesystem>
 #include <rapidjson/document.h>
 #include "../common/FilterEntry.h"
+#include "../common/TableBatch.h"
 #include "../reader/ConfigLoader.h"
 #include "../schema/OracleColumnInfo.h"
 #include "../sqlbuilder/SQLBuilderBase.h"
@@ -45,18 +46,23 @@ public:
 
     void addFilter(const FilterEntry& filter);
     void setMapping(const std::unordered_map<std::string, std::string>& mappingConfig);
+    // "OWNER.TABLE" sau khi áp mapping (cùng dạng tableKey của processMessageByTable)
+    std::string mappedTableKey(const std::string& owner, const std::string& table) const;
+    // "quarantine" của filter → TableHealthRegistry (lúc khởi động và mỗi lần reload filter config)
+    void applyQuarantineOverrides(const std::vector<FilterEntry>& filterEntries) const;
     void loadFilterConfig(const std::string& configPath);
     bool isCurrentlyReloading();
     //void startAutoReload(const std::string& configPath);
     void startAutoReload(const std::string& configPath, KafkaConsumer* consumer = nullptr);
     void printPartitionOffset(int partition, int64_t offset, int64_t timestamp, const std::string& table);
 
-    std::unordered_map<std::string, std::vector<std::string>> processMessageByTable(
+    // Mỗi bảng: sqls + keyHashes song song (messages do worker gắn)
+    std::unordered_map<std::string, TableBatch> processMessageByTable(
         const std::string& jsonMessage, int partition, int64_t offset, int64_t timestamp);
 
     std::string buildInsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data);
-    std::string buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey);
-    std::string buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey);
+    std::string buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey);
+    std::string buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey);
 
     //void setKafkaTopic(const std::string& topic) { kafkaTopic = topic; }
     void setKafkaTopic(const std::string& topic);
@@ -82,6 +88,17 @@ public:
 
 private:
     std::optional<FilterEntry> matchFilter(const std::string& owner, const std::string& table);
+
+    // Row image chỉ gồm cột thay đổi (before → after) + PK; false nếu không có cột nào ngoài PK thay đổi.
+    // String trong out trỏ vào document gốc (không copy).
+    static bool buildChangedRowImage(const rapidjson::Value& before, const rapidjson::Value& after,
+                                     const std::vector<std::string>& primaryKey, rapidjson::Value& out,
+                                     rapidjson::Document::AllocatorType& allocator);
+    // Giá trị các cột PK nối bằng \x1f (dedup key); false nếu row thiếu cột PK
+    static bool buildPrimaryKeyText(const rapidjson::Value& row, const std::vector<std::string>& primaryKey, std::string& out);
+    // Hash PK của row cha theo từng FK của filter → batch.dependencyKeys
+    void appendDependencyKeys(TableBatch& batch, const FilterEntry& filter,
+                              const rapidjson::Value& row, const rapidjson::Value* previous) const;
     void updateProcessingRate();
 
     std::vector<FilterEntry> filters;
@@ -94,6 +111,7 @@ private:
     std::mutex filterReloadMutex;
 
     ConfigLoader& config;
+    bool updateChangedColumnsOnly = true;  // "update_changed_columns_only"
     std::atomic<bool> isReloading{false};
     std::atomic<bool> stopReloading{false};
 
@@ -3,12 +3,25 @@
 #include <atomic>
 #include <csignal>
 #include <chrono>
+#include <algorithm>
 #include "app/AppInitializer.h"
 #include "writer/CheckpointManager.h"
 //#include "metrics/SystemMetricsUtils.h"
 #include "thread/workerthread/WorkerThread.h"
 #include "thread/dbwriterthread/DBWriterThread.h"
 #include "thread/KafkaConsumerThread.h"
+#include "common/Queues.h"
+#include "common/TableBatchAggregator.h"
+#include "common/TableBatchPool.h"
+#include "common/MemoryAccountant.h"
+#include "utils/ThreadPlacement.h"
+#include "thread/dbwriterthread/ApplyLaneRouter.h"
+#include "thread/dbwriterthread/WriteSetScheduler.h"
+#include "thread/dbwriterthread/AsyncPgWriter.h"
+#include "writer/DeadLetterStore.h"
+#include "writer/TableHealthRegistry.h"
+#include "db/postgresql/PostgreSQLConnector.h"
+#include "reader/FilterConfigLoader.h"
 #include "schema/OracleSchemaCache.h"
 #include "logger/Logger.h"
 
@@ -45,11 +58,101 @@ int main() {
     int batchFlushIntervalMs = config.getInt("batch_flush_interval_ms", 1000);
     int numWorkers = config.getInt("num_workers", 4);
     int numDBWriters = config.getInt("num_db_writers", 1);
+    int applyLanesPerTable = config.getInt("apply_lanes_per_table", 1);
+    bool applyDependencyTracking = config.getBool("apply_dependency_tracking", false);
+    int kafkaQueueMaxMB = config.getInt("kafka_queue_max_mb", 256);   // 0 = chỉ giới hạn theo số message
+    int applyQueueMaxMB = config.getInt("apply_queue_max_mb", 256);
+    bool applySpill = config.getBool("apply_spill.enabled", false);
+    int memoryBudgetMB = config.getInt("memory_budget_mb", 0);          // 0 = chỉ đếm, không pause
+    int memoryPausePct = config.getInt("memory_budget_pause_pct", 90);
+    int memoryResumePct = config.getInt("memory_budget_resume_pct", 70);
+    int batchPoolMaxMB = config.getInt("batch_pool_max_mb", 64);     // vector / string rảnh pool được giữ lại
+    int batchMaxBytesCfg = config.getInt("batch_max_bytes", 8 * 1024 * 1024);  // 0 = chỉ giới hạn theo batch_size
+    size_t batchMaxBytes = batchMaxBytesCfg > 0 ? static_cast<size_t>(batchMaxBytesCfg) : 0;
+    std::string dbType = config.getConfig("db_type", "oracle");
+    // PostgreSQL: vài thread event loop, mỗi thread giữ nhiều connection non-blocking thay cho num_db_writers thread
+    bool pgAsyncWriter = dbType == "postgresql" && config.getBool("pg_async_writer.enabled", false);
+    if (pgAsyncWriter && !config.getBool("pg_pipeline", true)) {
+        // Event loop gửi cả batch trong một pipeline; pg_pipeline=false chỉ chạy được trên writer blocking
+        OpenSync::Logger::warn("⚠️ pg_async_writer requires pipeline mode but pg_pipeline=false, "
+                               "using " + std::to_string(std::max(numDBWriters, 1)) + " blocking DB writers instead");
+        pgAsyncWriter = false;
+    }
+    int pgAsyncThreads = std::max(config.getInt("pg_async_writer.threads", 2), 1);
+    int pgAsyncConnections = std::max(config.getInt("pg_async_writer.connections", 32), 1);
+    size_t applyQueues = static_cast<size_t>(pgAsyncWriter ? pgAsyncConnections : std::max(numDBWriters, 1));
 
     OpenSync::Logger::info("batch_size = " + std::to_string(batchSize));
     OpenSync::Logger::info("batch_flush_interval_ms = " + std::to_string(batchFlushIntervalMs));
     OpenSync::Logger::info("num_workers = " + std::to_string(numWorkers));
     OpenSync::Logger::info("num_db_writers = " + std::to_string(numDBWriters));
+    OpenSync::Logger::info("batch_max_bytes = " + std::to_string(batchMaxBytes));
+    OpenSync::Logger::info("apply_lanes_per_table = " + std::to_string(applyLanesPerTable));
+    OpenSync::Logger::info(std::string("apply_dependency_tracking = ") + (applyDependencyTracking ? "true" : "false"));
+    if (pgAsyncWriter) {
+        OpenSync::Logger::info("pg_async_writer = " + std::to_string(pgAsyncConnections) + " connections on " +
+                               std::to_string(pgAsyncThreads) + " threads");
+    }
+
+    // Batch theo bảng dùng chung cho mọi worker
+    TableBatchAggregator::getInstance().configure(batchSize, batchMaxBytes, batchFlushIntervalMs);
+    TableBatchPool::getInstance().configure(batchSize, static_cast<size_t>(std::max(batchPoolMaxMB, 0)) * 1024 * 1024);
+    // Mỗi DB writer (hoặc connection của async writer) một queue; mỗi bảng chia thành apply_lanes_per_table lane theo PK hash
+    ApplyLaneRouter::getInstance().configure(applyQueues,
+                                             static_cast<size_t>(std::max(applyLanesPerTable, 1)), 2500,
+                                             static_cast<size_t>(std::max(applyQueueMaxMB, 0)) * 1024 * 1024);
+    if (config.getBool("dead_letter.enabled", true)) {
+        // Row lỗi dữ liệu được cô lập khỏi batch và ghi ra đây thay vì chặn cả bảng
+        DeadLetterStore::getInstance().configure(
+            config.getConfig("dead_letter.dir", "data/dead_letter"),
+            static_cast<size_t>(std::max(config.getInt("dead_letter.max_file_mb", 256), 0)) * 1024 * 1024,
+            config.getKafkaConfig("topic"));
+    }
+    if (config.getBool("table_health.enabled", true)) {
+        // Bảng lỗi liên tiếp (thiếu bảng đích, mất quyền...) bị quarantine: batch ra file hold, không chiếm writer
+        TableHealthRegistry::Options healthOptions;
+        healthOptions.degradedAfterFailures = std::max(config.getInt("table_health.degraded_after_failures", 2), 1);
+        healthOptions.quarantineAfterFailures = std::max(config.getInt("table_health.quarantine_after_failures", 5), 1);
+        healthOptions.probeIntervalSec = std::max(config.getInt("table_health.probe_interval_sec", 30), 1);
+        healthOptions.maxProbeIntervalSec = std::max(config.getInt("table_health.max_probe_interval_sec", 600),
+                                                     healthOptions.probeIntervalSec);
+        healthOptions.replayBatchSize = static_cast<size_t>(std::max(config.getInt("table_health.replay_batch_size", 1000), 1));
+        TableHealthRegistry::getInstance().configure(config.getConfig("table_health.hold_dir", "data/quarantine"),
+                                                     healthOptions);
+        processor.applyQuarantineOverrides(FilterConfigLoader::getInstance().getAllFilters());
+        // Probe / replay file hold trên thread riêng (không chiếm monitor thread); lịch probe do registry quyết định
+        writeData.startQuarantineProbes(dbType, std::chrono::seconds(1));
+    }
+    // (bảng, lane) gán writer theo consistent hash; định kỳ chuyển bảng rảnh từ writer nặng sang writer nhẹ
+    ApplyLaneRouter::getInstance().configureRebalance(config.getInt("apply_rebalance_interval_ms", 10000),
+                                                      config.getInt("apply_rebalance_imbalance_pct", 150) / 100.0);
+    if (applySpill) {
+        // Queue của writer đầy (DB chậm / ngừng) → batch đã build SQL xuống segment mmap, worker không bị block
+        ApplyLaneRouter::getInstance().enableSpill(
+            config.getConfig("apply_spill.dir", "data/spill"),
+            static_cast<size_t>(std::max(config.getInt("apply_spill.segment_mb", 64), 1)) * 1024 * 1024,
+            static_cast<size_t>(std::max(config.getInt("apply_spill.max_mb_per_writer", 4096), 0)) * 1024 * 1024);
+    }
+    kafkaMessageQueue.setMaxBytes(static_cast<size_t>(std::max(kafkaQueueMaxMB, 0)) * 1024 * 1024);
+    // Budget chung cho mọi stage: consumer pause partition trước khi vượt budget
+    MemoryAccountant::getInstance().configure(static_cast<size_t>(std::max(memoryBudgetMB, 0)) * 1024 * 1024,
+                                              memoryPausePct, memoryResumePct);
+
+    if (applyDependencyTracking) {
+        // Write-set scheduler: batch không xung đột (PK / FK cha) chạy song song trên mọi DB writer,
+        // batch xung đột chờ batch trước. Bảng nối bằng foreignKeys (filter config) được gom nhóm
+        // để batch ra khỏi aggregator đúng thứ tự nguồn; nhóm không cập nhật khi hot reload filter.
+        std::vector<std::pair<std::string, std::string>> fkEdges;
+        for (const auto& f : FilterConfigLoader::getInstance().getAllFilters()) {
+            for (const auto& fk : f.foreignKeys) {
+                fkEdges.emplace_back(processor.mappedTableKey(f.owner, f.table),
+                                     processor.mappedTableKey(fk.parentOwner, fk.parentTable));
+            }
+        }
+        WriteSetScheduler::getInstance().setEnabled(true);
+        TableBatchAggregator::getInstance().setDependencyGroups(fkEdges);
+        OpenSync::Logger::info("🔗 Write-set dependency tracking enabled, FK edges: " + std::to_string(fkEdges.size()));
+    }
 
     // Start metrics server
     std::thread metricsThread([&metrics]() { metrics.start(); });
@@ -61,24 +164,61 @@ int main() {
     auto& checkpointMgr = CheckpointManager::getInstance("checkpoints/checkpoints.txt");
     checkpointMgr.startAutoFlush(60);
 
+    // Tên thread, CPU affinity, NUMA policy theo section "threads"
+    auto& placement = ThreadPlacement::getInstance();
+    placement.configure(config);
+
     // Kafka Consumer thread
-    std::thread kafkaThread(kafkaConsumerThread, std::ref(consumer), std::ref(shouldShutdown));
+    std::thread kafkaThread([&consumer, &placement]() {
+        placement.apply("kafka_consumer", 0);
+        kafkaConsumerThread(consumer, shouldShutdown);
+    });
 
     // Worker threads
     std::vector<std::thread> workerThreads;
     for (int i = 0; i < numWorkers; ++i) {
-        workerThreads.emplace_back(workerThread, std::ref(processor), batchFlushIntervalMs, std::ref(shouldShutdown));
+        workerThreads.emplace_back([&processor, &placement, batchFlushIntervalMs, i]() {
+            placement.apply("worker", static_cast<size_t>(i));
+            workerThread(processor, batchFlushIntervalMs, shouldShutdown);
+        });
     }
 
     // DB Writer threads
     std::vector<std::thread> dbWriterThreads;
-    std::string dbType = config.getConfig("db_type", "oracle");
-    for (int i = 0; i < numDBWriters; ++i) {
-    	dbWriterThreads.emplace_back(dbWriterThread, std::ref(writeData), std::ref(consumer), dbType, std::ref(shouldShutdown));
+    if (pgAsyncWriter) {
+        std::string connInfo = PostgreSQLConnector::buildConnInfo(
+            config.getDBConfig("postgresql", "host"),
+            std::stoi(config.getDBConfig("postgresql", "port")),
+            config.getDBConfig("postgresql", "user"),
+            config.getDBConfig("postgresql", "password"),
+            config.getDBConfig("postgresql", "dbname"));
+        const size_t savepointInterval = static_cast<size_t>(std::max(config.getInt("pg_savepoint_interval", 100), 0));
+        const WriteDataToDB::RetryOptions retryOptions = writeData.getRetryOptions();
+        // Cùng breaker với WriteDataToDB: DB down → consumer pause, một probe nền thay vì mọi connection tự thử
+        auto breaker = writeData.findCircuitBreaker("postgresql");
+        for (int i = 0; i < pgAsyncThreads; ++i) {
+            dbWriterThreads.emplace_back([&consumer, &placement, connInfo, pgAsyncThreads, savepointInterval,
+                                          retryOptions, breaker, i]() {
+                placement.apply("db_writer", static_cast<size_t>(i));
+                asyncPgWriterThread(connInfo, consumer, static_cast<size_t>(i), static_cast<size_t>(pgAsyncThreads),
+                                    savepointInterval, retryOptions, breaker, shouldShutdown);
+            });
+        }
+    } else {
+        // Mở sẵn connection song song để writer không handshake tuần tự lúc khởi động
+        if (config.getBool("db_pool.warmup", true)) {
+            writeData.warmUpConnections(dbType, static_cast<size_t>(std::max(numDBWriters, 1)));
+        }
+        for (int i = 0; i < numDBWriters; ++i) {
+    	    dbWriterThreads.emplace_back([&writeData, &consumer, &placement, dbType, i]() {
+    	        placement.apply("db_writer", static_cast<size_t>(i));
+    	        dbWriterThread(writeData, consumer, dbType, static_cast<size_t>(i), shouldShutdown);
+    	    });
+        }
     }
 
 
-    OpenSync::Logger::info("✅ All threads started. Total: " + std::to_string(1 + numWorkers + numDBWriters + 2));
+    OpenSync::Logger::info("✅ All threads started. Total: " + std::to_string(1 + numWorkers + dbWriterThreads.size() + 2));
 
     // Wait for shutdown signal
     while (!shouldShutdown) {
@@ -86,6 +226,8 @@ int main() {
     }
 
     OpenSync::Logger::info("🛑 Stopping Data Sync System...");
+    // Writer đang chờ DB (circuit breaker / backoff) không giữ shutdown: batch chưa ghi sẽ được đọc lại từ Kafka
+    writeData.stopRetries();
 
     // Shutdown sequence
     if (kafkaThread.joinable()) kafkaThread.join();
@@ -2,17 +2,18 @@
 #include "../utils/MemoryUtils.h"
 #include "../logger/Logger.h"
 #include "../metrics/MetricsExporter.h"
-#include "../thread/ThreadSafeQueue.h"
+#include "../common/Queues.h"
 #include "../common/TableBatch.h"
+#include "../common/MemoryAccountant.h"
 #include "../kafka/KafkaProcessor.h"
+#include "../kafka/CommitWatermark.h"
+#include "../thread/dbwriterthread/ApplyLaneRouter.h"
+#include "../writer/TableHealthRegistry.h"
 #include <thread>
 #include <chrono>
 #include <fstream>
 #include <unistd.h>
-#include <malloc.h>
 
-extern ThreadSafeQueue<std::tuple<std::string, int, int64_t, int64_t, rd_kafka_message_t*>> kafkaMessageQueue;
-extern ThreadSafeQueue<std::tuple<std::string, TableBatch>> dbWriteQueue;
 extern KafkaProcessor* globalKafkaProcessor;
 
 static std::pair<int, int> getRSSandVMMemory() {
@@ -40,6 +41,7 @@ void MonitorManager::startMonitors(KafkaConsumer& consumer, WriteDataToDB& write
 
     using clock = std::chrono::steady_clock;
 
+
     std::thread([&stopFlag, &writeData, memoryInterval, metricsInterval, connectorInterval, bufferInterval, cleanupInterval, systemMetricsInterval]() {
         OpenSync::Logger::info("🔎 Unified Monitor thread started.");
 
@@ -67,9 +69,11 @@ void MonitorManager::startMonitors(KafkaConsumer& consumer, WriteDataToDB& write
 
             if (std::chrono::duration_cast<std::chrono::seconds>(now - lastMetricsCheck).count() >= metricsInterval) {
                 size_t kafkaSize = kafkaMessageQueue.size();
-                size_t dbQueueSize = dbWriteQueue.size();
+                size_t dbQueueSize = ApplyLaneRouter::getInstance().queuedTasks();
                 MetricsExporter::getInstance().setGauge("kafka_queue_size", kafkaSize, {});
                 MetricsExporter::getInstance().setGauge("db_queue_size", dbQueueSize, {});
+                MetricsExporter::getInstance().setGauge("apply_spill_tasks", ApplyLaneRouter::getInstance().spilledTasks(), {});
+                MetricsExporter::getInstance().setGauge("apply_spill_bytes", ApplyLaneRouter::getInstance().spilledBytes(), {});
                 auto [vm, rss] = MemoryUtils::getMemoryUsageMB();
                 MetricsExporter::getInstance().setGauge("vm_memory_mb", vm, {});
                 MetricsExporter::getInstance().setGauge("rss_memory_mb", rss, {});
@@ -77,6 +81,10 @@ void MonitorManager::startMonitors(KafkaConsumer& consumer, WriteDataToDB& write
             }
 
             if (std::chrono::duration_cast<std::chrono::seconds>(now - lastConnectorCheck).count() >= connectorInterval) {
+                // Đóng connection idle quá hạn, ping connection idle lâu chưa kiểm tra
+                writeData.maintainConnectionPools();
+                writeData.reportCircuitBreakerMetrics();
+                TableHealthRegistry::getInstance().reportMetrics();
                 writeData.reportMemoryUsagePerDBType();
                 lastConnectorCheck = now;
             }
@@ -92,7 +100,6 @@ void MonitorManager::startMonitors(KafkaConsumer& consumer, WriteDataToDB& write
                     OpenSync::Logger::info("🧹 Drained tableSQLBuffer, tables: " + std::to_string(bufferCopy.size()));
                     lastDrainedTableCount = bufferCopy.size();
                 }
-                malloc_trim(0);
                 lastCleanupCheck = now;
             }
 
@@ -111,6 +118,10 @@ void MonitorManager::startMonitors(KafkaConsumer& consumer, WriteDataToDB& write
                 size_t schemaMem = getOracleSchemaCacheMemoryUsage();
                 MetricsExporter::getInstance().setGauge("memory_usage_bytes", schemaMem, {{"component", "oracle_schema_cache"}});
 
+                // Byte các stage đang giữ theo memory budget (kafka_inflight, kafka_queue, parsed_docs, sql_pending, apply_queue)
+                MemoryAccountant::getInstance().reportMetrics();
+                CommitWatermark::getInstance().reportMetrics();
+
                 if (processor) {
                     auto lagMap = processor->getTotalLagByPartition();
                     for (const auto& [tp, lag] : lagMap) {
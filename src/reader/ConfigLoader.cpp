@@ -117,9 +117,29 @@ bool ConfigLoader::isLogISO8601Enabled() const {
 
 }
 
+const rapidjson::Value* ConfigLoader::findValue(const std::string& key) const {
+    if (!configJson.IsObject()) return nullptr;
+    auto direct = configJson.FindMember(key.c_str());
+    if (direct != configJson.MemberEnd()) return &direct->value;
+
+    const rapidjson::Value* node = &configJson;
+    size_t start = 0;
+    while (start <= key.size()) {
+        size_t dot = key.find('.', start);
+        if (dot == std::string::npos) dot = key.size();
+        const std::string part = key.substr(start, dot - start);
+        if (!node->IsObject()) return nullptr;
+        auto it = node->FindMember(part.c_str());
+        if (it == node->MemberEnd()) return nullptr;
+        node = &it->value;
+        start = dot + 1;
+    }
+    return node;
+}
+
 bool ConfigLoader::getBool(const std::string& key, bool defaultValue) const {
-    if (configJson.HasMember(key.c_str())) {
-        const auto& val = configJson[key.c_str()];
+    if (const rapidjson::Value* found = findValue(key)) {
+        const auto& val = *found;
         if (val.IsBool()) return val.GetBool();
         if (val.IsString()) {
             std::string str = val.GetString();
@@ -132,8 +152,8 @@ bool ConfigLoader::getBool(const std::string& key, bool defaultValue) const {
 }
 
 int ConfigLoader::getInt(const std::string& key, int defaultValue) const {
-    if (configJson.HasMember(key.c_str())) {
-        const auto& val = configJson[key.c_str()];
+    if (const rapidjson::Value* found = findValue(key)) {
+        const auto& val = *found;
         if (val.IsInt()) return val.GetInt();
         if (val.IsString()) {
             try {
@@ -230,8 +250,9 @@ bool ConfigLoader::shouldLogConfigToConsole() const {
 }
 
 std::string ConfigLoader::getConfig(const std::string& key, const std::string& defaultValue) const {
-    if (configJson.HasMember(key.c_str()) && configJson[key.c_str()].IsString()) {
-        return configJson[key.c_str()].GetString();
+    const rapidjson::Value* found = findValue(key);
+    if (found && found->IsString()) {
+        return found->GetString();
     }
     return defaultValue;
 }
@@ -29,6 +29,9 @@ public:
     std::string getConfig(const std::string& key, const std::string& defaultValue) const;
     int getTimestampUnit() const; // Thêm getter cho timestamp_unit
 private:
+    // key thường hoặc đường dẫn theo section: "monitor.metrics_monitor_interval_sec", "threads.worker.cpus"
+    const rapidjson::Value* findValue(const std::string& key) const;
+
     std::string configFilePath;
     rapidjson::Document configJson;
     std::map<std::string, std::string> configMap;
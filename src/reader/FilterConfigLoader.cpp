@@ -56,27 +56,38 @@ bool FilterConfigLoader::loadConfig(const std::string& filePath, const std::stri
         }*/
 
         if (entry.HasMember("primaryKey"))
-            filter.primaryKey = entry["primaryKey"].GetString();
+            filter.primaryKey = FilterEntry::parsePrimaryKey(entry["primaryKey"]);
         else if (entry.HasMember("primary_key"))
-            filter.primaryKey = entry["primary_key"].GetString();
+            filter.primaryKey = FilterEntry::parsePrimaryKey(entry["primary_key"]);
 
         if (entry.HasMember("pk_index"))
             filter.pkIndex = entry["pk_index"].GetString();
 
+        if (entry.HasMember("apply_mode") && entry["apply_mode"].IsString())
+            filter.applyMode = entry["apply_mode"].GetString();
+
+        if (entry.HasMember("foreignKeys"))
+            filter.foreignKeys = FilterEntry::parseForeignKeys(entry["foreignKeys"]);
+
+        if (entry.HasMember("quarantine") && entry["quarantine"].IsString())
+            filter.quarantine = entry["quarantine"].GetString();
+
         std::string fullTable = filter.owner + "." + filter.table;
 
         {
             std::lock_guard<std::mutex> lock(mutex);
             filters.push_back(filter);
+            primaryKeyMap[fullTable] = filter.primaryKey;
             if (!filter.pkIndex.empty()) {
                 pkIndexMap[fullTable] = filter.pkIndex;
-		OpenSync::Logger::info("✔️  Table added to filter: - " + fullTable + "  ↪️  PK: " + filter.primaryKey + " ↪️  With PK Index:" + filter.pkIndex);
+		OpenSync::Logger::info("✔️  Table added to filter: - " + fullTable + "  ↪️  PK: " + FilterEntry::joinKeys(filter.primaryKey) + " ↪️  With PK Index:" + filter.pkIndex + " ↪️  Mode: " + filter.applyMode);
             } else {
 		OpenSync::Logger::info("✔️  Table added to filter: - " + fullTable + " (No PK Index hint)");
             }
         }
     }
 
+    generation.fetch_add(1, std::memory_order_acq_rel);
     return true;
 }
 
@@ -96,8 +107,8 @@ std::vector<FilterEntry> FilterConfigLoader::getAllFilters() const {
     return filters;
 }
 
-std::unordered_map<std::string, std::string> FilterConfigLoader::getPrimaryKeyColumns() const {
-    std::unordered_map<std::string, std::string> result;
+std::unordered_map<std::string, std::vector<std::string>> FilterConfigLoader::getPrimaryKeyColumns() const {
+    std::unordered_map<std::string, std::vector<std::string>> result;
     std::lock_guard<std::mutex> lock(mutex);
     for (const auto& filter : filters) {
         std::string fullTable = filter.owner + "." + filter.table;
@@ -105,3 +116,9 @@ std::unordered_map<std::string, std::string> FilterConfigLoader::getPrimaryKeyCo
     }
     return result;
 }
+
+std::vector<std::string> FilterConfigLoader::getPrimaryKey(const std::string& fullTableName) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = primaryKeyMap.find(fullTableName);
+    return it != primaryKeyMap.end() ? it->second : std::vector<std::string>{};
+}
@@ -5,6 +5,7 @@
 #include <vector>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 #include "KafkaProcessor.h"
 #include "../common/FilterEntry.h"
 
@@ -24,12 +25,18 @@ public:
 
     std::string getPKIndex(const std::string& fullTableName) const;
     std::vector<FilterEntry> getAllFilters() const;
-    std::unordered_map<std::string, std::string> getPrimaryKeyColumns() const;
+    std::unordered_map<std::string, std::vector<std::string>> getPrimaryKeyColumns() const;
+    // Lookup PK (có thể nhiều cột) của một bảng (không copy cả map như getPrimaryKeyColumns)
+    std::vector<std::string> getPrimaryKey(const std::string& fullTableName) const;
+    // Tăng sau mỗi lần loadConfig → cache phụ thuộc filter (statement template) tự invalidate
+    uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
 
 private:
     mutable std::mutex mutex;
     std::vector<FilterEntry> filters;
     std::unordered_map<std::string, std::string> pkIndexMap;
+    std::unordered_map<std::string, std::vector<std::string>> primaryKeyMap;
+    std::atomic<uint64_t> generation{0};
     //std::vector<FilterEntry> getAllFilters() const;
 
 
@@ -92,6 +92,7 @@ void OracleSchemaCache::removeSchema(const std::string& fullTable) {
         auto it = schemaCache.find(fullTable);
         if (it != schemaCache.end()) {
             schemaCache.erase(it);
+            bumpSchemaVersion(fullTable);
             OpenSync::Logger::info("Removed schema for " + fullTable + " from cache.");
         } else {
             OpenSync::Logger::warn("Schema for " + fullTable + " not found in cache.");
@@ -111,6 +112,20 @@ std::map<std::string, OracleColumnInfo> OracleSchemaCache::getColumnInfo(const s
     return {};
 }
 
+std::map<std::string, OracleColumnInfo> OracleSchemaCache::getColumnInfoSnapshot(const std::string& fullTableName, uint64_t& version) const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto vit = schemaVersions.find(fullTableName);
+    version = (vit != schemaVersions.end()) ? vit->second : 0;
+    auto it = schemaCache.find(fullTableName);
+    if (it != schemaCache.end()) return it->second;
+    return {};
+}
+
+// Gọi khi đang giữ cacheMutex
+void OracleSchemaCache::bumpSchemaVersion(const std::string& fullTableName) {
+    schemaVersions[fullTableName] = schemaGeneration.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
 OracleSchemaCache& OracleSchemaCache::getInstance() {
     static OracleSchemaCache instance;
     return instance;
@@ -136,6 +151,7 @@ void OracleSchemaCache::mergeSchema(
     if (existingSchema.empty()) {
         // ⚠️ Đây là lần đầu tiên nạp schema → lưu thẳng
         existingSchema = newSchema;
+        bumpSchemaVersion(fullTableName);
 	//for (const auto& [colName, colInfo] : newSchema) {
             //std::stringstream ss;
             //ss << "   ↪️ " << colName << " : " << colInfo.getFullTypeString()
@@ -184,6 +200,7 @@ void OracleSchemaCache::mergeSchema(
     }
 
     if (driftCount > 0) {
+        bumpSchemaVersion(fullTableName);
 	OpenSync::Logger::warn("🚨 Schema drift detected in table: " + fullTableName + " (changes: " + std::to_string(driftCount) + ")");
         MetricsExporter::getInstance().incrementCounter("oracle_schema_drift_total", {{"table", fullTableName}}, driftCount);
     }
@@ -283,8 +300,15 @@ void OracleSchemaCache::startAutoRefreshThread(const ConfigLoader& config, int t
 
 
 void OracleSchemaCache::refreshAllSchemas(const ConfigLoader& config) {
-    std::lock_guard<std::mutex> lock(cacheMutex);
-    for (const auto& [fullTableName, _] : schemaCache) {
+    // mergeSchema() tự lock cacheMutex → chỉ giữ lock khi lấy danh sách bảng
+    std::vector<std::string> tables;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (const auto& [fullTableName, _] : schemaCache) {
+            tables.push_back(fullTableName);
+        }
+    }
+    for (const auto& fullTableName : tables) {
 	OpenSync::Logger::info("🔁 Refreshing schema for: " + fullTableName);
         loadTableSchema(fullTableName, config);
     }
@@ -376,11 +400,13 @@ void OracleSchemaCache::preloadAllSchemas(const ConfigLoader& config) {
 }
 
 void OracleSchemaCache::loadSchemaIfNeeded(const std::string& fullTableName, const ConfigLoader& config) {
-    std::lock_guard<std::mutex> lock(cacheMutex);
-    if (schemaCache.find(fullTableName) != schemaCache.end()) {
-	OpenSync::Logger::info("✅ Oracle schema already cached for table: " + fullTableName);
-	lastAccessTime[fullTableName] = std::chrono::steady_clock::now();
-        return;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (schemaCache.find(fullTableName) != schemaCache.end()) {
+	    OpenSync::Logger::info("✅ Oracle schema already cached for table: " + fullTableName);
+	    lastAccessTime[fullTableName] = std::chrono::steady_clock::now();
+            return;
+        }
     }
     loadTableSchema(fullTableName, config);
 }
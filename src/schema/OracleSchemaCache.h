@@ -8,6 +8,8 @@
 #include <atomic>
 #include <thread>
 #include <string>
+#include <unordered_map>
+#include <chrono>
 
 class DBConnector;
 
@@ -21,6 +23,10 @@ public:
 
     const std::map<std::string, OracleColumnInfo>& getColumnTypes(const std::string& fullTableName) const;
     std::map<std::string, OracleColumnInfo> getColumnInfo(const std::string& fullTableName) const;
+    // Copy schema + version dưới lock (dùng khi build conversion plan)
+    std::map<std::string, OracleColumnInfo> getColumnInfoSnapshot(const std::string& fullTableName, uint64_t& version) const;
+    // Tăng mỗi khi có bảng bất kỳ thay đổi schema → reader check không cần lock
+    uint64_t getSchemaGeneration() const { return schemaGeneration.load(std::memory_order_acquire); }
     void mergeSchema(const std::string& fullTableName,
                  const std::map<std::string, OracleColumnInfo>& newSchema);
     void startAutoRefreshThread(const ConfigLoader& config, int ttlSeconds);
@@ -44,7 +50,11 @@ private:
     OracleSchemaCache() = default;
     void loadTableSchema(const std::string& fullTableName, const ConfigLoader& config);
 
+    void bumpSchemaVersion(const std::string& fullTableName);
+
     std::map<std::string, std::map<std::string, OracleColumnInfo>> schemaCache;
+    std::unordered_map<std::string, uint64_t> schemaVersions;
+    std::atomic<uint64_t> schemaGeneration{0};
     mutable std::mutex cacheMutex;
     std::thread refreshThread;
     std::atomic<bool> stopRefresh{false};
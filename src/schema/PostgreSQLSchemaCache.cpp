@@ -55,6 +55,7 @@ void PostgreSQLSchemaCache::loadSchemaInternal(const std::string& fullTableName,
     PostgreSQLSchemaCacheEntry entry;
     entry.columns = std::move(columns);
     entry.lastAccess = std::chrono::steady_clock::now();
+    entry.version = schemaGeneration.fetch_add(1, std::memory_order_acq_rel) + 1;
     cache[lowerName] = std::move(entry);
     OpenSync::Logger::info("✅ PostgreSQLSchemaCache: Loaded and cached schema for: " + lowerName);
 }
@@ -97,6 +98,19 @@ PostgreSQLSchemaCache::getColumnInfo(const std::string& fullTableName) {
     }
 }
 
+std::unordered_map<std::string, PostgreSQLColumnInfo>
+PostgreSQLSchemaCache::getColumnInfoSnapshot(const std::string& fullTableName, uint64_t& version) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(fullTableName);
+    if (it == cache.end()) {
+        version = 0;
+        return {};
+    }
+    it->second.lastAccess = std::chrono::steady_clock::now();
+    version = it->second.version;
+    return it->second.columns;
+}
+
 std::vector<std::string>
 PostgreSQLSchemaCache::getPrimaryKeys(const std::string& fullTableName) {
     std::string lowerName = SQLUtils::toLower(fullTableName);
@@ -143,6 +157,7 @@ void PostgreSQLSchemaCache::shrinkInactiveSchemas(int maxAgeSeconds) {
         if (age > maxAgeSeconds) {
             OpenSync::Logger::info("🧹 Removing stale schema from cache: " + it->first);
             it = cache.erase(it);
+            schemaGeneration.fetch_add(1, std::memory_order_acq_rel);
         } else {
             ++it;
         }
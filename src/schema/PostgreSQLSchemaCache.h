@@ -3,6 +3,7 @@
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <vector>
 #include "../reader/ConfigLoader.h"
@@ -13,6 +14,7 @@ class PostgreSQLConnector;
 struct PostgreSQLSchemaCacheEntry {
     std::unordered_map<std::string, PostgreSQLColumnInfo> columns;
     std::chrono::steady_clock::time_point lastAccess;
+    uint64_t version = 0;
 };
 
 class PostgreSQLSchemaCache {
@@ -34,6 +36,10 @@ public:
     std::unordered_map<std::string, PostgreSQLColumnInfo> getColumnInfo(const std::string& fullTableName);
     std::vector<std::string> getPrimaryKeys(const std::string& fullTableName);
 
+    // Copy schema + version dưới lock (dùng khi build conversion plan), fullTableName đã lower-case
+    std::unordered_map<std::string, PostgreSQLColumnInfo> getColumnInfoSnapshot(const std::string& fullTableName, uint64_t& version);
+    uint64_t getSchemaGeneration() const { return schemaGeneration.load(std::memory_order_acquire); }
+
 
 private:
     PostgreSQLSchemaCache() = default;
@@ -41,5 +47,6 @@ private:
 
     std::unordered_map<std::string, PostgreSQLSchemaCacheEntry> cache;
     std::mutex cacheMutex;
+    std::atomic<uint64_t> schemaGeneration{0};
 };
 
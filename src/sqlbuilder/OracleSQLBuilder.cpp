@@ -2,8 +2,8 @@
 #include "../logger/Logger.h"
 #include "../utils/SQLUtils.h"
 #include "../common/TimeUtils.h"
-#include "../schema/OracleSchemaCache.h"
-#include <sstream>
+#include "../utils/ColumnConversionPlan.h"
+#include "SQLStatementTemplate.h"
 
 OracleSQLBuilder::OracleSQLBuilder(ConfigLoader& config, bool enableLog)
     : config(config), enableISODebugLog(enableLog), timestamp_unit(config.getTimestampUnit()) {
@@ -100,86 +100,206 @@ std::string OracleSQLBuilder::buildInsertSQL(const std::string& schema, const st
 }*/
 
 std::string OracleSQLBuilder::buildInsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data) {
-    std::ostringstream sql;
-    std::ostringstream columns;
-    std::ostringstream values;
+    const std::string fullTable = schema + "." + table;
+    const auto plan = ColumnConversionPlanCache::getPlan("oracle", fullTable);
 
-    std::string fullTable = schema + "." + table;
-    const auto& colTypes = OracleSchemaCache::getInstance().getColumnTypes(fullTable);
-
-    if (colTypes.empty()) {
+    if (plan->empty()) {
         OpenSync::Logger::warn("🔎 Oracle schema not found for table: " + fullTable + ", fallback to basic quoting");
     }
+    if (data.MemberBegin() == data.MemberEnd()) {
+        OpenSync::Logger::warn("⚠️ Empty row image for INSERT on " + fullTable);
+        return "";
+    }
 
-    bool first = true;
-    for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
-        const std::string colName = it->name.GetString();
-        const auto& jsonVal = it->value;
-
-        std::string sqlValue = SQLUtils::safeConvert("oracle", fullTable, colName, jsonVal, false, timestamp_unit);
+    auto& templates = SQLStatementTemplateCache::forThread();
+    const uint64_t signature = SQLStatementTemplateCache::signatureOf(data, "");
+    SQLStatementTemplate* tpl = templates.find(SQLStatementKind::INSERT, fullTable, signature, plan.get());
+
+    if (!tpl) {
+        // INSERT INTO t (c1, c2) VALUES ( <v1> , <v2> )
+        SQLStatementTemplate fresh;
+        fresh.plan = plan;
+
+        std::string prefix = "INSERT INTO " + fullTable + " (";
+        bool first = true;
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            if (!first) prefix += ", ";
+            prefix.append(it->name.GetString(), it->name.GetStringLength());
+            first = false;
+        }
+        prefix += ") VALUES (";
 
-        if (!first) {
-            columns << ", ";
-            values << ", ";
+        first = true;
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            fresh.addValue(first ? prefix : ", ", plan->findOrdinal(it->name));
+            first = false;
         }
-        columns << colName;
-        values << sqlValue;
-        first = false;
+        fresh.tail = ")";
+        tpl = &templates.store(SQLStatementKind::INSERT, fullTable, signature, std::move(fresh));
+    }
 
-        if (enableISODebugLog) {
-            std::string iso = SQLUtils::convertToISO8601(jsonVal);
+    std::string sql = tpl->render(data, timestamp_unit);
+
+    if (enableISODebugLog) {
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            std::string iso = SQLUtils::convertToISO8601(it->value);
             if (!iso.empty()) {
-                OpenSync::Logger::debug("🕓 ISO Timestamp | " + fullTable + "." + colName + " = " + iso);
+                OpenSync::Logger::debug("🕓 ISO Timestamp | " + fullTable + "." + it->name.GetString() + " = " + iso);
             }
         }
     }
 
-    sql << "INSERT INTO " << fullTable << " (" << columns.str() << ") VALUES (" << values.str() << ")";
-    OpenSync::Logger::debug("SQL: " + sql.str());
-    return sql.str();
+    if (OpenSync::Logger::isDebugEnabled()) {
+        OpenSync::Logger::debug("SQL: " + sql);
+    }
+    return sql;
 }
 
-std::string OracleSQLBuilder::buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey) {
-    std::ostringstream sql;
-    std::ostringstream setClause;
-
-    std::string fullTable = schema + "." + table;
-    std::string pkValue;
-    bool first = true;
+std::string OracleSQLBuilder::buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey) {
+    const std::string fullTable = schema + "." + table;
+    const auto plan = ColumnConversionPlanCache::getPlan("oracle", fullTable);
+
+    auto& templates = SQLStatementTemplateCache::forThread();
+    const uint64_t signature = SQLStatementTemplateCache::signatureOf(data, FilterEntry::joinKeys(primaryKey, "\x1f"));
+    SQLStatementTemplate* tpl = templates.find(SQLStatementKind::UPDATE, fullTable, signature, plan.get());
+
+    if (!tpl) {
+        // UPDATE t SET "C" = <v>, "D" = <v> WHERE "A" = <pk1> AND "B" = <pk2>
+        SQLStatementTemplate fresh;
+        fresh.plan = plan;
+
+        bool firstSet = true;
+        size_t keysFound = 0;
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            const std::string colName(it->name.GetString(), it->name.GetStringLength());
+            if (isKeyColumn(primaryKey, colName.data(), colName.size())) {
+                fresh.addValue((keysFound == 0 ? " WHERE \"" : " AND \"") + colName + "\" = ", plan->findOrdinal(it->name), true);
+                ++keysFound;
+                continue;
+            }
+            std::string lead = firstSet ? "UPDATE " + fullTable + " SET \"" : ", \"";
+            fresh.addValue(lead + colName + "\" = ", plan->findOrdinal(it->name));
+            firstSet = false;
+        }
 
-    for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
-        const std::string colName = it->name.GetString();
-        const auto& jsonVal = it->value;
+        if (primaryKey.empty() || keysFound != primaryKey.size()) {
+            OpenSync::Logger::warn("⚠️ Missing primary key [" + FilterEntry::joinKeys(primaryKey) + "] in data for UPDATE on " + fullTable);
+            return "";
+        }
+        if (firstSet) {
+            OpenSync::Logger::debug("UPDATE on " + fullTable + " has no non-PK column, skipped");
+            return "";
+        }
+        tpl = &templates.store(SQLStatementKind::UPDATE, fullTable, signature, std::move(fresh));
+    }
 
-        std::string sqlValue = SQLUtils::safeConvert("oracle", fullTable, colName, jsonVal, false, timestamp_unit);
+    return tpl->render(data, timestamp_unit);
+}
 
-        if (colName == primaryKey) {
-            pkValue = sqlValue;
-            continue;
-        }
+std::string OracleSQLBuilder::buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey) {
+    const std::string fullTable = schema + "." + table;
 
-        if (!first) setClause << ", ";
-        setClause << "\"" << colName << "\" = " << sqlValue;
-        first = false;
+    if (primaryKey.empty()) {
+        OpenSync::Logger::warn("⚠️ No primary key configured for DELETE on " + fullTable);
+        return "";
     }
 
-    sql << "UPDATE " << fullTable << " SET " << setClause.str()
-        << " WHERE \"" << primaryKey << "\" = " << pkValue;
+    const auto plan = ColumnConversionPlanCache::getPlan("oracle", fullTable);
+    std::string sql;
+    sql.reserve(fullTable.size() + 64 * primaryKey.size());
+    sql.append("DELETE FROM ").append(fullTable);
+
+    for (size_t i = 0; i < primaryKey.size(); ++i) {
+        const std::string& key = primaryKey[i];
+        auto pk = data.FindMember(key.c_str());
+        if (pk == data.MemberEnd()) {
+            OpenSync::Logger::warn("⚠️ Missing primary key [" + key + "] in data for DELETE");
+            return "";
+        }
+        sql.append(i == 0 ? " WHERE \"" : " AND \"").append(key).append("\" = ");
+        plan->appendValueByName(sql, key.data(), key.size(), pk->value, timestamp_unit);
+    }
+    return sql;
+}
 
-    return sql.str();
+std::string OracleSQLBuilder::buildUpsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const FilterEntry& filter) {
+    return buildMergeSQL(schema, table, data, filter.primaryKey, filter.pkIndex);
 }
 
-std::string OracleSQLBuilder::buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey) {
-    std::string fullTable = schema + "." + table;
+std::string OracleSQLBuilder::buildMergeSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data,
+                                            const std::vector<std::string>& primaryKey, const std::string& pkIndex) {
+    const std::string fullTable = schema + "." + table;
 
-    if (!data.HasMember(primaryKey.c_str())) {
-        OpenSync::Logger::warn("⚠️ Missing primary key [" + primaryKey + "] in data for DELETE");
-        return "";
+    bool hasKey = !primaryKey.empty();
+    for (const auto& key : primaryKey) {
+        if (!data.HasMember(key.c_str())) hasKey = false;
+    }
+    if (!hasKey) {
+        OpenSync::Logger::warn("⚠️ Missing primary key [" + FilterEntry::joinKeys(primaryKey) + "] for MERGE on " + fullTable + ", fallback to INSERT");
+        return buildInsertSQL(schema, table, data);
     }
 
-    const auto& pkVal = data[primaryKey.c_str()];
-    std::string pkValue = SQLUtils::safeConvert("oracle", fullTable, primaryKey, pkVal, false, timestamp_unit);
+    const auto plan = ColumnConversionPlanCache::getPlan("oracle", fullTable);
+    auto& templates = SQLStatementTemplateCache::forThread();
+    const uint64_t signature = SQLStatementTemplateCache::signatureOf(data, FilterEntry::joinKeys(primaryKey, "\x1f") + '\x1e' + pkIndex);
+    SQLStatementTemplate* tpl = templates.find(SQLStatementKind::MERGE, fullTable, signature, plan.get());
 
-    return "DELETE FROM " + fullTable + " WHERE \"" + primaryKey + "\" = " + pkValue;
-}
+    if (!tpl) {
+        // MERGE INTO t USING (SELECT <v> "A", <v> "B" FROM dual) s ON (t."A" = s."A")
+        //   WHEN MATCHED THEN UPDATE SET t."B" = s."B" WHEN NOT MATCHED THEN INSERT ("A", "B") VALUES (s."A", s."B")
+        SQLStatementTemplate fresh;
+        fresh.plan = plan;
 
+        std::string head = "MERGE ";
+        if (!pkIndex.empty()) {
+            head += "/*+ INDEX(t " + pkIndex + ") */ ";
+        }
+        head += "INTO " + fullTable + " t USING (SELECT ";
+
+        std::string setClause;   // t."COL" = s."COL"
+        std::string insertCols;  // "COL", ...
+        std::string insertVals;  // s."COL", ...
+        std::string prevAlias;
+
+        bool first = true;
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            const std::string colName(it->name.GetString(), it->name.GetStringLength());
+
+            fresh.addValue(first ? head : prevAlias + ", ", plan->findOrdinal(it->name));
+            prevAlias = " \"" + colName + "\"";
+
+            if (!first) {
+                insertCols += ", ";
+                insertVals += ", ";
+            }
+            insertCols += "\"" + colName + "\"";
+            insertVals += "s.\"" + colName + "\"";
+            first = false;
+
+            if (isKeyColumn(primaryKey, colName.data(), colName.size())) continue;
+
+            if (!setClause.empty()) setClause += ", ";
+            setClause += "t.\"" + colName + "\" = s.\"" + colName + "\"";
+        }
+
+        std::string onClause;
+        for (const auto& key : primaryKey) {
+            if (!onClause.empty()) onClause += " AND ";
+            onClause += "t.\"" + key + "\" = s.\"" + key + "\"";
+        }
+
+        fresh.tail = prevAlias + " FROM dual) s ON (" + onClause + ")";
+        // Bảng chỉ có cột PK thì không có gì để UPDATE
+        if (!setClause.empty()) {
+            fresh.tail += " WHEN MATCHED THEN UPDATE SET " + setClause;
+        }
+        fresh.tail += " WHEN NOT MATCHED THEN INSERT (" + insertCols + ") VALUES (" + insertVals + ")";
+        tpl = &templates.store(SQLStatementKind::MERGE, fullTable, signature, std::move(fresh));
+    }
+
+    std::string sql = tpl->render(data, timestamp_unit);
+    if (OpenSync::Logger::isDebugEnabled()) {
+        OpenSync::Logger::debug("SQL: " + sql);
+    }
+    return sql;
+}
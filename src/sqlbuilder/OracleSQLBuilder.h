@@ -6,8 +6,13 @@ class OracleSQLBuilder : public SQLBuilderBase {
 public:
     OracleSQLBuilder(ConfigLoader& config, bool enableISODebugLog);
     std::string buildInsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data) override;
-    std::string buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey) override;
-    std::string buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey) override;
+    std::string buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey) override;
+    std::string buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey) override;
+    std::string buildUpsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const FilterEntry& filter) override;
+
+    // MERGE INTO ... USING (SELECT ... FROM dual) s ON (t.pk = s.pk) WHEN MATCHED ... WHEN NOT MATCHED ...
+    std::string buildMergeSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data,
+                              const std::vector<std::string>& primaryKey, const std::string& pkIndex);
 
 private:
     ConfigLoader& config;
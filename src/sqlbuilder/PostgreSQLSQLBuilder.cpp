@@ -1,62 +1,61 @@
 #include "PostgreSQLSQLBuilder.h"
+#include "SQLStatementTemplate.h"
 #include "../utils/SQLUtils.h"
-#include "../schema/PostgreSQLSchemaCache.h"
+#include "../utils/ColumnConversionPlan.h"
 #include "../reader/FilterConfigLoader.h"
 #include "../logger/Logger.h"
-#include <sstream>
 #include <algorithm>
 
 PostgreSQLSQLBuilder::PostgreSQLSQLBuilder(const ConfigLoader& config, bool enableISODebugLog)
     : config(config), enableISODebugLog(enableISODebugLog) {}
 
 std::string PostgreSQLSQLBuilder::buildInsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data) {
-    auto start = std::chrono::steady_clock::now();
-
-    std::ostringstream sql, columns, values;
-    std::string lowerSchema = SQLUtils::toLower(schema);
-    std::string lowerTable = SQLUtils::toLower(table);
-    std::string fullTable = lowerSchema + "." + lowerTable;
-    
-    auto t_schemaStart = std::chrono::steady_clock::now();
-    const auto& columnInfoMap = PostgreSQLSchemaCache::getInstance().getColumnInfo(fullTable);
-    (void) columnInfoMap;
-    auto t_schemaEnd = std::chrono::steady_clock::now();
-
-    auto t_convertStart = std::chrono::steady_clock::now();
-    const auto pkMap = FilterConfigLoader::getInstance().getPrimaryKeyColumns();
-    std::string pk = pkMap.count(fullTable) ? SQLUtils::toLower(pkMap.at(fullTable)) : "";
-
-    bool first = true;
-    for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
-        std::string col = SQLUtils::toLower(it->name.GetString());
-        const auto& val = it->value;
-
-        if (!first) {
-            columns << ", ";
-            values << ", ";
-        }
-        first = false;
-
-        columns << col;
-        values << SQLUtils::safeConvert("postgresql", fullTable, col, val, false);
-    }
+    const std::string fullTable = SQLUtils::toLower(schema) + "." + SQLUtils::toLower(table);
+    const auto plan = ColumnConversionPlanCache::getPlan("postgresql", fullTable);
 
-    sql << "insert into " << fullTable << " (" << columns.str() << ") values (" << values.str() << ")";
-    if (!pk.empty()) {
-        sql << " ON CONFLICT (" << pk << ") DO NOTHING";
+    if (data.MemberBegin() == data.MemberEnd()) {
+        OpenSync::Logger::warn("PostgreSQLSQLBuilder: empty row image for insert on table " + fullTable);
+        return "";
     }
 
-    auto t_convertEnd = std::chrono::steady_clock::now();
+    auto& templates = SQLStatementTemplateCache::forThread();
+    const uint64_t signature = SQLStatementTemplateCache::signatureOf(data, "");
+    SQLStatementTemplate* tpl = templates.find(SQLStatementKind::INSERT, fullTable, signature, plan.get());
+
+    if (!tpl) {
+        // insert into t (c1, c2) values ( <v1> , <v2> ) [ON CONFLICT (pk) DO NOTHING]
+        SQLStatementTemplate fresh;
+        fresh.plan = plan;
+
+        std::string prefix = "insert into " + fullTable + " (";
+        bool first = true;
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            if (!first) prefix += ", ";
+            prefix += SQLUtils::toLower(it->name.GetString());
+            first = false;
+        }
+        prefix += ") values (";
 
-    auto end = std::chrono::steady_clock::now();
+        first = true;
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            fresh.addValue(first ? prefix : ", ", plan->findOrdinal(it->name));
+            first = false;
+        }
 
-    OpenSync::Logger::debug("✅ SQLBuilder buildInsertSQL timing for " + fullTable +
-        " | schema: " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(t_schemaEnd - t_schemaStart).count()) + " ms" +
-        " | convert: " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(t_convertEnd - t_convertStart).count()) + " ms" +
-        " | total: " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()) + " ms");
+        fresh.tail = ")";
+        // PK chỉ đọc lại khi build template (filter reload → cache tự invalidate)
+        const std::string pk = SQLUtils::toLower(FilterEntry::joinKeys(FilterConfigLoader::getInstance().getPrimaryKey(fullTable)));
+        if (!pk.empty()) {
+            fresh.tail += " ON CONFLICT (" + pk + ") DO NOTHING";
+        }
+        tpl = &templates.store(SQLStatementKind::INSERT, fullTable, signature, std::move(fresh));
+    }
 
-    OpenSync::Logger::debug("sql:" + sql.str());
-    return sql.str();
+    std::string sql = tpl->render(data, 1);
+    if (OpenSync::Logger::isDebugEnabled()) {
+        OpenSync::Logger::debug("sql:" + sql);
+    }
+    return sql;
 }
 
 std::string PostgreSQLSQLBuilder::buildUpsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data) {
@@ -64,55 +63,84 @@ std::string PostgreSQLSQLBuilder::buildUpsertSQL(const std::string& schema, cons
     return SQLUtils::buildPostgreSQLUpsertSQL(fullTable, data);
 }
 
+std::string PostgreSQLSQLBuilder::buildUpsertSQL(const std::string& schema, const std::string& table,
+                                                 const rapidjson::Value& data, const FilterEntry& filter) {
+    // Conflict target theo PK khai báo trong filter (composite được); không khai báo thì lấy PK từ PostgreSQLSchemaCache
+    if (!filter.hasPrimaryKey()) {
+        return buildUpsertSQL(schema, table, data);
+    }
+    const std::string fullTable = SQLUtils::toLower(schema) + "." + SQLUtils::toLower(table);
+    std::vector<std::string> conflictKeys;
+    conflictKeys.reserve(filter.primaryKey.size());
+    for (const auto& key : filter.primaryKey) conflictKeys.push_back(SQLUtils::toLower(key));
+    return SQLUtils::buildPostgreSQLUpsertSQL(fullTable, data, conflictKeys);
+}
+
 std::string PostgreSQLSQLBuilder::buildUpdateSQL(const std::string& schema, const std::string& table,
-                                                 const rapidjson::Value& data, const std::string& primaryKey) {
-    std::ostringstream sql, setClause;
-    std::string lowerSchema = SQLUtils::toLower(schema);
-    std::string lowerTable = SQLUtils::toLower(table);
-    std::string lowerPK = SQLUtils::toLower(primaryKey);
-    std::string fullTable = lowerSchema + "." + lowerTable;
-
-    const auto& columnInfoMap = PostgreSQLSchemaCache::getInstance().getColumnInfo(fullTable);
-    (void) columnInfoMap;
-    std::string pkValue;
-    bool first = true;
-
-    for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
-        std::string col = SQLUtils::toLower(it->name.GetString());
-        const auto& val = it->value;
-
-        if (col == lowerPK) {
-            pkValue = SQLUtils::safeConvert("postgresql", fullTable, col, val, false);
-            continue;
+                                                 const rapidjson::Value& data, const std::vector<std::string>& primaryKey) {
+    const std::string fullTable = SQLUtils::toLower(schema) + "." + SQLUtils::toLower(table);
+    const auto plan = ColumnConversionPlanCache::getPlan("postgresql", fullTable);
+
+    auto& templates = SQLStatementTemplateCache::forThread();
+    const uint64_t signature = SQLStatementTemplateCache::signatureOf(data, SQLUtils::toLower(FilterEntry::joinKeys(primaryKey, "\x1f")));
+    SQLStatementTemplate* tpl = templates.find(SQLStatementKind::UPDATE, fullTable, signature, plan.get());
+
+    if (!tpl) {
+        // update t set c = <v>, d = <v> where a = <pk1> and b = <pk2>
+        SQLStatementTemplate fresh;
+        fresh.plan = plan;
+
+        bool firstSet = true;
+        size_t keysFound = 0;
+        for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+            const std::string col = SQLUtils::toLower(it->name.GetString());
+            if (isKeyColumn(primaryKey, col.data(), col.size(), true)) {
+                fresh.addValue((keysFound == 0 ? " where " : " and ") + col + " = ", plan->findOrdinal(it->name), true);
+                ++keysFound;
+                continue;
+            }
+            std::string lead = firstSet ? "update " + fullTable + " set " : ", ";
+            fresh.addValue(lead + col + " = ", plan->findOrdinal(it->name));
+            firstSet = false;
         }
 
-        if (!first) setClause << ", ";
-        first = false;
-
-        setClause << col << " = " << SQLUtils::safeConvert("postgresql", fullTable, col, val, false);
+        if (primaryKey.empty() || keysFound != primaryKey.size()) {
+            OpenSync::Logger::warn("PostgreSQLSQLBuilder: missing PK '" + FilterEntry::joinKeys(primaryKey) + "' in update row for table " + fullTable);
+            return "";
+        }
+        if (firstSet) {
+            OpenSync::Logger::debug("PostgreSQLSQLBuilder: update on " + fullTable + " has no non-PK column, skipped");
+            return "";
+        }
+        tpl = &templates.store(SQLStatementKind::UPDATE, fullTable, signature, std::move(fresh));
     }
 
-    sql << "update " << fullTable << " set " << setClause.str()
-        << " where " << lowerPK << " = " << pkValue;
-    return sql.str();
+    return tpl->render(data, 1);
 }
 
 std::string PostgreSQLSQLBuilder::buildDeleteSQL(const std::string& schema, const std::string& table,
-                                                 const rapidjson::Value& before, const std::string& primaryKey) {
-    std::ostringstream sql;
-    std::string lowerSchema = SQLUtils::toLower(schema);
-    std::string lowerTable = SQLUtils::toLower(table);
-    std::string lowerPK = SQLUtils::toLower(primaryKey);
-    std::string fullTable = lowerSchema + "." + lowerTable;
-
-    if (!before.HasMember(primaryKey.c_str())) {
-        OpenSync::Logger::warn("PostgreSQLSQLBuilder: missing PK '" + primaryKey + "' in delete row for table " + fullTable);
+                                                 const rapidjson::Value& before, const std::vector<std::string>& primaryKey) {
+    const std::string fullTable = SQLUtils::toLower(schema) + "." + SQLUtils::toLower(table);
+
+    if (primaryKey.empty()) {
+        OpenSync::Logger::warn("PostgreSQLSQLBuilder: no PK configured for delete on table " + fullTable);
         return "";
     }
 
-    const auto& pkVal = before[primaryKey.c_str()];
-    std::string pkValue = SQLUtils::safeConvert("postgresql", fullTable, lowerPK, pkVal, false);
+    const auto plan = ColumnConversionPlanCache::getPlan("postgresql", fullTable);
+    std::string sql;
+    sql.reserve(fullTable.size() + 64 * primaryKey.size());
+    sql.append("delete from ").append(fullTable);
 
-    sql << "delete from " << fullTable << " where " << lowerPK << " = " << pkValue;
-    return sql.str();
+    for (size_t i = 0; i < primaryKey.size(); ++i) {
+        auto pk = before.FindMember(primaryKey[i].c_str());
+        if (pk == before.MemberEnd()) {
+            OpenSync::Logger::warn("PostgreSQLSQLBuilder: missing PK '" + primaryKey[i] + "' in delete row for table " + fullTable);
+            return "";
+        }
+        const std::string lowerPK = SQLUtils::toLower(primaryKey[i]);
+        sql.append(i == 0 ? " where " : " and ").append(lowerPK).append(" = ");
+        plan->appendValueByName(sql, lowerPK.data(), lowerPK.size(), pk->value, 1);
+    }
+    return sql;
 }
@@ -1,13 +1,35 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <cstring>
+#include <cctype>
 #include <rapidjson/document.h>
+#include "../common/FilterEntry.h"
 
 class SQLBuilderBase {
 public:
     virtual ~SQLBuilderBase() = default;
 
     virtual std::string buildInsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data) = 0;
-    virtual std::string buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey) = 0;
-    virtual std::string buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::string& primaryKey) = 0;
-};
+    // primaryKey: một hoặc nhiều cột (composite PK) → WHERE k1 = .. AND k2 = ..
+    virtual std::string buildUpdateSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey) = 0;
+    virtual std::string buildDeleteSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const std::vector<std::string>& primaryKey) = 0;
+
+    // Upsert cho bảng có apply_mode = "upsert" (insert-or-update theo PK, idempotent khi replay)
+    virtual std::string buildUpsertSQL(const std::string& schema, const std::string& table, const rapidjson::Value& data, const FilterEntry& filter) = 0;
 
+protected:
+    static bool isKeyColumn(const std::vector<std::string>& keys, const char* name, size_t len, bool ignoreCase = false) {
+        for (const auto& key : keys) {
+            if (key.size() != len) continue;
+            if (ignoreCase) {
+                size_t i = 0;
+                while (i < len && std::tolower(static_cast<unsigned char>(key[i])) == std::tolower(static_cast<unsigned char>(name[i]))) ++i;
+                if (i == len) return true;
+            } else if (std::memcmp(key.data(), name, len) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,143 @@
+#include "SQLStatementTemplate.h"
+#include "../reader/FilterConfigLoader.h"
+#include "../common/TableBatchPool.h"
+
+using rapidjson::Value;
+
+namespace {
+
+// Buffer dùng lại giữa các row của cùng worker, chỉ grow theo row lớn nhất
+struct SQLTextBuffers {
+    std::string body;
+    std::string keys;
+};
+
+thread_local SQLTextBuffers textBuffers;
+
+inline void appendColumnValue(std::string& out, const ColumnConversionPlan& plan, int ordinal,
+                              const Value& name, const Value& val, int timestamp_unit) {
+    if (ordinal >= 0) {
+        plan.appendValue(out, ordinal, val, timestamp_unit);
+    } else {
+        plan.appendValueByName(out, name.GetString(), name.GetStringLength(), val, timestamp_unit);
+    }
+}
+
+} // namespace
+
+void SQLStatementTemplate::addValue(std::string leadText, int ordinal, bool key) {
+    if (key) {
+        keyLead.push_back(std::move(leadText));
+        lead.emplace_back();
+    } else {
+        lead.push_back(std::move(leadText));
+    }
+    ordinals.push_back(ordinal);
+    isKey.push_back(key ? 1 : 0);
+}
+
+std::string SQLStatementTemplate::render(const Value& data, int timestamp_unit) {
+    std::string& body = textBuffers.body;
+    std::string& keys = textBuffers.keys;
+    body.clear();
+    keys.clear();
+
+    const size_t expected = avgBytes + avgBytes / 4 + 64;
+    if (body.capacity() < expected) body.reserve(expected);
+
+    size_t i = 0;
+    size_t k = 0;
+    for (auto it = data.MemberBegin(); it != data.MemberEnd() && i < ordinals.size(); ++it, ++i) {
+        if (isKey[i]) {
+            keys += keyLead[k++];
+            appendColumnValue(keys, *plan, ordinals[i], it->name, it->value, timestamp_unit);
+        } else {
+            body += lead[i];
+            appendColumnValue(body, *plan, ordinals[i], it->name, it->value, timestamp_unit);
+        }
+    }
+
+    // Buffer tái sử dụng từ statement đã ghi xong (DB writer trả về pool)
+    std::string sql = TableBatchPool::getInstance().acquireString();
+    sql.reserve(body.size() + keys.size() + tail.size());
+    sql.append(body).append(keys).append(tail);
+
+    avgBytes = avgBytes ? (avgBytes * 7 + sql.size()) / 8 : sql.size();
+    return sql;
+}
+
+SQLStatementTemplateCache& SQLStatementTemplateCache::forThread() {
+    thread_local SQLStatementTemplateCache cache;
+    return cache;
+}
+
+uint64_t SQLStatementTemplateCache::signatureOf(const Value& data, const std::string& salt) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix = [&h](const char* p, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            h ^= static_cast<unsigned char>(p[i]);
+            h *= 0x100000001b3ULL;
+        }
+        h ^= 0x1f;  // separator giữa các tên
+        h *= 0x100000001b3ULL;
+    };
+
+    mix(salt.data(), salt.size());
+    for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it) {
+        mix(it->name.GetString(), it->name.GetStringLength());
+    }
+    return h;
+}
+
+void SQLStatementTemplateCache::checkFilterGeneration() {
+    // Reload filter config (PK / ON CONFLICT target có thể đổi) → bỏ toàn bộ template
+    uint64_t generation = FilterConfigLoader::getInstance().getGeneration();
+    if (generation != filterGeneration) {
+        for (auto& byTable : templates) byTable.clear();
+        filterGeneration = generation;
+    }
+}
+
+SQLStatementTemplate* SQLStatementTemplateCache::find(SQLStatementKind kind, const std::string& table,
+                                                      uint64_t signature, const ColumnConversionPlan* plan) {
+    checkFilterGeneration();
+
+    auto& byTable = templates[static_cast<size_t>(kind)];
+    auto tableIt = byTable.find(table);
+    if (tableIt == byTable.end()) return nullptr;
+
+    TableTemplates& perTable = tableIt->second;
+    auto it = perTable.bySignature.find(signature);
+    if (it == perTable.bySignature.end()) return nullptr;
+
+    if (it->second.tpl.plan.get() != plan) {
+        // Schema version mới → ordinal cũ không còn đúng
+        perTable.lru.erase(it->second.lruPos);
+        perTable.bySignature.erase(it);
+        return nullptr;
+    }
+    perTable.lru.splice(perTable.lru.begin(), perTable.lru, it->second.lruPos);
+    return &it->second.tpl;
+}
+
+SQLStatementTemplate& SQLStatementTemplateCache::store(SQLStatementKind kind, const std::string& table,
+                                                       uint64_t signature, SQLStatementTemplate&& tpl) {
+    TableTemplates& perTable = templates[static_cast<size_t>(kind)][table];
+    auto it = perTable.bySignature.find(signature);
+    if (it != perTable.bySignature.end()) {
+        perTable.lru.splice(perTable.lru.begin(), perTable.lru, it->second.lruPos);
+        it->second.tpl = std::move(tpl);
+        return it->second.tpl;
+    }
+
+    if (perTable.bySignature.size() >= MAX_TEMPLATES_PER_TABLE) {
+        // Chỉ bỏ một entry; con trỏ tới template khác (unordered_map node) vẫn hợp lệ
+        perTable.bySignature.erase(perTable.lru.back());
+        perTable.lru.pop_back();
+    }
+    perTable.lru.push_front(signature);
+    Entry& stored = perTable.bySignature[signature];
+    stored.tpl = std::move(tpl);
+    stored.lruPos = perTable.lru.begin();
+    return stored.tpl;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <rapidjson/document.h>
+#include "../utils/ColumnConversionPlan.h"
+
+enum class SQLStatementKind : uint8_t {
+    INSERT = 0,
+    UPDATE = 1,
+    MERGE = 2
+};
+
+// Phần text cố định của một statement theo (table, column-set signature).
+// Mỗi row chỉ còn append value: lead[i] + value(i) ... + keys + tail
+struct SQLStatementTemplate {
+    std::shared_ptr<const ColumnConversionPlan> plan;
+    std::vector<std::string> lead;      // text trước value thứ i (theo thứ tự member trong JSON)
+    std::vector<int> ordinals;          // ordinal trong plan, -1 = cột không có trong schema
+    std::vector<uint8_t> isKey;         // value thuộc PK → đi vào WHERE thay vì body
+    std::vector<std::string> keyLead;   // text trước PK value thứ k (" WHERE \"A\" = ", " AND \"B\" = ")
+    std::string tail;
+    size_t avgBytes = 0;                // running average độ dài statement
+
+    void addValue(std::string leadText, int ordinal, bool key = false);
+
+    // Row phải có cùng signature với row đã dùng để build template
+    std::string render(const rapidjson::Value& data, int timestamp_unit);
+};
+
+// Cache template theo worker thread → không lock
+class SQLStatementTemplateCache {
+public:
+    static SQLStatementTemplateCache& forThread();
+
+    // Hash thứ tự + tên các member; salt phân biệt PK / index hint
+    static uint64_t signatureOf(const rapidjson::Value& data, const std::string& salt);
+
+    // nullptr nếu chưa có hoặc plan của bảng đã được build lại
+    SQLStatementTemplate* find(SQLStatementKind kind, const std::string& table, uint64_t signature,
+                               const ColumnConversionPlan* plan);
+    SQLStatementTemplate& store(SQLStatementKind kind, const std::string& table, uint64_t signature,
+                                SQLStatementTemplate&& tpl);
+
+private:
+    // Giới hạn theo (kind, bảng): INSERT / UPDATE / MERGE mỗi loại một map riêng, nên nhiều signature
+    // UPDATE (tập cột thay đổi) không đẩy template INSERT ra
+    static constexpr size_t MAX_TEMPLATES_PER_TABLE = 64;
+    static constexpr size_t KIND_COUNT = 3;
+
+    struct Entry {
+        SQLStatementTemplate tpl;
+        std::list<uint64_t>::iterator lruPos;
+    };
+
+    // Đầy thì bỏ signature ít dùng gần đây nhất (lru.back()), template đang nóng được giữ
+    struct TableTemplates {
+        std::unordered_map<uint64_t, Entry> bySignature;
+        std::list<uint64_t> lru;        // đầu = vừa dùng
+    };
+
+    void checkFilterGeneration();
+
+    std::unordered_map<std::string, TableTemplates> templates[KIND_COUNT];
+    uint64_t filterGeneration = 0;
+};
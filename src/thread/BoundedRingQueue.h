@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <memory>
+#include <vector>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Bounded MPMC ring buffer (Vyukov): mỗi cell có sequence riêng, push/pop chỉ là một CAS trên
+// enqueuePos / dequeuePos (mỗi cái một cache line). Không có mutex; thread chỉ ngủ (futex) khi
+// queue rỗng / đầy, và producer / consumer chỉ gọi syscall wake khi thực sự có thread đang ngủ.
+// Capacity theo item được làm tròn lên luỹ thừa 2; có thể giới hạn thêm theo byte (setMaxBytes).
+// API giữ tương thích ThreadSafeQueue (push / try_pop / try_pop_nowait / size).
+template<typename T>
+class BoundedRingQueue {
+public:
+    explicit BoundedRingQueue(size_t maxCapacity = 1024)
+        : capacity(roundUpPow2(maxCapacity < 2 ? 2 : maxCapacity)),
+          mask(capacity - 1),
+          cells(new Cell[capacity]) {
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedRingQueue(const BoundedRingQueue&) = delete;
+    BoundedRingQueue& operator=(const BoundedRingQueue&) = delete;
+
+    // Giới hạn mềm theo tổng byte (push kèm bytes); 0 = chỉ giới hạn theo số item.
+    // Queue rỗng luôn nhận item, kể cả item lớn hơn maxBytes.
+    void setMaxBytes(size_t bytes) { maxBytes.store(bytes, std::memory_order_relaxed); }
+
+    void push(const T& value, size_t bytes = 0) {
+        T copy(value);
+        push(std::move(copy), bytes);
+    }
+
+    void push(T&& value, size_t bytes = 0) {
+        while (!tryPushOne(value, bytes)) {
+            waitNotFull(bytes);
+        }
+        notifyNotEmpty();
+    }
+
+    // Không chờ: false nếu queue đầy (value giữ nguyên)
+    bool try_push(T&& value, size_t bytes = 0) {
+        if (!tryPushOne(value, bytes)) return false;
+        notifyNotEmpty();
+        return true;
+    }
+
+    // Push cả dãy, chỉ wake consumer một lần (hoặc trước khi phải chờ queue bớt đầy)
+    void push_bulk(std::vector<T>& values, const std::vector<size_t>* bytes = nullptr) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            const size_t itemBytes = bytes && i < bytes->size() ? (*bytes)[i] : 0;
+            while (!tryPushOne(values[i], itemBytes)) {
+                notifyNotEmpty();
+                waitNotFull(itemBytes);
+            }
+        }
+        values.clear();
+        notifyNotEmpty();
+    }
+
+    bool try_pop(T& result, std::chrono::milliseconds timeout = std::chrono::milliseconds(100)) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            if (tryPopOne(result)) {
+                notifyNotFull();
+                return true;
+            }
+            // Tính theo ns: làm tròn xuống ms khiến phần lẻ < 1ms của timeout bị quay vòng thay vì ngủ
+            auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) return false;
+            waitNotEmpty(remaining);
+        }
+    }
+
+    bool try_pop_nowait(T& result) {
+        if (!tryPopOne(result)) return false;
+        notifyNotFull();
+        return true;
+    }
+
+    // Chờ tối đa timeout tới khi có ít nhất một item, rồi lấy thêm (không chờ) tới maxItems.
+    // Trả về số item đã append vào out.
+    size_t pop_bulk(std::vector<T>& out, size_t maxItems, std::chrono::milliseconds timeout) {
+        if (maxItems == 0) return 0;
+        T item;
+        if (!try_pop(item, timeout)) return 0;
+        out.push_back(std::move(item));
+        size_t count = 1;
+        while (count < maxItems && tryPopOne(item)) {
+            out.push_back(std::move(item));
+            ++count;
+        }
+        if (count > 1) notifyNotFull();
+        return count;
+    }
+
+    size_t size() const {
+        const size_t tail = enqueuePos.load(std::memory_order_acquire);
+        const size_t head = dequeuePos.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t bytes() const { return queuedBytes.load(std::memory_order_relaxed); }
+    size_t maxItems() const { return capacity; }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        size_t bytes = 0;
+        T data;
+    };
+
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    bool overByteLimit(size_t incoming) const {
+        const size_t limit = maxBytes.load(std::memory_order_relaxed);
+        if (limit == 0) return false;
+        const size_t current = queuedBytes.load(std::memory_order_relaxed);
+        return current > 0 && current + incoming > limit;
+    }
+
+    // value chỉ bị move khi trả về true
+    bool tryPushOne(T& value, size_t bytes) {
+        if (overByteLimit(bytes)) return false;
+
+        Cell* cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;  // đầy
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->bytes = bytes;
+        if (bytes) queuedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPopOne(T& result) {
+        Cell* cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;  // rỗng
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        result = std::move(cell->data);
+        cell->data = T();  // trả bộ nhớ (string / vector) ngay, không giữ tới lần ghi đè sau
+        if (cell->bytes) queuedBytes.fetch_sub(cell->bytes, std::memory_order_relaxed);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // ----- futex: ngủ trên state word = (epoch << 1) | WAITERS -----
+    // Waiter đặt bit WAITERS trước khi ngủ; notify chỉ gọi syscall khi bit đang bật và xoá nó (tăng epoch)
+    // cùng lúc → các push / pop tiếp theo không wake lại waiter đã được wake nhưng chưa kịp chạy.
+    static constexpr uint32_t WAITERS = 1;
+
+    static void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) {
+        timespec ts;
+        timespec* tsp = nullptr;
+        if (timeout.count() >= 0) {
+            ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+            ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+            tsp = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, tsp, nullptr, 0);
+    }
+
+    static void futexWakeAll(std::atomic<uint32_t>& word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    static void notify(std::atomic<uint32_t>& state) {
+        // Pair với việc đặt bit + re-check bên waiter: hoặc waiter thấy item / chỗ trống, hoặc ta thấy bit
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t current = state.load(std::memory_order_relaxed);
+        do {
+            if ((current & WAITERS) == 0) return;   // không ai chờ, hoặc notify khác đã wake
+        } while (!state.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed));   // xoá bit, epoch + 1
+        futexWakeAll(state);
+    }
+
+    // Trả về không cần item / chỗ trống thật sự có: caller tự thử lại
+    template<typename MustWait>
+    static void wait(std::atomic<uint32_t>& state, MustWait mustWait, std::chrono::nanoseconds timeout) {
+        uint32_t current = state.load(std::memory_order_acquire);
+        if ((current & WAITERS) == 0) {
+            if (!state.compare_exchange_strong(current, current | WAITERS, std::memory_order_seq_cst,
+                                               std::memory_order_relaxed)) {
+                return;     // state vừa đổi (có notify) → thử lại
+            }
+            current |= WAITERS;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mustWait()) futexWait(state, current, timeout);
+    }
+
+    void notifyNotEmpty() { notify(notEmptyState); }
+    void notifyNotFull() { notify(notFullState); }
+
+    void waitNotEmpty(std::chrono::nanoseconds timeout) {
+        wait(notEmptyState, [this] { return size() == 0; }, timeout);
+    }
+
+    void waitNotFull(size_t incoming) {
+        wait(notFullState, [this, incoming] { return size() >= capacity || overByteLimit(incoming); },
+             std::chrono::nanoseconds(-1));
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(CACHE_LINE) std::atomic<size_t> enqueuePos{0};
+    alignas(CACHE_LINE) std::atomic<size_t> dequeuePos{0};
+    alignas(CACHE_LINE) std::atomic<size_t> queuedBytes{0};
+    std::atomic<size_t> maxBytes{0};
+    alignas(CACHE_LINE) std::atomic<uint32_t> notEmptyState{0};
+    alignas(CACHE_LINE) std::atomic<uint32_t> notFullState{0};
+};
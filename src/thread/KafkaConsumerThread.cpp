@@ -1,12 +1,23 @@
 #include "KafkaConsumerThread.h"
 #include "../common/Queues.h"
+#include "../common/MemoryAccountant.h"
+#include "../writer/CircuitBreaker.h"
 #include "../logger/Logger.h"
 
 void kafkaConsumerThread(KafkaConsumer& consumer, std::atomic<bool>& shouldShutdown) {
     static int64_t message_count = 0;
     static auto start_time = std::chrono::steady_clock::now();
+    auto& accountant = MemoryAccountant::getInstance();
+    bool paused = false;
 
     while (!shouldShutdown) {
+        // Vượt memory budget hoặc DB đang down (circuit breaker OPEN) → pause partition nhưng vẫn poll
+        // (rebalance, heartbeat). Khi đang pause, pause lại mỗi vòng để phủ cả partition mới assign.
+        const bool shouldPause = accountant.shouldPause() || CircuitBreaker::anyOpen();
+        if (shouldPause || paused) {
+            if (consumer.setConsumptionPaused(shouldPause)) paused = shouldPause;
+        }
+
         std::string message;
         int partition;
         int64_t offset;
@@ -15,7 +26,10 @@ void kafkaConsumerThread(KafkaConsumer& consumer, std::atomic<bool>& shouldShutd
 
         if (consumer.consumeMessage(message, partition, offset, timestamp, &rawMsg)) {
             message_count++;
-            kafkaMessageQueue.push({message, partition, offset, timestamp, rawMsg});
+            const size_t messageBytes = message.size();
+            accountant.trackMessage(rawMsg);
+            accountant.charge(MemoryAccountant::KAFKA_QUEUE, messageBytes);
+            kafkaMessageQueue.push(std::make_tuple(std::move(message), partition, offset, timestamp, rawMsg), messageBytes);
             std::stringstream ss;
             ss << "Pushed message to kafkaMessageQueue (offset: " << offset << ")";
             OpenSync::Logger::debug(ss.str());
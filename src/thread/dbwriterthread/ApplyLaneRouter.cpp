@@ -0,0 +1,405 @@
+#include "ApplyLaneRouter.h"
+#include "../../common/RowKeyHash.h"
+#include "../../common/TableBatchPool.h"
+#include "../../common/MemoryAccountant.h"
+#include "ApplySpillLog.h"
+#include "../../metrics/MetricsExporter.h"
+#include "../../logger/Logger.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+ApplyLaneRouter::ApplyLaneRouter() = default;
+ApplyLaneRouter::~ApplyLaneRouter() = default;
+
+ApplyLaneRouter& ApplyLaneRouter::getInstance() {
+    static ApplyLaneRouter instance;
+    return instance;
+}
+
+void ApplyLaneRouter::configure(size_t numWriters, size_t lanesPerTable, size_t queueCapacity, size_t queueMaxBytes) {
+    numWriters = std::max<size_t>(numWriters, 1);
+    lanes = std::max<size_t>(lanesPerTable, 1);
+    if (lanes > numWriters) {
+        OpenSync::Logger::warn("⚠️ apply_lanes_per_table=" + std::to_string(lanes) +
+                               " > num_db_writers=" + std::to_string(numWriters) + ", using " + std::to_string(numWriters));
+        lanes = numWriters;
+    }
+
+    queues.clear();
+    spills.clear();
+    handoffs.clear();
+    buildRing(numWriters);
+    {
+        std::lock_guard<std::mutex> lock(assignMutex);
+        assignments.clear();
+    }
+    for (size_t i = 0; i < numWriters; ++i) {
+        queues.push_back(std::make_unique<BoundedRingQueue<ApplyTask>>(queueCapacity));
+        queues.back()->setMaxBytes(queueMaxBytes);
+        handoffs.push_back(std::make_unique<Handoff>());
+    }
+    OpenSync::Logger::info("🛣️ Apply lanes: " + std::to_string(lanes) + " per table over " +
+                           std::to_string(numWriters) + " DB writers");
+}
+
+void ApplyLaneRouter::enableSpill(const std::string& dir, size_t segmentBytes, size_t maxBytesPerQueue) {
+    spills.clear();
+    for (size_t i = 0; i < queues.size(); ++i) {
+        spills.push_back(std::make_unique<ApplySpillLog>(dir, i, segmentBytes, maxBytesPerQueue));
+    }
+    OpenSync::Logger::info("💾 Apply spill enabled: " + dir + " (segment " + std::to_string(segmentBytes / (1024 * 1024)) +
+                           " MB, max " + std::to_string(maxBytesPerQueue / (1024 * 1024)) + " MB per writer)");
+}
+
+size_t ApplyLaneRouter::laneOf(uint64_t keyHash) const {
+    // Không xác định được key → lane 0 (vẫn có thứ tự với các row khác không có key)
+    if (lanes <= 1 || keyHash == RowKeyHash::UNKNOWN) return 0;
+    return static_cast<size_t>(keyHash % lanes);
+}
+
+void ApplyLaneRouter::configureRebalance(int intervalMs, double imbalanceRatio) {
+    std::lock_guard<std::mutex> lock(assignMutex);
+    rebalanceInterval = std::chrono::milliseconds(std::max(intervalMs, 0));
+    rebalanceRatio = std::max(imbalanceRatio, 1.0);
+    lastRebalance = std::chrono::steady_clock::now();
+    if (intervalMs > 0) {
+        OpenSync::Logger::info("⚖️ Apply rebalance every " + std::to_string(intervalMs) + " ms (imbalance ratio " +
+                               std::to_string(rebalanceRatio) + ")");
+    }
+}
+
+static uint64_t mixHash(uint64_t x) {
+    // splitmix64 finalizer: trải đều điểm trên vòng hash
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void ApplyLaneRouter::buildRing(size_t numWriters) {
+    // Nhiều điểm ảo mỗi writer để bảng chia đều; đổi num_db_writers chỉ dời ~1/N bảng
+    constexpr size_t VIRTUAL_NODES = 64;
+    ring.clear();
+    ring.reserve(numWriters * VIRTUAL_NODES);
+    for (size_t writer = 0; writer < numWriters; ++writer) {
+        for (size_t v = 0; v < VIRTUAL_NODES; ++v) {
+            ring.emplace_back(mixHash((static_cast<uint64_t>(writer) << 32) | v), writer);
+        }
+    }
+    std::sort(ring.begin(), ring.end());
+}
+
+size_t ApplyLaneRouter::ringWriter(const std::string& tableKey, size_t lane) const {
+    // Lane thứ k của bảng → writer phân biệt thứ k theo chiều kim đồng hồ, các lane không dồn vào một writer
+    const uint64_t point = mixHash(std::hash<std::string>{}(tableKey));
+    auto it = std::lower_bound(ring.begin(), ring.end(), std::make_pair(point, size_t{0}));
+    std::vector<size_t> seen;
+    for (size_t step = 0; step < ring.size(); ++step, ++it) {
+        if (it == ring.end()) it = ring.begin();
+        if (std::find(seen.begin(), seen.end(), it->second) != seen.end()) continue;
+        if (seen.size() == lane) return it->second;
+        seen.push_back(it->second);
+    }
+    return lane % queues.size();
+}
+
+ApplyLaneRouter::Assignment& ApplyLaneRouter::assignmentFor(const std::string& tableKey, size_t lane) {
+    auto it = assignments.find(tableKey);
+    if (it == assignments.end()) {
+        std::vector<Assignment> perLane(lanes);
+        for (size_t l = 0; l < lanes; ++l) perLane[l].writer = ringWriter(tableKey, l);
+        it = assignments.emplace(tableKey, std::move(perLane)).first;
+    }
+    return it->second[lane];
+}
+
+size_t ApplyLaneRouter::writerFor(const std::string& tableKey, size_t lane) {
+    std::lock_guard<std::mutex> lock(assignMutex);
+    return assignmentFor(tableKey, lane).writer;
+}
+
+void ApplyLaneRouter::taskDone(const ApplyTask& task, double elapsedMs) {
+    std::lock_guard<std::mutex> lock(assignMutex);
+    auto it = assignments.find(task.tableKey);
+    if (it == assignments.end() || task.lane >= it->second.size()) return;
+    auto& assignment = it->second[task.lane];
+    if (assignment.inflight > 0) --assignment.inflight;
+    assignment.loadMs += elapsedMs;
+}
+
+void ApplyLaneRouter::rebalanceLocked(std::chrono::steady_clock::time_point now) {
+    lastRebalance = now;
+    const size_t numWriters = queues.size();
+    if (numWriters < 2) return;
+
+    std::vector<double> writerLoad(numWriters, 0.0);
+    double total = 0;
+    for (const auto& [tableKey, perLane] : assignments) {
+        for (const auto& assignment : perLane) {
+            writerLoad[assignment.writer] += assignment.loadMs;
+            total += assignment.loadMs;
+        }
+    }
+
+    auto& metrics = MetricsExporter::getInstance();
+    for (size_t w = 0; w < numWriters; ++w) {
+        metrics.setGauge("apply_writer_load_ms", writerLoad[w], {{"writer", std::to_string(w)}});
+    }
+
+    const size_t hot = static_cast<size_t>(std::max_element(writerLoad.begin(), writerLoad.end()) - writerLoad.begin());
+    const size_t cold = static_cast<size_t>(std::min_element(writerLoad.begin(), writerLoad.end()) - writerLoad.begin());
+    const double gap = writerLoad[hot] - writerLoad[cold];
+
+    if (total > 0 && writerLoad[hot] > rebalanceRatio * total / static_cast<double>(numWriters)) {
+        // (bảng, lane) nặng nhất của writer nóng mà chuyển đi vẫn giảm chênh lệch, không còn task in-flight
+        // (mọi task cũ đã ghi xong → chuyển writer không đảo thứ tự) và writer lạnh chưa giữ lane khác của bảng
+        const std::string* bestTable = nullptr;
+        Assignment* best = nullptr;
+        for (auto& [tableKey, perLane] : assignments) {
+            const bool coldHasTable = std::any_of(perLane.begin(), perLane.end(),
+                                                  [cold](const Assignment& a) { return a.writer == cold; });
+            if (coldHasTable) continue;
+            for (auto& assignment : perLane) {
+                if (assignment.writer != hot || assignment.inflight > 0) continue;
+                if (assignment.loadMs <= 0 || assignment.loadMs >= gap) continue;
+                if (!best || assignment.loadMs > best->loadMs) {
+                    best = &assignment;
+                    bestTable = &tableKey;
+                }
+            }
+        }
+        if (best) {
+            OpenSync::Logger::info("⚖️ Moving table " + *bestTable + " from DB writer " + std::to_string(hot) +
+                                   " to " + std::to_string(cold) + " (load " + std::to_string(writerLoad[hot]) +
+                                   " ms vs " + std::to_string(writerLoad[cold]) + " ms)");
+            best->writer = cold;
+            metrics.incrementCounter("apply_affinity_moves_total");
+        }
+    }
+
+    // Tải là trung bình trượt: nửa đời bằng một chu kỳ rebalance
+    for (auto& [tableKey, perLane] : assignments) {
+        for (auto& assignment : perLane) assignment.loadMs *= 0.5;
+    }
+}
+
+ApplyLaneRouter::DispatchGate& ApplyLaneRouter::gateFor(const std::string& orderKey) {
+    std::lock_guard<std::mutex> lock(gatesMutex);
+    auto& gate = gates[orderKey];
+    if (!gate) gate = std::make_unique<DispatchGate>();
+    return *gate;
+}
+
+void ApplyLaneRouter::dispatch(const std::string& tableKey, TableBatch&& batch, const std::string& orderKey, uint64_t seq) {
+    auto completion = std::make_shared<BatchCompletion>();
+    completion->messages = std::move(batch.messages);
+
+    std::vector<TableBatch> perLane(lanes);
+    if (lanes == 1) {
+        perLane[0].sqls = std::move(batch.sqls);
+        perLane[0].keyHashes = std::move(batch.keyHashes);
+        perLane[0].origins = std::move(batch.origins);
+    } else {
+        auto& pool = TableBatchPool::getInstance();
+        for (auto& laneBatch : perLane) laneBatch = pool.acquireBatch();
+        for (size_t i = 0; i < batch.sqls.size(); ++i) {
+            const uint64_t keyHash = i < batch.keyHashes.size() ? batch.keyHashes[i] : RowKeyHash::UNKNOWN;
+            auto& laneBatch = perLane[laneOf(keyHash)];
+            laneBatch.sqls.push_back(std::move(batch.sqls[i]));
+            laneBatch.keyHashes.push_back(keyHash);
+            if (i < batch.origins.size()) laneBatch.origins.push_back(batch.origins[i]);
+        }
+    }
+
+    // Batch chỉ có message (không có SQL) vẫn cần một task ở lane 0 để commit offset
+    std::vector<size_t> used;
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        if (!perLane[lane].sqls.empty()) used.push_back(lane);
+    }
+    if (used.empty()) used.push_back(0);
+    completion->remaining.store(static_cast<int>(used.size()), std::memory_order_relaxed);
+
+    // Chia lane song song; từ đây tới hết enqueue đi theo đúng thứ tự seq của bảng / nhóm
+    DispatchGate& gate = gateFor(orderKey);
+    {
+        std::unique_lock<std::mutex> gateLock(gate.mtx);
+        gate.turn.wait(gateLock, [&gate, seq]() { return gate.next == seq; });
+    }
+
+    // Chọn writer và đánh dấu in-flight trước khi push: rebalance không chuyển (bảng, lane) đang có task
+    std::vector<size_t> writerIndex(lanes, 0);
+    {
+        std::lock_guard<std::mutex> assignLock(assignMutex);
+        const auto now = std::chrono::steady_clock::now();
+        if (rebalanceInterval.count() > 0 && now - lastRebalance >= rebalanceInterval) rebalanceLocked(now);
+        for (size_t lane : used) {
+            auto& assignment = assignmentFor(tableKey, lane);
+            ++assignment.inflight;
+            writerIndex[lane] = assignment.writer;
+        }
+    }
+
+    auto& scheduler = WriteSetScheduler::getInstance();
+    const bool tracking = scheduler.isEnabled();
+    // Tracking: register ticket + xếp vào handoff của writer dưới dispatchMutex (không block),
+    // enqueue thật (có thể block khi queue / spill log đầy) sau khi nhả lock
+    std::unique_lock<std::mutex> lock(dispatchMutex, std::defer_lock);
+    if (tracking) lock.lock();
+    std::vector<std::pair<size_t, uint64_t>> handedOff;     // (writer, số thứ tự trong handoff)
+
+    std::vector<uint64_t> writeSet;
+    for (size_t lane : used) {
+        ApplyTask task;
+        task.tableKey = tableKey;
+        task.batch = std::move(perLane[lane]);
+        task.lane = lane;
+        task.completion = completion;
+        if (tracking) {
+            // FK dependency keys của batch gắn cho mọi lane (bảo thủ: không biết row nào tham chiếu)
+            writeSet.assign(task.batch.keyHashes.begin(), task.batch.keyHashes.end());
+            writeSet.insert(writeSet.end(), batch.dependencyKeys.begin(), batch.dependencyKeys.end());
+            task.ticket = scheduler.registerWriteSet(writeSet);
+        }
+        size_t taskBytes = 0;
+        for (const auto& sql : task.batch.sqls) taskBytes += sql.size();
+        task.bytes = taskBytes;
+        MemoryAccountant::getInstance().charge(MemoryAccountant::APPLY_QUEUE, taskBytes);
+        if (tracking) {
+            Handoff& handoff = *handoffs[writerIndex[lane]];
+            std::lock_guard<std::mutex> handoffLock(handoff.mtx);
+            handoff.tasks.emplace_back(std::move(task), taskBytes);
+            handedOff.emplace_back(writerIndex[lane], ++handoff.queued);
+        } else {
+            enqueue(writerIndex[lane], std::move(task), taskBytes);
+        }
+    }
+    if (lock.owns_lock()) lock.unlock();
+    for (const auto& [writer, ticketNo] : handedOff) drainHandoff(writer, ticketNo);
+    {
+        std::lock_guard<std::mutex> gateLock(gate.mtx);
+        ++gate.next;
+    }
+    gate.turn.notify_all();
+
+    // Lane không dùng và vỏ batch gốc (string đã move sang lane) quay lại pool
+    auto& pool = TableBatchPool::getInstance();
+    for (auto& laneBatch : perLane) {
+        if (laneBatch.sqls.capacity() > 0) pool.releaseBatch(std::move(laneBatch));
+    }
+    pool.releaseBatch(std::move(batch));
+}
+
+void ApplyLaneRouter::drainHandoff(size_t writerIndex, uint64_t upTo) {
+    // Một thread đẩy handoff của writer vào queue theo đúng thứ tự register; thread khác chờ tới khi task của
+    // mình đã vào queue (vẫn bị back-pressure khi queue đầy, nhưng chỉ theo writer đó)
+    Handoff& handoff = *handoffs[writerIndex];
+    std::unique_lock<std::mutex> lock(handoff.mtx);
+    while (handoff.pushed < upTo) {
+        if (handoff.draining) {
+            handoff.drained.wait(lock);
+            continue;
+        }
+        handoff.draining = true;
+        while (!handoff.tasks.empty()) {
+            auto [task, taskBytes] = std::move(handoff.tasks.front());
+            handoff.tasks.pop_front();
+            lock.unlock();
+            enqueue(writerIndex, std::move(task), taskBytes);
+            lock.lock();
+            ++handoff.pushed;
+            handoff.drained.notify_all();
+        }
+        handoff.draining = false;
+        handoff.drained.notify_all();
+    }
+}
+
+void ApplyLaneRouter::enqueue(size_t writerIndex, ApplyTask&& task, size_t taskBytes) {
+    auto& queue = *queues[writerIndex];
+    if (spills.empty()) {
+        queue.push(std::move(task), taskBytes);
+        return;
+    }
+
+    // Khi log có task, mọi task mới đều vào log (sau các task đã spill) để giữ thứ tự FIFO của writer
+    ApplySpillLog& spill = *spills[writerIndex];
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(spill.mutex());
+            if (spill.empty() && queue.try_push(std::move(task), taskBytes)) return;
+
+            auto completion = task.completion;
+            if (completion) detachMessages(*completion);
+            if (spill.append(task)) {
+                MemoryAccountant::getInstance().release(MemoryAccountant::APPLY_QUEUE, taskBytes);
+                MetricsExporter::getInstance().incrementCounter("apply_spilled_tasks_total", {{"writer", std::to_string(writerIndex)}});
+                return;
+            }
+            if (spill.empty()) break;
+        }
+        // Log đầy: chờ writer đọc bớt (không được vượt qua các task đang nằm trong log)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    queue.push(std::move(task), taskBytes);
+}
+
+void ApplyLaneRouter::detachMessages(BatchCompletion& completion) {
+    // Batch xuống đĩa có thể nằm đó lâu: trả payload Kafka (và fetch buffer librdkafka giữ theo nó),
+    // chỉ giữ topic / partition / offset để commit sau khi ghi xong
+    auto& accountant = MemoryAccountant::getInstance();
+    std::vector<rd_kafka_message_t*> kept;
+    for (auto* msg : completion.messages) {
+        KafkaOffsetRef ref{msg->rkt ? rd_kafka_topic_name(msg->rkt) : "", msg->partition, msg->offset};
+        if (accountant.detachMessage(msg)) {
+            completion.offsets.push_back(std::move(ref));
+        } else {
+            kept.push_back(msg);   // message dùng chung với batch của bảng khác
+        }
+    }
+    completion.messages.swap(kept);
+}
+
+bool ApplyLaneRouter::popSpilled(size_t writerIndex, ApplyTask& task) {
+    if (spills.empty()) return false;
+    ApplySpillLog& spill = *spills[writerIndex];
+    std::lock_guard<std::mutex> lock(spill.mutex());
+    return spill.readNext(task);
+}
+
+// Task trong queue luôn cũ hơn task trong spill log (log chỉ nhận khi queue đầy và giữ tới khi rỗng)
+bool ApplyLaneRouter::pop(size_t writerIndex, ApplyTask& task, std::chrono::milliseconds timeout) {
+    writerIndex %= queues.size();
+    auto& queue = *queues[writerIndex];
+    if (queue.try_pop_nowait(task) || popSpilled(writerIndex, task)) return true;
+    return queue.try_pop(task, timeout) || popSpilled(writerIndex, task);
+}
+
+bool ApplyLaneRouter::tryPop(size_t writerIndex, ApplyTask& task) {
+    writerIndex %= queues.size();
+    return queues[writerIndex]->try_pop_nowait(task) || popSpilled(writerIndex, task);
+}
+
+size_t ApplyLaneRouter::queuedTasks() const {
+    size_t total = 0;
+    for (const auto& queue : queues) total += queue->size();
+    return total + spilledTasks();
+}
+
+size_t ApplyLaneRouter::spilledTasks() const {
+    size_t total = 0;
+    for (const auto& spill : spills) {
+        std::lock_guard<std::mutex> lock(spill->mutex());
+        total += spill->size();
+    }
+    return total;
+}
+
+size_t ApplyLaneRouter::spilledBytes() const {
+    size_t total = 0;
+    for (const auto& spill : spills) {
+        std::lock_guard<std::mutex> lock(spill->mutex());
+        total += spill->bytesOnDisk();
+    }
+    return total;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <librdkafka/rdkafka.h>
+#include "../../common/TableBatch.h"
+#include "../BoundedRingQueue.h"
+#include "WriteSetScheduler.h"
+
+class ApplySpillLog;
+
+// Vị trí Kafka của message đã destroy sớm (batch bị spill xuống đĩa) → commit theo offset
+struct KafkaOffsetRef {
+    std::string topic;
+    int32_t partition = 0;
+    int64_t offset = 0;
+};
+
+// Một TableBatch (một lần flush của aggregator) có thể bị tách thành nhiều lane.
+// Kafka message chỉ được commit khi tất cả lane của batch đã ghi xong.
+struct BatchCompletion {
+    std::vector<rd_kafka_message_t*> messages;
+    std::vector<KafkaOffsetRef> offsets;    // message đã được giải phóng khi spill
+    std::atomic<int> remaining{0};
+    std::atomic<bool> failed{false};
+
+    // true nếu đây là lane cuối cùng hoàn thành → caller commit / destroy messages
+    bool finish(bool success) {
+        if (!success) failed.store(true, std::memory_order_relaxed);
+        return remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+};
+
+struct ApplyTask {
+    std::string tableKey;
+    TableBatch batch;       // sqls + keyHashes của lane (messages nằm trong completion)
+    size_t lane = 0;
+    size_t bytes = 0;       // tổng SQL text, charge vào MemoryAccountant::APPLY_QUEUE tới khi ghi xong
+    std::shared_ptr<BatchCompletion> completion;
+    std::shared_ptr<ApplyTicket> ticket;    // chỉ có khi bật apply_dependency_tracking
+};
+
+// Chia thay đổi của một bảng thành K lane theo RowKeyHash: cùng key → cùng lane → cùng DB writer
+// (một queue FIFO + một connection) nên thứ tự theo key được giữ, còn một bảng được ghi K luồng song song.
+// (bảng, lane) được gán cho writer bằng consistent hashing; rebalance theo tải quan sát được chỉ chuyển
+// (bảng, lane) không còn task in-flight, nên mỗi (bảng, lane) chỉ thuộc một writer và writer không chờ nhau.
+class ApplyLaneRouter {
+public:
+    static ApplyLaneRouter& getInstance();
+
+    // Gọi một lần trước khi start worker / DB writer. lanesPerTable bị giới hạn bởi numWriters.
+    // queueMaxBytes: giới hạn tổng SQL text chờ trong queue của mỗi writer (0 = chỉ theo số task)
+    void configure(size_t numWriters, size_t lanesPerTable, size_t queueCapacity, size_t queueMaxBytes = 0);
+
+    // Bật spill xuống đĩa cho mọi queue (gọi sau configure, trước khi start worker).
+    // maxBytesPerQueue: hết chỗ thì dispatch block như khi không có spill.
+    void enableSpill(const std::string& dir, size_t segmentBytes, size_t maxBytesPerQueue);
+
+    // Worker: tách batch theo lane và push vào queue của writer tương ứng (block khi queue đầy).
+    // seq: thứ tự lấy ra khỏi aggregator theo orderKey (0, 1, 2...): batch seq n chờ batch n - 1 của cùng
+    // orderKey enqueue xong, nên worker flush song song không đảo thứ tự apply của bảng / nhóm FK
+    void dispatch(const std::string& tableKey, TableBatch&& batch, const std::string& orderKey, uint64_t seq);
+
+    // DB writer writerIndex lấy task của mình
+    bool pop(size_t writerIndex, ApplyTask& task, std::chrono::milliseconds timeout);
+    bool tryPop(size_t writerIndex, ApplyTask& task);
+
+    // Bật rebalance: mỗi intervalMs chuyển tối đa một (bảng, lane) rảnh từ writer nặng nhất sang writer
+    // nhẹ nhất khi tải (thời gian apply) của writer nặng nhất vượt imbalanceRatio × trung bình
+    void configureRebalance(int intervalMs, double imbalanceRatio);
+
+    size_t laneOf(uint64_t keyHash) const;
+    // Writer đang giữ (bảng, lane), gán lần đầu theo consistent hash
+    size_t writerFor(const std::string& tableKey, size_t lane);
+    // Gọi sau khi task đã ghi xong (thành công hay không): giảm in-flight, cộng tải cho (bảng, lane)
+    void taskDone(const ApplyTask& task, double elapsedMs);
+
+    size_t writerCount() const { return queues.size(); }
+    size_t lanesPerTable() const { return lanes; }
+    size_t queuedTasks() const;
+    size_t spilledTasks() const;
+    size_t spilledBytes() const;
+
+private:
+    ApplyLaneRouter();
+    ~ApplyLaneRouter();
+
+    struct Assignment {
+        size_t writer = 0;
+        size_t inflight = 0;    // task đã dispatch chưa ghi xong; chỉ chuyển writer khi = 0
+        double loadMs = 0;      // thời gian apply, giảm một nửa sau mỗi vòng rebalance
+    };
+
+    // Thứ tự enqueue theo orderKey; worker chỉ chờ batch trước của cùng bảng / nhóm
+    struct DispatchGate {
+        std::mutex mtx;
+        std::condition_variable turn;
+        uint64_t next = 0;
+    };
+
+    DispatchGate& gateFor(const std::string& orderKey);
+
+    // Write-set tracking: task đã register ticket, chờ vào queue của writer theo đúng thứ tự register
+    struct Handoff {
+        std::mutex mtx;
+        std::condition_variable drained;
+        std::deque<std::pair<ApplyTask, size_t>> tasks;     // (task, bytes)
+        uint64_t queued = 0;        // số task đã xếp vào handoff
+        uint64_t pushed = 0;        // số task đã vào queue
+        bool draining = false;
+    };
+
+    void buildRing(size_t numWriters);
+    size_t ringWriter(const std::string& tableKey, size_t lane) const;
+    // Caller giữ assignMutex
+    Assignment& assignmentFor(const std::string& tableKey, size_t lane);
+    void rebalanceLocked(std::chrono::steady_clock::time_point now);
+
+    void enqueue(size_t writerIndex, ApplyTask&& task, size_t taskBytes);
+    // Đẩy handoff của writer vào queue tới khi task thứ upTo đã vào queue
+    void drainHandoff(size_t writerIndex, uint64_t upTo);
+    bool popSpilled(size_t writerIndex, ApplyTask& task);
+    void detachMessages(BatchCompletion& completion);
+
+    std::vector<std::unique_ptr<BoundedRingQueue<ApplyTask>>> queues;
+    std::vector<std::unique_ptr<ApplySpillLog>> spills;   // rỗng = không spill
+    std::vector<std::unique_ptr<Handoff>> handoffs;      // theo writer
+    size_t lanes = 1;
+
+    std::vector<std::pair<uint64_t, size_t>> ring;     // (điểm trên vòng hash, writer), đã sort
+    std::unordered_map<std::string, std::vector<Assignment>> assignments;   // tableKey → theo lane
+    std::mutex assignMutex;
+    std::chrono::milliseconds rebalanceInterval{0};     // 0 = không rebalance
+    double rebalanceRatio = 1.5;
+    std::chrono::steady_clock::time_point lastRebalance;
+    // Write-set tracking: thứ tự register ticket == thứ tự trong handoff của mỗi writer (chỉ giữ khi xếp handoff)
+    std::mutex dispatchMutex;
+    std::mutex gatesMutex;
+    std::unordered_map<std::string, std::unique_ptr<DispatchGate>> gates;
+};
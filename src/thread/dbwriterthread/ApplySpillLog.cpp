@@ -0,0 +1,170 @@
+#include "ApplySpillLog.h"
+#include "ApplyLaneRouter.h"
+#include "../../common/TableBatchPool.h"
+#include "../../logger/Logger.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Record trên đĩa: [u32 sqlCount][u32 hashCount][u32 originCount] ([u32 len][bytes]) * sqlCount
+// [u64 keyHash] * hashCount ([u32 partition][u64 offset]) * originCount
+static void putU32(char*& p, uint32_t v) { std::memcpy(p, &v, sizeof(v)); p += sizeof(v); }
+static void putU64(char*& p, uint64_t v) { std::memcpy(p, &v, sizeof(v)); p += sizeof(v); }
+static uint32_t getU32(const char*& p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); p += sizeof(v); return v; }
+static uint64_t getU64(const char*& p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); p += sizeof(v); return v; }
+
+ApplySpillLog::ApplySpillLog(std::string dir, size_t queueIndex, size_t segmentBytes, size_t maxBytes)
+    : dir(std::move(dir)), queueIndex(queueIndex), segmentBytes(segmentBytes), maxBytes(maxBytes) {
+    std::error_code ec;
+    fs::create_directories(this->dir, ec);
+    if (ec) {
+        OpenSync::Logger::error("❌ Cannot create spill dir " + this->dir + ": " + ec.message());
+    }
+    removeStaleSegments();
+}
+
+ApplySpillLog::~ApplySpillLog() {
+    for (auto& segment : segments) closeSegment(segment, true);
+}
+
+void ApplySpillLog::removeStaleSegments() {
+    // Segment của lần chạy trước: watermark commit không vượt qua task chưa ghi → Kafka giao lại, bỏ file
+    const std::string prefix = "apply-" + std::to_string(queueIndex) + "-";
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) == 0 && entry.path().extension() == ".spill") {
+            fs::remove(entry.path(), ec);
+        }
+    }
+}
+
+bool ApplySpillLog::openSegment(size_t minBytes) {
+    Segment segment;
+    segment.path = dir + "/apply-" + std::to_string(queueIndex) + "-" + std::to_string(nextSegmentId++) + ".spill";
+    segment.capacity = std::max(segmentBytes, minBytes);
+
+    segment.fd = open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (segment.fd < 0 || ftruncate(segment.fd, static_cast<off_t>(segment.capacity)) != 0) {
+        OpenSync::Logger::error("❌ Cannot create spill segment " + segment.path + ": " + std::strerror(errno));
+        closeSegment(segment, true);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, segment.capacity, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+    if (addr == MAP_FAILED) {
+        OpenSync::Logger::error("❌ Cannot mmap spill segment " + segment.path + ": " + std::strerror(errno));
+        closeSegment(segment, true);
+        return false;
+    }
+    segment.data = static_cast<char*>(addr);
+
+    // Segment cũ đã ghi xong: bắt đầu writeback để page cache có thể thu hồi
+    if (!segments.empty()) msync(segments.back().data, segments.back().writePos, MS_ASYNC);
+
+    segments.push_back(std::move(segment));
+    return true;
+}
+
+void ApplySpillLog::closeSegment(Segment& segment, bool remove) {
+    if (segment.data) munmap(segment.data, segment.capacity);
+    if (segment.fd >= 0) close(segment.fd);
+    if (remove && !segment.path.empty()) unlink(segment.path.c_str());
+    segment.data = nullptr;
+    segment.fd = -1;
+}
+
+size_t ApplySpillLog::encodedSize(const TableBatch& batch) {
+    size_t size = 3 * sizeof(uint32_t) + batch.keyHashes.size() * sizeof(uint64_t) +
+                  batch.origins.size() * (sizeof(uint32_t) + sizeof(uint64_t));
+    for (const auto& sql : batch.sqls) size += sizeof(uint32_t) + sql.size();
+    return size;
+}
+
+bool ApplySpillLog::append(ApplyTask& task) {
+    const size_t length = encodedSize(task.batch);
+    if (maxBytes > 0 && diskBytes + length > maxBytes) return false;
+
+    if (segments.empty() || segments.back().capacity - segments.back().writePos < length) {
+        if (!openSegment(length)) return false;
+    }
+
+    Segment& segment = segments.back();
+    char* p = segment.data + segment.writePos;
+    putU32(p, static_cast<uint32_t>(task.batch.sqls.size()));
+    putU32(p, static_cast<uint32_t>(task.batch.keyHashes.size()));
+    putU32(p, static_cast<uint32_t>(task.batch.origins.size()));
+    for (const auto& sql : task.batch.sqls) {
+        putU32(p, static_cast<uint32_t>(sql.size()));
+        std::memcpy(p, sql.data(), sql.size());
+        p += sql.size();
+    }
+    for (uint64_t hash : task.batch.keyHashes) putU64(p, hash);
+    for (const auto& origin : task.batch.origins) {
+        putU32(p, static_cast<uint32_t>(origin.partition));
+        putU64(p, static_cast<uint64_t>(origin.offset));
+    }
+    segment.writePos += length;
+    diskBytes += length;
+
+    records.push_back({std::move(task.tableKey), task.lane, std::move(task.completion), std::move(task.ticket), length});
+    TableBatchPool::getInstance().releaseBatch(std::move(task.batch));
+    task = ApplyTask();
+    return true;
+}
+
+bool ApplySpillLog::readNext(ApplyTask& task) {
+    if (records.empty()) return false;
+
+    // Segment đầu đã đọc hết (và không còn ghi vào nữa) → xoá file
+    while (segments.size() > 1 && segments.front().readPos >= segments.front().writePos) {
+        closeSegment(segments.front(), true);
+        segments.pop_front();
+    }
+
+    Record& record = records.front();
+    Segment& segment = segments.front();
+    const char* p = segment.data + segment.readPos;
+
+    task = ApplyTask();
+    task.batch = TableBatchPool::getInstance().acquireBatch();
+    const uint32_t sqlCount = getU32(p);
+    const uint32_t hashCount = getU32(p);
+    const uint32_t originCount = getU32(p);
+    for (uint32_t i = 0; i < sqlCount; ++i) {
+        const uint32_t len = getU32(p);
+        std::string sql = TableBatchPool::getInstance().acquireString();
+        sql.assign(p, len);
+        p += len;
+        task.batch.sqls.push_back(std::move(sql));
+    }
+    for (uint32_t i = 0; i < hashCount; ++i) task.batch.keyHashes.push_back(getU64(p));
+    for (uint32_t i = 0; i < originCount; ++i) {
+        RowOrigin origin;
+        origin.partition = static_cast<int32_t>(getU32(p));
+        origin.offset = static_cast<int64_t>(getU64(p));
+        task.batch.origins.push_back(origin);
+    }
+
+    task.tableKey = std::move(record.tableKey);
+    task.lane = record.lane;
+    task.completion = std::move(record.completion);
+    task.ticket = std::move(record.ticket);
+    task.bytes = 0;   // đã trả APPLY_QUEUE khi spill
+
+    segment.readPos += record.length;
+    diskBytes -= record.length;
+    records.pop_front();
+
+    // Log rỗng: dùng lại segment hiện tại từ đầu
+    if (records.empty() && segments.size() == 1) {
+        segments.front().readPos = 0;
+        segments.front().writePos = 0;
+    }
+    return true;
+}
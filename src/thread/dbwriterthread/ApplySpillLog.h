@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../../common/TableBatch.h"
+
+struct BatchCompletion;
+struct ApplyTicket;
+struct ApplyTask;
+
+// Overflow của một queue ApplyLaneRouter khi DB chậm / ngừng: task không vào được queue (đầy theo số task
+// hoặc apply_queue_max_mb) được append vào segment file mmap (append-only) thay vì block worker,
+// và DB writer đọc lại đúng thứ tự khi queue trống. Phần nặng (SQL text, key hash) nằm trên đĩa;
+// completion / write-set ticket (con trỏ) giữ trong bộ nhớ theo cùng thứ tự.
+// Không phải log bền vững: khi khởi động segment cũ bị xoá. Offset chỉ được commit tới watermark liên tục
+// của partition (CommitWatermark) nên task còn trong segment chưa được commit và Kafka giao lại.
+class ApplySpillLog {
+public:
+    ApplySpillLog(std::string dir, size_t queueIndex, size_t segmentBytes, size_t maxBytes);
+    ~ApplySpillLog();
+
+    ApplySpillLog(const ApplySpillLog&) = delete;
+    ApplySpillLog& operator=(const ApplySpillLog&) = delete;
+
+    // Caller giữ mutex() cho mọi thao tác bên dưới
+    std::mutex& mutex() { return mtx; }
+
+    bool empty() const { return records.empty(); }
+    size_t size() const { return records.size(); }
+    size_t bytesOnDisk() const { return diskBytes; }
+
+    // false nếu vượt max bytes hoặc lỗi IO (task giữ nguyên); true: SQL đã nằm trên đĩa, task bị move
+    bool append(ApplyTask& task);
+    // Lấy task cũ nhất (SQL đọc lại từ segment); false nếu log rỗng
+    bool readNext(ApplyTask& task);
+
+private:
+    struct Segment {
+        std::string path;
+        int fd = -1;
+        char* data = nullptr;
+        size_t capacity = 0;
+        size_t writePos = 0;
+        size_t readPos = 0;
+    };
+
+    // Metadata trong bộ nhớ của một record trên đĩa
+    struct Record {
+        std::string tableKey;
+        size_t lane = 0;
+        std::shared_ptr<BatchCompletion> completion;
+        std::shared_ptr<ApplyTicket> ticket;
+        size_t length = 0;
+    };
+
+    bool openSegment(size_t minBytes);
+    void closeSegment(Segment& segment, bool remove);
+    void removeStaleSegments();
+
+    static size_t encodedSize(const TableBatch& batch);
+
+    std::string dir;
+    size_t queueIndex;
+    size_t segmentBytes;
+    size_t maxBytes;
+    uint64_t nextSegmentId = 0;
+    size_t diskBytes = 0;
+
+    std::mutex mtx;
+    std::deque<Segment> segments;    // front: đang đọc, back: đang ghi
+    std::deque<Record> records;
+};
@@ -0,0 +1,522 @@
+#include "AsyncPgWriter.h"
+#include "DBWriterThread.h"
+#include "../../writer/DeadLetterStore.h"
+#include "../../writer/TableHealthRegistry.h"
+#include "../../writer/CircuitBreaker.h"
+#include "../../metrics/MetricsExporter.h"
+#include "../../logger/Logger.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+static const std::string DB_TYPE = "postgresql";
+
+AsyncPgWriter::AsyncPgWriter(std::string connInfo, KafkaConsumer& consumer, size_t loopIndex, std::vector<size_t> queueIndexes,
+                             size_t savepointInterval, const WriteDataToDB::RetryOptions& retry,
+                             std::shared_ptr<CircuitBreaker> breaker)
+    : connInfo(std::move(connInfo)), consumer(consumer), loopIndex(loopIndex), savepointInterval(savepointInterval),
+      retry(retry), breaker(std::move(breaker)) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        OpenSync::Logger::error("❌ AsyncPgWriter: epoll_create1 failed: " + std::string(std::strerror(errno)));
+    }
+
+    connections.resize(queueIndexes.size());
+    for (size_t i = 0; i < queueIndexes.size(); ++i) {
+        connections[i].slot = i;
+        connections[i].queueIndex = queueIndexes[i];
+    }
+}
+
+AsyncPgWriter::~AsyncPgWriter() {
+    for (auto& c : connections) closeConnection(c);
+    if (epfd >= 0) close(epfd);
+}
+
+// ----- connection -----
+
+void AsyncPgWriter::startConnect(Connection& c) {
+    c.conn = PQconnectStart(connInfo.c_str());
+    if (!c.conn || PQstatus(c.conn) == CONNECTION_BAD) {
+        failConnection(c, c.conn ? PQerrorMessage(c.conn) : "out of memory");
+        return;
+    }
+    c.state = State::CONNECTING;
+    // libpq: bắt đầu như PGRES_POLLING_WRITING
+    watch(c, EPOLLOUT);
+}
+
+void AsyncPgWriter::pollConnect(Connection& c) {
+    switch (PQconnectPoll(c.conn)) {
+        case PGRES_POLLING_READING:
+            watch(c, EPOLLIN);
+            break;
+        case PGRES_POLLING_WRITING:
+            watch(c, EPOLLOUT);
+            break;
+        case PGRES_POLLING_OK:
+            if (PQsetnonblocking(c.conn, 1) != 0 || PQenterPipelineMode(c.conn) != 1) {
+                failConnection(c, PQerrorMessage(c.conn));
+                return;
+            }
+            c.state = State::IDLE;
+            c.connectFailures = 0;
+            watch(c, EPOLLIN);
+            OpenSync::Logger::info("✅ AsyncPgWriter loop " + std::to_string(loopIndex) +
+                                   ": connection for apply queue " + std::to_string(c.queueIndex) + " ready");
+            break;
+        default:
+            failConnection(c, PQerrorMessage(c.conn));
+            break;
+    }
+}
+
+void AsyncPgWriter::closeConnection(Connection& c) {
+    if (c.fd >= 0 && c.events != 0 && epfd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+    }
+    if (c.conn) PQfinish(c.conn);
+    c.conn = nullptr;
+    c.fd = -1;
+    c.events = 0;
+    c.state = State::DISCONNECTED;
+}
+
+void AsyncPgWriter::failConnection(Connection& c, const std::string& reason) {
+    std::stringstream ss;
+    ss << "❌ AsyncPgWriter loop " << loopIndex << ", apply queue " << c.queueIndex << ": " << reason;
+    OpenSync::Logger::error(ss.str());
+    if (breaker) breaker->recordFailure(DBExecResult::CONNECTION_LOST, reason);
+
+    // Task đang ghi dở: transaction bị server rollback khi mất connection → giữ task, chạy lại cả batch
+    // trên connection mới. Task chưa bắt đầu (pending) cũng được giữ lại
+    if (c.state == State::BUSY) holdForRetry(c, DBExecResult::CONNECTION_LOST, reason);
+    closeConnection(c);
+    c.retryAt = std::chrono::steady_clock::now() +
+                CircuitBreaker::backoff(c.connectFailures++, retry.baseDelayMs, retry.maxDelayMs);
+    MetricsExporter::getInstance().incrementCounter("pg_async_connection_errors_total", {{"loop", std::to_string(loopIndex)}});
+}
+
+void AsyncPgWriter::watch(Connection& c, uint32_t events) {
+    if (epfd < 0) return;
+
+    // Socket có thể đổi trong lúc connect (thử host / SSL khác)
+    const int fd = PQsocket(c.conn);
+    if (fd != c.fd) {
+        if (c.fd >= 0 && c.events != 0) epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+        c.fd = fd;
+        c.events = 0;
+    }
+    if (c.fd < 0 || events == c.events) return;
+
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = c.slot;
+    if (epoll_ctl(epfd, c.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, c.fd, &ev) != 0) {
+        OpenSync::Logger::error("❌ AsyncPgWriter: epoll_ctl failed: " + std::string(std::strerror(errno)));
+        return;
+    }
+    c.events = events;
+}
+
+// ----- task -----
+
+bool AsyncPgWriter::admitWrite() {
+    return !breaker || breaker->tryAcquire();
+}
+
+bool AsyncPgWriter::tryStartTask(Connection& c) {
+    if (c.state != State::IDLE) return false;
+
+    if (c.restart) {
+        if (std::chrono::steady_clock::now() < c.restartAt || !admitWrite()) return false;
+        restartTask(c);
+        return true;
+    }
+
+    if (!c.pending) {
+        if (!ApplyLaneRouter::getInstance().tryPop(c.queueIndex, c.task)) return false;
+        c.pending = true;
+    }
+    // Không block như waitForPredecessors: loop poll lại ở vòng sau
+    if (c.task.ticket && !WriteSetScheduler::getInstance().isReady(*c.task.ticket)) return false;
+
+    // Batch chỉ có message: commit offset, không cần round-trip DB.
+    // Bảng đang quarantine: batch ra file hold (monitor probe ghi lại qua WriteDataToDB).
+    // Cả hai không qua breaker (không chiếm lượt ghi thử khi HALF_OPEN)
+    const bool skipDb = c.task.batch.sqls.empty() ||
+                        TableHealthRegistry::getInstance().divert(c.task.tableKey, c.task.batch);
+    if (!skipDb && !admitWrite()) return false;
+
+    c.pending = false;
+    beginTask(c);
+    if (skipDb) {
+        finishTask(c, true);
+    } else {
+        startBatch(c);
+    }
+    return true;
+}
+
+void AsyncPgWriter::beginTask(Connection& c) {
+    MetricsExporter::getInstance().incrementGauge("active_tables", c.task.tableKey);
+    c.startedAt = std::chrono::steady_clock::now();
+    c.state = State::BUSY;
+}
+
+void AsyncPgWriter::startBatch(Connection& c) {
+    c.skip.assign(c.task.batch.sqls.size(), 0);
+    c.skipped = 0;
+    c.from = 0;
+    c.resume = false;
+    sendBatch(c);
+}
+
+void AsyncPgWriter::restartTask(Connection& c) {
+    c.pending = false;
+    c.restart = false;
+    c.state = State::BUSY;
+    // Statement đã skip / dead-letter ở lần trước vẫn được bỏ qua
+    c.from = 0;
+    c.resume = false;
+    sendBatch(c);
+}
+
+void AsyncPgWriter::holdForRetry(Connection& c, DBExecResult errorClass, const std::string& reason) {
+    ++c.attempt;
+    MetricsExporter::getInstance().incrementCounter("db_write_retries_total",
+        {{"db_type", DB_TYPE}, {"error", DBExceptionHelper::toString(errorClass)}});
+    if (retry.maxAttempts > 0 && c.attempt >= retry.maxAttempts) {
+        OpenSync::Logger::error("❌ Giving up on batch of " + c.task.tableKey + " after " + std::to_string(c.attempt) +
+                                " attempts: " + reason);
+        finishTask(c, false);
+        return;
+    }
+
+    const auto delay = CircuitBreaker::backoff(c.attempt - 1, retry.baseDelayMs, retry.maxDelayMs);
+    OpenSync::Logger::warn("🔁 Transient " + DB_TYPE + " error on " + c.task.tableKey + " (" +
+                           DBExceptionHelper::toString(errorClass) + "), retry " + std::to_string(c.attempt) +
+                           " in " + std::to_string(delay.count()) + " ms: " + reason);
+    scheduleRestart(c, delay);
+}
+
+void AsyncPgWriter::scheduleRestart(Connection& c, std::chrono::milliseconds delay) {
+    c.state = State::IDLE;
+    c.pending = true;
+    c.restart = true;
+    c.restartAt = std::chrono::steady_clock::now() + delay;
+}
+
+bool AsyncPgWriter::sendCommand(Connection& c, const char* sql) {
+    if (!PQsendQueryParams(c.conn, sql, 0, nullptr, nullptr, nullptr, nullptr, 0)) {
+        failConnection(c, PQerrorMessage(c.conn));
+        return false;
+    }
+    return true;
+}
+
+void AsyncPgWriter::sendBatch(Connection& c) {
+    c.phase = Phase::APPLY;
+    c.commands.clear();
+    c.resultCmd = 0;
+    c.failed = false;
+    c.failedIndex = -1;
+    c.savepointAt = -1;
+    c.skippable = false;
+    c.retryAfterRollback = false;
+    c.retryAfterBackoff = false;
+    c.errorClass = DBExecResult::UNKNOWN_ERROR;
+    c.error.clear();
+
+    const auto& sqls = c.task.batch.sqls;
+    PostgreSQLConnector::planBatch(sqls, c.skip, c.from, c.resume, savepointInterval, c.commands);
+    for (const auto& step : c.commands) {
+        if (!sendCommand(c, PostgreSQLConnector::stepSQL(step, sqls))) return;
+    }
+    flushPipeline(c);
+}
+
+void AsyncPgWriter::sendRollback(Connection& c) {
+    c.phase = Phase::ROLLBACK;
+    c.commands.clear();
+    c.resultCmd = 0;
+    if (!sendCommand(c, "ROLLBACK")) return;
+    flushPipeline(c);
+}
+
+void AsyncPgWriter::flushPipeline(Connection& c) {
+    if (PQpipelineSync(c.conn) != 1) {
+        failConnection(c, PQerrorMessage(c.conn));
+        return;
+    }
+    // Non-blocking: phần chưa gửi hết được flush tiếp khi socket writable
+    const int flushed = PQflush(c.conn);
+    if (flushed < 0) {
+        failConnection(c, PQerrorMessage(c.conn));
+        return;
+    }
+    watch(c, flushed == 1 ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+}
+
+void AsyncPgWriter::onSocketEvent(Connection& c, uint32_t events) {
+    if (!c.conn) return;
+    if (c.state == State::CONNECTING) {
+        pollConnect(c);
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        const int flushed = PQflush(c.conn);
+        if (flushed < 0) {
+            failConnection(c, PQerrorMessage(c.conn));
+            return;
+        }
+        if (flushed == 0) watch(c, EPOLLIN);
+    }
+
+    if (!(events & (EPOLLIN | EPOLLERR | EPOLLHUP))) return;
+
+    if (!PQconsumeInput(c.conn)) {
+        failConnection(c, PQerrorMessage(c.conn));
+        return;
+    }
+
+    // Kết quả theo thứ tự command: nullptr kết thúc một command, PGRES_PIPELINE_SYNC kết thúc pipeline.
+    // Command lỗi đầu tiên được ghi nhận, các command sau nó trả PGRES_PIPELINE_ABORTED.
+    while (c.state == State::BUSY && !PQisBusy(c.conn)) {
+        PGresult* res = PQgetResult(c.conn);
+        if (!res) {
+            if (++c.resultCmd > std::max<size_t>(c.commands.size(), 1)) {
+                failConnection(c, "pipeline protocol error");
+                return;
+            }
+            continue;
+        }
+        const ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_PIPELINE_SYNC) {
+            PQclear(res);
+            onPipelineSynced(c);
+            continue;
+        }
+        if (c.resultCmd < c.commands.size()) {
+            const auto& step = c.commands[c.resultCmd];
+            const bool isSavepoint = step.kind == PostgreSQLConnector::BatchStepKind::SAVEPOINT ||
+                                     step.kind == PostgreSQLConnector::BatchStepKind::ROLLBACK_TO_SAVEPOINT;
+            if (isSavepoint && status == PGRES_COMMAND_OK) c.savepointAt = static_cast<long>(step.index);
+        }
+        if (status == PGRES_FATAL_ERROR && !c.failed) {
+            const bool isStatement = c.resultCmd < c.commands.size() &&
+                                     c.commands[c.resultCmd].kind == PostgreSQLConnector::BatchStepKind::STATEMENT;
+            c.failed = true;
+            c.failedIndex = isStatement ? static_cast<long>(c.commands[c.resultCmd].index) : -1;
+            c.skippable = isStatement && PostgreSQLConnector::isSkippableError(res);
+            c.errorClass = PostgreSQLConnector::classifyError(res);
+            c.error = PQresultErrorMessage(res);
+        }
+        PQclear(res);
+    }
+
+    if (c.conn && PQstatus(c.conn) == CONNECTION_BAD) {
+        failConnection(c, "connection lost");
+    }
+}
+
+void AsyncPgWriter::onPipelineSynced(Connection& c) {
+    if (c.phase == Phase::APPLY) {
+        if (breaker) {
+            // Lỗi dữ liệu nghĩa là DB vẫn trả lời: breaker tính như success
+            if (c.failed) {
+                breaker->recordFailure(c.errorClass, c.error);
+            } else {
+                breaker->recordSuccess();
+            }
+        }
+        if (!c.failed) {
+            OpenSync::Logger::debug("✅ Batch executed: " + std::to_string(c.task.batch.sqls.size() - c.skipped) +
+                                    " succeeded, " + std::to_string(c.skipped) + " skipped.");
+            finishTask(c, true);
+            return;
+        }
+        // Transaction còn mở ở trạng thái aborted (COMMIT đã bị bỏ qua)
+        if (DBExceptionHelper::isTransient(c.errorClass)) {
+            // Timeout / mất kết nối phía server: rollback rồi chạy lại cả batch sau backoff, không tính là lỗi của bảng
+            c.retryAfterBackoff = true;
+            sendRollback(c);
+            return;
+        }
+        if (tolerateFailedRow(c)) {
+            if (c.savepointAt >= 0) {
+                // Chỉ chạy lại từ savepoint gần nhất, phần trước đó vẫn nằm trong transaction
+                c.from = static_cast<size_t>(c.savepointAt);
+                c.resume = true;
+                MetricsExporter::getInstance().incrementCounter("pg_savepoint_rollbacks_total");
+                sendBatch(c);
+            } else {
+                c.from = 0;
+                c.resume = false;
+                c.retryAfterRollback = true;
+                sendRollback(c);
+            }
+            return;
+        }
+
+        if (c.failedIndex >= 0) {
+            OpenSync::Logger::error("🔎 PostgreSQL error message: " + c.error + " | SQL: " +
+                                    c.task.batch.sqls[static_cast<size_t>(c.failedIndex)]);
+        } else {
+            OpenSync::Logger::error("🔎 PostgreSQL error message: " + c.error);
+        }
+        sendRollback(c);
+        return;
+    }
+
+    // Sau ROLLBACK: chạy lại batch không có statement lỗi, giữ task chờ backoff, hoặc kết thúc task lỗi
+    if (c.retryAfterBackoff) {
+        holdForRetry(c, c.errorClass, c.error);
+        return;
+    }
+    if (c.retryAfterRollback) {
+        sendBatch(c);
+        return;
+    }
+
+    // Ghi lại chính task này (task sau của connection không vượt lên) tới ngưỡng quarantine:
+    // khi đó task là dòng đầu của file hold và được coi như đã xử lý
+    switch (TableHealthRegistry::getInstance().recordFailure(c.task.tableKey, c.task.batch)) {
+        case TableHealthRegistry::FailureAction::HELD:
+            finishTask(c, true);
+            break;
+        case TableHealthRegistry::FailureAction::RETRY:
+            scheduleRestart(c, CircuitBreaker::backoff(c.attempt++, retry.baseDelayMs, retry.maxDelayMs));
+            break;
+        case TableHealthRegistry::FailureAction::GIVE_UP:
+            finishTask(c, false);
+            break;
+    }
+}
+
+// Statement lỗi bỏ qua được (duplicate key / not null) hoặc lỗi dữ liệu đã ghi dead-letter → đánh dấu skip.
+// Pipeline đã chỉ ra đúng statement lỗi nên không cần chia đôi batch như WriteDataToDB.
+bool AsyncPgWriter::tolerateFailedRow(Connection& c) {
+    if (c.failedIndex < 0) return false;
+    const auto index = static_cast<size_t>(c.failedIndex);
+    const std::string& sql = c.task.batch.sqls[index];
+
+    if (c.skippable) {
+        if (c.error.find("duplicate key") != std::string::npos) {
+            OpenSync::Logger::warn("⚠️ Duplicate key violation detected. Skipping: " + sql);
+        } else {
+            OpenSync::Logger::warn("⚠️ Not null violation detected. Skipping: " + sql);
+        }
+    } else {
+        if (DBExceptionHelper::isTransient(c.errorClass) || c.errorClass == DBExecResult::SCHEMA_MISMATCH) return false;
+        const RowOrigin origin = index < c.task.batch.origins.size() ? c.task.batch.origins[index] : RowOrigin{};
+        if (!DeadLetterStore::getInstance().write(c.task.tableKey, origin, sql, c.errorClass, c.error)) return false;
+    }
+    c.skip[index] = 1;
+    ++c.skipped;
+    return true;
+}
+
+void AsyncPgWriter::finishTask(Connection& c, bool success) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - c.startedAt;
+    c.state = State::IDLE;
+    c.attempt = 0;
+    c.restart = false;
+    c.pending = false;
+
+    finishApplyTask(consumer, DB_TYPE, c.task, success, elapsed.count());
+    c.task = ApplyTask();
+}
+
+// ----- loop -----
+
+bool AsyncPgWriter::drained() const {
+    // Connection chết / task đang chờ chạy lại sau lỗi tạm thời / task chờ breaker đóng không chặn shutdown:
+    // task đó không commit offset → Kafka giao lại
+    const bool dbBlocked = breaker && breaker->state() != CircuitBreaker::State::CLOSED;
+    return std::none_of(connections.begin(), connections.end(), [dbBlocked](const Connection& c) {
+        return c.state == State::BUSY || (c.pending && !c.restart && !dbBlocked && c.state != State::DISCONNECTED);
+    });
+}
+
+void AsyncPgWriter::reportMetrics() {
+    size_t busy = 0, connected = 0;
+    for (const auto& c : connections) {
+        if (c.state == State::BUSY) ++busy;
+        if (c.state == State::BUSY || c.state == State::IDLE) ++connected;
+    }
+    auto& metrics = MetricsExporter::getInstance();
+    const std::string loop = std::to_string(loopIndex);
+    metrics.setGauge("pg_async_busy_connections", static_cast<double>(busy), {{"loop", loop}});
+    metrics.setGauge("pg_async_connected", static_cast<double>(connected), {{"loop", loop}});
+}
+
+void AsyncPgWriter::run(std::atomic<bool>& shutdown) {
+    if (epfd < 0) return;
+
+    OpenSync::Logger::info("🔁 AsyncPgWriter loop " + std::to_string(loopIndex) + " serving " +
+                           std::to_string(connections.size()) + " PostgreSQL connections");
+
+    epoll_event events[MAX_EVENTS];
+    int idleWaitMs = 1;
+
+    for (;;) {
+        const auto now = std::chrono::steady_clock::now();
+        const bool stopping = shutdown.load();
+        bool progress = false;
+        bool waiting = false;
+
+        for (auto& c : connections) {
+            // Breaker OPEN: không connect, thread reconnect nền của WriteDataToDB thử DB thay cho mọi connection
+            if (c.state == State::DISCONNECTED && !stopping && now >= c.retryAt &&
+                (!breaker || breaker->state() != CircuitBreaker::State::OPEN)) {
+                startConnect(c);
+            }
+            if (tryStartTask(c)) progress = true;
+            if (c.pending) waiting = true;
+        }
+
+        if (stopping && !progress && drained()) break;
+
+        // Queue của router không có fd để epoll → khi rảnh poll queue với timeout tăng dần (tối đa 20 ms)
+        int timeoutMs = 0;
+        if (!progress) {
+            timeoutMs = waiting ? 1 : idleWaitMs;
+            idleWaitMs = std::min(idleWaitMs * 2, MAX_IDLE_WAIT_MS);
+        } else {
+            idleWaitMs = 1;
+        }
+
+        const int n = epoll_wait(epfd, events, MAX_EVENTS, timeoutMs);
+        if (n < 0 && errno != EINTR) {
+            OpenSync::Logger::error("❌ AsyncPgWriter: epoll_wait failed: " + std::string(std::strerror(errno)));
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            onSocketEvent(connections[events[i].data.u64], events[i].events);
+        }
+        if (n > 0) idleWaitMs = 1;
+
+        if (now - lastMetrics >= std::chrono::seconds(1)) {
+            reportMetrics();
+            lastMetrics = now;
+        }
+    }
+
+    OpenSync::Logger::info("🛑 AsyncPgWriter loop " + std::to_string(loopIndex) + " stopped");
+}
+
+void asyncPgWriterThread(const std::string& connInfo, KafkaConsumer& consumer, size_t loopIndex, size_t loopCount,
+                         size_t savepointInterval, const WriteDataToDB::RetryOptions& retry,
+                         std::shared_ptr<CircuitBreaker> breaker, std::atomic<bool>& shutdown) {
+    std::vector<size_t> queueIndexes;
+    const size_t queues = ApplyLaneRouter::getInstance().writerCount();
+    for (size_t i = loopIndex; i < queues; i += std::max<size_t>(loopCount, 1)) queueIndexes.push_back(i);
+
+    AsyncPgWriter writer(connInfo, consumer, loopIndex, std::move(queueIndexes), savepointInterval, retry,
+                         std::move(breaker));
+    writer.run(shutdown);
+}
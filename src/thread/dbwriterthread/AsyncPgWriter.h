@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+#include "ApplyLaneRouter.h"
+#include "../../db/DBException.h"
+#include "../../db/postgresql/PostgreSQLConnector.h"
+#include "../../writer/WriteDataToDB.h"
+
+class KafkaConsumer;
+
+// PostgreSQL writer kiểu event loop: một thread giữ nhiều connection non-blocking
+// (PQconnectStart / PQsendQueryParams / PQconsumeInput, epoll trên PQsocket).
+// Mỗi connection phục vụ đúng một queue của ApplyLaneRouter và chạy task của queue đó tuần tự
+// (pipeline mode: BEGIN, mọi SQL, SAVEPOINT mỗi savepointInterval SQL, COMMIT, sync trong một round trip)
+// → thứ tự theo lane và write-set giống dbWriterThread,
+// nhưng 32+ connection chỉ cần 1-2 thread thay vì 32 thread block trong PQexec.
+// Lỗi tạm thời (mất connection, timeout...) không kết thúc task: task được giữ trên connection và chạy lại
+// cả batch sau backoff (db_retry.*), offset chưa commit → không mất row khi DB failover.
+// Lỗi connection / lỗi tạm thời được ghi vào circuit breaker "postgresql" của WriteDataToDB: breaker OPEN thì
+// không connect / bắt đầu task mới (consumer pause), chỉ thread reconnect nền thử DB; HALF_OPEN cho một task ghi thử.
+class AsyncPgWriter {
+public:
+    AsyncPgWriter(std::string connInfo, KafkaConsumer& consumer, size_t loopIndex, std::vector<size_t> queueIndexes,
+                  size_t savepointInterval, const WriteDataToDB::RetryOptions& retry,
+                  std::shared_ptr<CircuitBreaker> breaker);
+    ~AsyncPgWriter();
+
+    AsyncPgWriter(const AsyncPgWriter&) = delete;
+    AsyncPgWriter& operator=(const AsyncPgWriter&) = delete;
+
+    // Chạy tới khi shutdown và không còn task nào đang ghi / chờ trên các connection còn sống
+    void run(std::atomic<bool>& shutdown);
+
+private:
+    enum class State { DISCONNECTED, CONNECTING, IDLE, BUSY };
+    enum class Phase { APPLY, ROLLBACK };
+
+    struct Connection {
+        size_t slot = 0;            // index trong connections (epoll data)
+        size_t queueIndex = 0;      // queue của ApplyLaneRouter
+        PGconn* conn = nullptr;
+        int fd = -1;
+        uint32_t events = 0;        // events đang đăng ký với epoll (0 = chưa đăng ký)
+        State state = State::DISCONNECTED;
+        std::chrono::steady_clock::time_point retryAt{};     // lần connect kế tiếp
+        int connectFailures = 0;
+
+        ApplyTask task;
+        bool pending = false;       // đã lấy task ra khỏi queue nhưng write-set chưa sẵn sàng / chờ chạy lại
+        bool restart = false;       // task bị lỗi tạm thời, chạy lại cả batch khi tới restartAt
+        int attempt = 0;            // số lần lỗi tạm thời của task hiện tại
+        std::chrono::steady_clock::time_point restartAt{};
+        Phase phase = Phase::APPLY;
+        std::vector<uint8_t> skip;  // statement bị bỏ qua (duplicate key / not null) khi chạy lại batch
+        size_t skipped = 0;
+        std::vector<PostgreSQLConnector::BatchStep> commands;   // step trong pipeline hiện tại (ROLLBACK: rỗng)
+        size_t resultCmd = 0;       // command đang nhận kết quả
+        bool failed = false;
+        long failedIndex = -1;
+        long savepointAt = -1;      // savepoint cuối cùng đặt thành công trước lỗi
+        size_t from = 0;            // lần chạy hiện tại bắt đầu từ statement này
+        bool resume = false;        // bắt đầu bằng ROLLBACK TO SAVEPOINT thay vì BEGIN
+        bool retryAfterRollback = false;
+        bool retryAfterBackoff = false;     // lỗi tạm thời: sau ROLLBACK giữ task để chạy lại
+        bool skippable = false;
+        DBExecResult errorClass = DBExecResult::UNKNOWN_ERROR;
+        std::string error;
+        std::chrono::steady_clock::time_point startedAt{};
+    };
+
+    static constexpr int MAX_EVENTS = 64;
+    static constexpr int MAX_IDLE_WAIT_MS = 20;
+
+    void startConnect(Connection& c);
+    void pollConnect(Connection& c);
+    void closeConnection(Connection& c);
+    void failConnection(Connection& c, const std::string& reason);
+    void watch(Connection& c, uint32_t events);
+
+    // Breaker cho phép ghi (CLOSED, hoặc nhận lượt ghi thử HALF_OPEN)
+    bool admitWrite();
+    bool tryStartTask(Connection& c);
+    void beginTask(Connection& c);
+    void startBatch(Connection& c);
+    void restartTask(Connection& c);
+    // Lỗi tạm thời của task đang ghi: giữ task để chạy lại sau backoff (hết maxAttempts → task lỗi)
+    void holdForRetry(Connection& c, DBExecResult errorClass, const std::string& reason);
+    void scheduleRestart(Connection& c, std::chrono::milliseconds delay);
+    bool sendCommand(Connection& c, const char* sql);
+    void sendBatch(Connection& c);
+    void sendRollback(Connection& c);
+    void flushPipeline(Connection& c);
+    void onSocketEvent(Connection& c, uint32_t events);
+    void onPipelineSynced(Connection& c);
+    bool tolerateFailedRow(Connection& c);
+    void finishTask(Connection& c, bool success);
+
+    bool drained() const;
+    void reportMetrics();
+
+    std::string connInfo;
+    KafkaConsumer& consumer;
+    size_t loopIndex;
+    size_t savepointInterval;
+    WriteDataToDB::RetryOptions retry;
+    std::shared_ptr<CircuitBreaker> breaker;
+    int epfd = -1;
+    std::vector<Connection> connections;
+    std::chrono::steady_clock::time_point lastMetrics{};
+};
+
+// Event loop loopIndex trên tổng loopCount loop: phục vụ các queue i với i % loopCount == loopIndex
+void asyncPgWriterThread(const std::string& connInfo, KafkaConsumer& consumer, size_t loopIndex, size_t loopCount,
+                         size_t savepointInterval, const WriteDataToDB::RetryOptions& retry,
+                         std::shared_ptr<CircuitBreaker> breaker, std::atomic<bool>& shutdown);
@@ -1,256 +1,157 @@
 #include "DBWriterThread.h"
-#include "PerTableMutexManager.h"
-#include "../../utils/MutexRegistry.h"
+#include "ApplyLaneRouter.h"
+#include "../../common/TableBatchPool.h"
+#include "../../common/MemoryAccountant.h"
 #include "../../metrics/MetricsExporter.h"
 #include "../../logger/Logger.h"
 #include "../../writer/WriteDataToDB.h"
+#include "../../writer/TableHealthRegistry.h"
 #include "../../kafka/KafkaConsumer.h"
-#include "../../common/Queues.h"
 #include <chrono>
 #include <sstream>
 #include <atomic>
 
-static constexpr int maxIdleSeconds = 60; // Timeout để flush batch
-static PerTableMutexManager mutexManager;
-
-
-void dbWriterThread(WriteDataToDB& writeData, KafkaConsumer& consumer, const std::string& dbType, std::atomic<bool>& shouldShutdown) {
-    while (!shouldShutdown) {
-        std::tuple<std::string, TableBatch> item;
-
-        {
-            std::stringstream ss;
-            ss << "Waiting for data in dbWriteQueue...";
-            OpenSync::Logger::debug(ss.str());
+static constexpr int maxIdleSeconds = 60; // Timeout chờ task
+
+// Ghi một lane của batch; lane cuối cùng hoàn thành sẽ commit (hoặc bỏ) Kafka messages của cả batch
+static void applyTask(WriteDataToDB& writeData, KafkaConsumer& consumer, const std::string& dbType, ApplyTask& task) {
+    // Chờ các task trước có write-set giao nhau (row cùng key / row cha theo FK) ghi xong
+    if (task.ticket) WriteSetScheduler::getInstance().waitForPredecessors(*task.ticket);
+
+    MetricsExporter::getInstance().incrementGauge("active_tables", task.tableKey);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Bảng đang quarantine: batch ra file hold, writer rảnh cho bảng khác
+    DBExecResult errorClass = DBExecResult::SUCCESS;
+    bool success = task.batch.sqls.empty() || TableHealthRegistry::getInstance().divert(task.tableKey, task.batch) ||
+                   writeData.writeBatchToDB(dbType, task.batch.sqls, task.tableKey, &errorClass);
+    // Lỗi do dữ liệu: cô lập row lỗi vào dead-letter thay vì bỏ cả batch
+    if (!success) success = writeData.isolateFailedRows(dbType, task.batch, task.tableKey, errorClass);
+
+    // Ghi lại chính batch này tại chỗ (batch sau của bảng không vượt lên) tới khi thành công; tới ngưỡng
+    // quarantine thì batch này là dòng đầu của file hold và được coi như đã xử lý
+    const auto& retry = writeData.getRetryOptions();
+    for (int attempt = 0; !success; ++attempt) {
+        const auto action = TableHealthRegistry::getInstance().recordFailure(task.tableKey, task.batch);
+        if (action == TableHealthRegistry::FailureAction::HELD) {
+            success = true;
+            break;
         }
-        bool hasData = dbWriteQueue.try_pop(item, std::chrono::seconds(maxIdleSeconds));
-        if (!hasData) {
-            std::stringstream ss;
-            ss << "No new data in queue after " << maxIdleSeconds << " seconds, flushing remaining batches...";
-            OpenSync::Logger::debug(ss.str());
-            while (dbWriteQueue.try_pop(item)) {
-                auto& [tableKey, batch] = item;
-                {
-                    std::stringstream ss;
-                    ss << "Flushing batch for table: " << tableKey;
-                    OpenSync::Logger::debug(ss.str());
-                }
+        if (action == TableHealthRegistry::FailureAction::GIVE_UP ||
+            !writeData.waitBeforeRetry(CircuitBreaker::backoff(attempt, retry.baseDelayMs, retry.maxDelayMs))) {
+            break;
+        }
+        success = writeData.writeBatchToDB(dbType, task.batch.sqls, task.tableKey, &errorClass) ||
+                  writeData.isolateFailedRows(dbType, task.batch, task.tableKey, errorClass);
+    }
 
-                //auto tableMtx = getTableMutex(tableKey);
-                //std::lock_guard<std::mutex> lock(*tableMtx);
-		
-		std::mutex& tableMtx = mutexManager.getMutex(tableKey);
-		std::lock_guard<std::mutex> lock(tableMtx);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
 
+    finishApplyTask(consumer, dbType, task, success, elapsed.count());
+}
 
-                std::atomic<int> totalRowsWritten{0};
-                std::atomic<int> totalBatches{0};
-                auto startTime = std::chrono::steady_clock::now();
+void finishApplyTask(KafkaConsumer& consumer, const std::string& dbType, ApplyTask& task, bool success, double elapsedMs) {
+    const std::string& tableKey = task.tableKey;
+    auto& batch = task.batch;
 
-                MetricsExporter::getInstance().incrementGauge("active_tables", tableKey);
-                auto start = std::chrono::high_resolution_clock::now();
+    MetricsExporter::getInstance().setMetric("db_write_time_ms", elapsedMs, { {"table", tableKey} });
+    MetricsExporter::getInstance().setMetric("db_batch_size", batch.sqls.size(), { {"table", tableKey} });
 
-                bool success = writeData.writeBatchToDB(dbType, batch.sqls, tableKey);
+    std::string status = success ? "success" : "failure";
+    MetricsExporter::getInstance().incrementCounter("db_batch_status", { {"table", tableKey}, {"status", status} });
 
-                auto end = std::chrono::high_resolution_clock::now();
-                std::chrono::duration<double, std::milli> elapsed = end - start;
+    if (success) {
+        MetricsExporter::getInstance().incrementCounter("table_throughput_rows_total", {{"table", tableKey}}, batch.sqls.size());
 
-                MetricsExporter::getInstance().setMetric("db_write_time_ms", elapsed.count(), { {"table", tableKey} });
-                MetricsExporter::getInstance().setMetric("db_batch_size", batch.sqls.size(), { {"table", tableKey} });
+        const double totalRowsWritten = static_cast<double>(batch.sqls.size());
+        const auto elapsedSec = static_cast<long long>(elapsedMs / 1000.0);
 
-                std::string status = success ? "success" : "failure";
-                MetricsExporter::getInstance().incrementCounter("db_batch_status", { {"table", tableKey}, {"status", status} });
+        if (elapsedSec > 0) {
+            MetricsExporter::getInstance().setMetric("total_rows_written", totalRowsWritten);
+            MetricsExporter::getInstance().setMetric("rows_per_sec", totalRowsWritten / elapsedSec);
+            MetricsExporter::getInstance().setMetric("avg_rows_per_batch", totalRowsWritten);
+        }
+    } else {
+        MetricsExporter::getInstance().incrementCounter("table_rows_rollback", {{"table", tableKey}}, batch.sqls.size());
+    }
 
-                if (success) {
-                    for (auto* msg : batch.messages) {
-                        consumer.commitOffset(msg);
-                        rd_kafka_message_destroy(msg);
-                    }
+    if (task.ticket) WriteSetScheduler::getInstance().complete(*task.ticket);
+    ApplyLaneRouter::getInstance().taskDone(task, elapsedMs);
+    if (success && !batch.sqls.empty()) TableHealthRegistry::getInstance().recordSuccess(tableKey);
 
-                    MetricsExporter::getInstance().incrementCounter("table_throughput_rows_total", {{"table", tableKey}}, batch.sqls.size());
+    auto& accountant = MemoryAccountant::getInstance();
+    if (task.completion && task.completion->finish(success)) {
+        const bool commit = !task.completion->failed.load(std::memory_order_relaxed);
+        // Batch lỗi không commit: watermark của partition dừng ở đây, restart thì Kafka giao lại từ batch này
+        if (!commit) {
+            OpenSync::Logger::warn("⏸️ Batch of " + tableKey + " failed, Kafka commit of its partitions held at this batch");
+        }
+        for (auto* msg : task.completion->messages) {
+            accountant.releaseMessage(msg, commit, [&consumer](rd_kafka_message_t* m) { consumer.commitOffset(m); });
+        }
+        task.completion->messages.clear();
+        // Message đã giải phóng khi batch bị spill xuống đĩa
+        if (commit) {
+            for (const auto& ref : task.completion->offsets) consumer.commitOffset(ref.topic, ref.partition, ref.offset);
+        }
+        task.completion->offsets.clear();
+    }
+    accountant.release(MemoryAccountant::APPLY_QUEUE, task.bytes);
 
-                    totalRowsWritten += batch.sqls.size();
-                    totalBatches++;
+    MetricsExporter::getInstance().decrementGauge("active_tables", tableKey);
 
-                    auto now = std::chrono::steady_clock::now();
-                    auto elapsedSec = std::chrono::duration_cast<std::chrono::seconds>(now - startTime).count();
+    std::stringstream ss;
+    ss << "[Thread " << std::this_thread::get_id() << "] "
+       << (success ? "✅ Successfully" : "❌ Failed to")
+       << " wrote " << batch.sqls.size() << " queries to " << dbType
+       << " (table: " << tableKey << ", lane: " << task.lane << ") in " << elapsedMs << " ms.";
+    success ? OpenSync::Logger::info(ss.str()) : OpenSync::Logger::error(ss.str());
 
-                    if (elapsedSec > 0) {
-                        double throughput = static_cast<double>(totalRowsWritten) / elapsedSec;
-                        double avgBatch = static_cast<double>(totalRowsWritten) / totalBatches;
+    // Vector + SQL buffer quay lại cho worker dùng tiếp
+    TableBatchPool::getInstance().releaseBatch(std::move(task.batch));
+}
 
-                        MetricsExporter::getInstance().setMetric("total_rows_written", totalRowsWritten);
-                        MetricsExporter::getInstance().setMetric("rows_per_sec", throughput);
-                        MetricsExporter::getInstance().setMetric("avg_rows_per_batch", avgBatch);
-                    }
-                } else {
-                    MetricsExporter::getInstance().incrementCounter("table_rows_rollback", {{"table", tableKey}}, batch.sqls.size());
-                    for (auto* msg : batch.messages) {
-                        rd_kafka_message_destroy(msg);
-                    }
-                }
+void dbWriterThread(WriteDataToDB& writeData, KafkaConsumer& consumer, const std::string& dbType,
+                    size_t writerIndex, std::atomic<bool>& shouldShutdown) {
+    auto& router = ApplyLaneRouter::getInstance();
 
-                batch.messages.clear();
-                MetricsExporter::getInstance().decrementGauge("active_tables", tableKey);
+    while (!shouldShutdown) {
+        ApplyTask task;
 
-                std::stringstream ss;
-                ss << "[Thread " << std::this_thread::get_id() << "] "
-                   << (success ? "✅ Successfully" : "❌ Failed to")
-                   << " wrote " << batch.sqls.size() << " queries to " << dbType
-                   << " (table: " << tableKey << ") in " << elapsed.count() << " ms.";
-                success ? OpenSync::Logger::info(ss.str()) : OpenSync::Logger::error(ss.str());
-            }
+        {
+            std::stringstream ss;
+            ss << "Waiting for data in apply lane queue " << writerIndex << "...";
+            OpenSync::Logger::debug(ss.str());
+        }
+        if (!router.pop(writerIndex, task, std::chrono::seconds(maxIdleSeconds))) {
+            std::stringstream ss;
+            ss << "No new data in apply lane queue " << writerIndex << " after " << maxIdleSeconds << " seconds";
+            OpenSync::Logger::debug(ss.str());
             continue;
         }
 
-        auto& [tableKey, batch] = item;
         {
             std::stringstream ss;
-            ss << "Processing batch for table: " << tableKey;
+            ss << "Processing batch for table: " << task.tableKey << " (lane " << task.lane << ")";
             OpenSync::Logger::debug(ss.str());
         }
-
-        //auto tableMtx = getTableMutex(tableKey);
-        //std::lock_guard<std::mutex> lock(*tableMtx);
-	
-	std::mutex& tableMtx = mutexManager.getMutex(tableKey);
-	std::lock_guard<std::mutex> lock(tableMtx);
-
-        std::atomic<int> totalRowsWritten{0};
-        std::atomic<int> totalBatches{0};
-        auto startTime = std::chrono::steady_clock::now();
-
-        MetricsExporter::getInstance().incrementGauge("active_tables", tableKey);
-        auto start = std::chrono::high_resolution_clock::now();
-
-        bool success = writeData.writeBatchToDB(dbType, batch.sqls, tableKey);
-
-        auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> elapsed = end - start;
-
-        MetricsExporter::getInstance().setMetric("db_write_time_ms", elapsed.count(), { {"table", tableKey} });
-        MetricsExporter::getInstance().setMetric("db_batch_size", batch.sqls.size(), { {"table", tableKey} });
-
-        std::string status = success ? "success" : "failure";
-        MetricsExporter::getInstance().incrementCounter("db_batch_status", { {"table", tableKey}, {"status", status} });
-
-        if (success) {
-            for (auto* msg : batch.messages) {
-                consumer.commitOffset(msg);
-                rd_kafka_message_destroy(msg);
-            }
-
-            MetricsExporter::getInstance().incrementCounter("table_throughput_rows_total", {{"table", tableKey}}, batch.sqls.size());
-
-            totalRowsWritten += batch.sqls.size();
-            totalBatches++;
-
-            auto now = std::chrono::steady_clock::now();
-            auto elapsedSec = std::chrono::duration_cast<std::chrono::seconds>(now - startTime).count();
-
-            if (elapsedSec > 0) {
-                double throughput = static_cast<double>(totalRowsWritten) / elapsedSec;
-                double avgBatch = static_cast<double>(totalRowsWritten) / totalBatches;
-
-                MetricsExporter::getInstance().setMetric("total_rows_written", totalRowsWritten);
-                MetricsExporter::getInstance().setMetric("rows_per_sec", throughput);
-                MetricsExporter::getInstance().setMetric("avg_rows_per_batch", avgBatch);
-            }
-        } else {
-            MetricsExporter::getInstance().incrementCounter("table_rows_rollback", {{"table", tableKey}}, batch.sqls.size());
-            for (auto* msg : batch.messages) {
-                rd_kafka_message_destroy(msg);
-            }
-        }
-
-        batch.messages.clear();
-        MetricsExporter::getInstance().decrementGauge("active_tables", tableKey);
-
-        std::stringstream ss;
-        ss << "[Thread " << std::this_thread::get_id() << "] "
-           << (success ? "✅ Successfully" : "❌ Failed to")
-           << " wrote " << batch.sqls.size() << " queries to " << dbType
-           << " (table: " << tableKey << ") in " << elapsed.count() << " ms.";
-        success ? OpenSync::Logger::info(ss.str()) : OpenSync::Logger::error(ss.str());
+        applyTask(writeData, consumer, dbType, task);
     }
 
     // Flush tất cả batch khi shutdown
     {
         std::stringstream ss;
-        ss << "Shutting down DB writer, flushing all remaining batches...";
+        ss << "Shutting down DB writer " << writerIndex << ", flushing all remaining batches...";
         OpenSync::Logger::info(ss.str());
     }
-    std::tuple<std::string, TableBatch> item;
-    while (dbWriteQueue.try_pop(item)) {
-        auto& [tableKey, batch] = item;
+    ApplyTask task;
+    while (router.tryPop(writerIndex, task)) {
         {
             std::stringstream ss;
-            ss << "Flushing batch for table: " << tableKey;
+            ss << "Flushing batch for table: " << task.tableKey << " (lane " << task.lane << ")";
             OpenSync::Logger::debug(ss.str());
         }
-
-        //auto tableMtx = getTableMutex(tableKey);
-        //std::lock_guard<std::mutex> lock(*tableMtx);
-
-	// Mới:
-	std::mutex& tableMtx = mutexManager.getMutex(tableKey);
-	std::lock_guard<std::mutex> lock(tableMtx);
-
-        std::atomic<int> totalRowsWritten{0};
-        std::atomic<int> totalBatches{0};
-        auto startTime = std::chrono::steady_clock::now();
-
-        MetricsExporter::getInstance().incrementGauge("active_tables", tableKey);
-        auto start = std::chrono::high_resolution_clock::now();
-
-        bool success = writeData.writeBatchToDB(dbType, batch.sqls, tableKey);
-
-        auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> elapsed = end - start;
-
-        MetricsExporter::getInstance().setMetric("db_write_time_ms", elapsed.count(), { {"table", tableKey} });
-        MetricsExporter::getInstance().setMetric("db_batch_size", batch.sqls.size(), { {"table", tableKey} });
-
-        std::string status = success ? "success" : "failure";
-        MetricsExporter::getInstance().incrementCounter("db_batch_status", { {"table", tableKey}, {"status", status} });
-
-        if (success) {
-            for (auto* msg : batch.messages) {
-                consumer.commitOffset(msg);
-                rd_kafka_message_destroy(msg);
-            }
-
-            MetricsExporter::getInstance().incrementCounter("table_throughput_rows_total", {{"table", tableKey}}, batch.sqls.size());
-
-            totalRowsWritten += batch.sqls.size();
-            totalBatches++;
-
-            auto now = std::chrono::steady_clock::now();
-            auto elapsedSec = std::chrono::duration_cast<std::chrono::seconds>(now - startTime).count();
-
-            if (elapsedSec > 0) {
-                double throughput = static_cast<double>(totalRowsWritten) / elapsedSec;
-                double avgBatch = static_cast<double>(totalRowsWritten) / totalBatches;
-
-                MetricsExporter::getInstance().setMetric("total_rows_written", totalRowsWritten);
-                MetricsExporter::getInstance().setMetric("rows_per_sec", throughput);
-                MetricsExporter::getInstance().setMetric("avg_rows_per_batch", avgBatch);
-            }
-        } else {
-            MetricsExporter::getInstance().incrementCounter("table_rows_rollback", {{"table", tableKey}}, batch.sqls.size());
-            for (auto* msg : batch.messages) {
-                rd_kafka_message_destroy(msg);
-            }
-        }
-
-        batch.messages.clear();
-        MetricsExporter::getInstance().decrementGauge("active_tables", tableKey);
-
-        std::stringstream ss;
-        ss << "[Thread " << std::this_thread::get_id() << "] "
-           << (success ? "✅ Successfully" : "❌ Failed to")
-           << " wrote " << batch.sqls.size() << " queries to " << dbType
-           << " (table: " << tableKey << ") in " << elapsed.count() << " ms.";
-        success ? OpenSync::Logger::info(ss.str()) : OpenSync::Logger::error(ss.str());
+        applyTask(writeData, consumer, dbType, task);
     }
 }
@@ -4,9 +4,13 @@
 #include "KafkaConsumer.h"
 #include "../writer/WriteDataToDB.h"
 #include "TableBatch.h"
-#include "ThreadSafeQueue.h"
-
-extern ThreadSafeQueue<std::tuple<std::string, TableBatch>> dbWriteQueue;
+#include "ApplyLaneRouter.h"
 
 //void dbWriterThread(WriteDataToDB& writeData, KafkaConsumer& consumer, const std::string& dbType);
-void dbWriterThread(WriteDataToDB& writeData, KafkaConsumer& consumer, const std::string& dbType, std::atomic<bool>& shutdown);
\ No newline at end of file
+// writerIndex: queue (apply lane) mà writer này phục vụ, xem ApplyLaneRouter
+void dbWriterThread(WriteDataToDB& writeData, KafkaConsumer& consumer, const std::string& dbType,
+                    size_t writerIndex, std::atomic<bool>& shutdown);
+
+// Sau khi ghi xong một task: metrics, write-set ticket, commit Kafka offset (lane cuối), trả batch về pool.
+// Dùng chung cho dbWriterThread và AsyncPgWriter.
+void finishApplyTask(KafkaConsumer& consumer, const std::string& dbType, ApplyTask& task, bool success, double elapsedMs);
@@ -0,0 +1,72 @@
+#include "WriteSetScheduler.h"
+#include "../../common/RowKeyHash.h"
+#include "../../metrics/MetricsExporter.h"
+#include <algorithm>
+
+WriteSetScheduler& WriteSetScheduler::getInstance() {
+    static WriteSetScheduler instance;
+    return instance;
+}
+
+std::shared_ptr<ApplyTicket> WriteSetScheduler::registerWriteSet(const std::vector<uint64_t>& writeSet) {
+    auto ticket = std::make_shared<ApplyTicket>();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    ticket->seq = nextSeq++;
+
+    for (uint64_t key : writeSet) {
+        if (key == RowKeyHash::UNKNOWN) continue;
+        auto& last = lastWriter[key];
+        if (last && last != ticket && !last->done.load(std::memory_order_acquire) &&
+            std::find(ticket->waitFor.begin(), ticket->waitFor.end(), last) == ticket->waitFor.end()) {
+            ticket->waitFor.push_back(last);
+        }
+        last = ticket;
+    }
+
+    if (lastWriter.size() >= sweepThreshold) sweepLocked();
+    return ticket;
+}
+
+void WriteSetScheduler::sweepLocked() {
+    for (auto it = lastWriter.begin(); it != lastWriter.end();) {
+        if (it->second->done.load(std::memory_order_acquire)) {
+            it = lastWriter.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    sweepThreshold = std::max(MIN_SWEEP_THRESHOLD, lastWriter.size() * 2);
+    MetricsExporter::getInstance().setGauge("writeset_tracked_keys", static_cast<double>(lastWriter.size()), {});
+}
+
+bool WriteSetScheduler::isReady(const ApplyTicket& ticket) const {
+    return std::all_of(ticket.waitFor.begin(), ticket.waitFor.end(),
+                       [](const std::shared_ptr<ApplyTicket>& t) { return t->done.load(std::memory_order_acquire); });
+}
+
+void WriteSetScheduler::waitForPredecessors(const ApplyTicket& ticket) {
+    if (ticket.waitFor.empty()) return;
+
+    auto ready = [this, &ticket] { return isReady(ticket); };
+    if (ready()) return;
+
+    MetricsExporter::getInstance().incrementCounter("writeset_conflict_waits_total");
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, ready);
+}
+
+void WriteSetScheduler::complete(ApplyTicket& ticket) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ticket.done.store(true, std::memory_order_release);
+        // Không giữ chuỗi shared_ptr tới các task cũ
+        ticket.waitFor.clear();
+    }
+    cv.notify_all();
+}
+
+size_t WriteSetScheduler::trackedKeys() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return lastWriter.size();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Một task (lane của batch) trong scheduler: chỉ được apply sau khi mọi task trước nó
+// có write-set giao nhau đã xong.
+struct ApplyTicket {
+    uint64_t seq = 0;
+    std::atomic<bool> done{false};
+    std::vector<std::shared_ptr<ApplyTicket>> waitFor;
+};
+
+// Write-set conflict detection kiểu MySQL writeset replication:
+// write-set = RowKeyHash các row ghi + RowKeyHash các row cha theo FK (dependencyKeys).
+// Task không giao nhau chạy song song trên các DB writer, task giao nhau chờ task trước theo seq.
+class WriteSetScheduler {
+public:
+    static WriteSetScheduler& getInstance();
+
+    void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Gán seq và danh sách task phải chờ. Caller phải register và push vào queue theo cùng một thứ tự
+    // (ApplyLaneRouter giữ dispatch lock) → task chờ luôn đã nằm trong queue trước → không deadlock.
+    std::shared_ptr<ApplyTicket> registerWriteSet(const std::vector<uint64_t>& writeSet);
+
+    // Không block: true nếu mọi task phải chờ đã xong (event loop tự poll lại)
+    bool isReady(const ApplyTicket& ticket) const;
+    void waitForPredecessors(const ApplyTicket& ticket);
+    void complete(ApplyTicket& ticket);
+
+    size_t trackedKeys() const;
+
+private:
+    WriteSetScheduler() = default;
+
+    void sweepLocked();
+
+    static constexpr size_t MIN_SWEEP_THRESHOLD = 65536;
+
+    std::atomic<bool> enabled{false};
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::unordered_map<uint64_t, std::shared_ptr<ApplyTicket>> lastWriter;
+    uint64_t nextSeq = 1;
+    size_t sweepThreshold = MIN_SWEEP_THRESHOLD;
+};
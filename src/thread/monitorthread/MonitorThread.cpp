@@ -3,15 +3,13 @@
 #include "../../utils/MemoryUtils.h"
 #include "../../logger/Logger.h"
 #include "../../metrics/MetricsExporter.h"
-#include "../ThreadSafeQueue.h"
+#include "../../common/Queues.h"
 #include "../../common/TableBatch.h"
 #include "../../writer/WriteDataToDB.h"
+#include "../dbwriterthread/ApplyLaneRouter.h"
 #include <thread>
 #include <chrono>
-#include <malloc.h>
 
-extern ThreadSafeQueue<std::tuple<std::string, int, int64_t, int64_t, rd_kafka_message_t*>> kafkaMessageQueue;
-extern ThreadSafeQueue<std::tuple<std::string, TableBatch>> dbWriteQueue;
 
 void startMemoryMonitorThread(std::atomic<bool>& stopFlag) {
     std::thread([&stopFlag]() {
@@ -30,7 +28,7 @@ void startMetricsMonitorThread(std::atomic<bool>& stopFlag) {
         OpenSync::Logger::info("📈 Starting Metrics Monitor Thread...");
         while (!stopFlag.load()) {
             size_t kafkaSize = kafkaMessageQueue.size();
-            size_t dbQueueSize = dbWriteQueue.size();
+            size_t dbQueueSize = ApplyLaneRouter::getInstance().queuedTasks();
 
             MetricsExporter::getInstance().setGauge("kafka_queue_size", kafkaSize, {});
             MetricsExporter::getInstance().setGauge("db_queue_size", dbQueueSize, {});
@@ -77,7 +75,6 @@ void startTableBufferCleanupThread(std::atomic<bool>& stopFlag, WriteDataToDB& w
                     OpenSync::Logger::info("🧹 Drained " + std::to_string(batch.size()) + " rows from buffer of table " + table);
                 }
             }
-            malloc_trim(0);  // Force OS memory release
             std::this_thread::sleep_for(std::chrono::seconds(10));
         }
         OpenSync::Logger::info("🧹 Table Buffer Cleanup Thread stopped.");
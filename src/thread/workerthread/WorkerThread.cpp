@@ -2,24 +2,52 @@
 #include "../../kafka/KafkaProcessor.h"
 #include "../../common/Queues.h"
 #include "../../common/TableBatch.h"
+#include "../../common/TableBatchAggregator.h"
+#include "../../common/MemoryAccountant.h"
+#include "../../kafka/CommitWatermark.h"
+#include "../dbwriterthread/ApplyLaneRouter.h"
 #include "../../logger/Logger.h"
 #include "../../common/TimeCur.h"
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
+// Số message lấy một lần từ kafkaMessageQueue (một lần wake-up / CAS loop thay vì mỗi message)
+static constexpr size_t WORKER_POP_BULK = 32;
+
 void workerThread(KafkaProcessor& processor, int batchFlushIntervalMs, std::atomic<bool>& shouldShutdown) {
     OpenSync::Logger::info("🧵 Worker thread started.");
+    (void)batchFlushIntervalMs;  // đã cấu hình trong TableBatchAggregator
+
+    // Batch theo bảng dùng chung giữa các worker
+    auto& aggregator = TableBatchAggregator::getInstance();
+    std::vector<TableBatchAggregator::ReadyBatch> ready;
+
+    auto& router = ApplyLaneRouter::getInstance();
+    auto& accountant = MemoryAccountant::getInstance();
 
-    std::unordered_map<std::string, TableBatch> tableBuffers;
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> lastFlushTime;
+    auto pushReady = [&ready, &router]() {
+        // Đúng thứ tự lấy ra khỏi aggregator (seq của mỗi bảng tăng dần trong ready → không chờ vòng tròn)
+        for (auto& [tableKey, batch, orderKey, seq] : ready) {
+            router.dispatch(tableKey, std::move(batch), orderKey, seq);
+        }
+        ready.clear();
+    };
+
+    std::vector<std::tuple<std::string, int, int64_t, int64_t, rd_kafka_message_t*>> items;
+    items.reserve(WORKER_POP_BULK);
 
     while (!shouldShutdown) {
-        std::tuple<std::string, int, int64_t, int64_t, rd_kafka_message_t*> item;
-        bool hasMessage = kafkaMessageQueue.try_pop(item, std::chrono::milliseconds(100));
+        // Ngủ tới đúng deadline flush gần nhất (tối đa 100ms để còn kiểm tra shutdown)
+        auto waitMs = std::chrono::milliseconds(100);
+        auto untilDeadline = std::chrono::ceil<std::chrono::milliseconds>(
+            aggregator.nextDeadline() - std::chrono::steady_clock::now());
+        if (untilDeadline < waitMs) waitMs = std::max(untilDeadline, std::chrono::milliseconds(0));
 
-        auto now = std::chrono::steady_clock::now();
+        items.clear();
+        kafkaMessageQueue.pop_bulk(items, WORKER_POP_BULK, waitMs);
 
-        if (hasMessage) {
+        for (auto& item : items) {
             auto& [message, partition, offset, timestamp, rawMsg] = item;
 
             // Parse Kafka message
@@ -27,51 +55,37 @@ void workerThread(KafkaProcessor& processor, int batchFlushIntervalMs, std::atom
 	    OpenSync::Logger::debug("📩 Kafka message received at: " + std::to_string(getCurrentTimeMs()));
             auto batchMap = processor.processMessageByTable(message, partition, offset, timestamp);
 	    OpenSync::Logger::debug("✅ SQLBuilder called at: " + std::to_string(getCurrentTimeMs()));
+            accountant.release(MemoryAccountant::KAFKA_QUEUE, message.size());
 
+            // Không có row nào cần ghi: message xong, không giữ watermark của partition (commit cùng message sau);
+            // nhiều bảng: mỗi batch giữ một reference
+            if (batchMap.empty()) {
+                accountant.releaseMessage(rawMsg, true, [](rd_kafka_message_t* m) {
+                    CommitWatermark::getInstance().markDone(rd_kafka_topic_name(m->rkt), m->partition, m->offset);
+                });
+                continue;
+            }
+            if (batchMap.size() > 1) accountant.addMessageRefs(rawMsg, static_cast<int>(batchMap.size()) - 1);
 
-            for (auto& [tableKey, sqls] : batchMap) {
-                auto& batch = tableBuffers[tableKey];
-                batch.sqls.insert(batch.sqls.end(), sqls.begin(), sqls.end());
-                batch.messages.push_back(rawMsg);
-                lastFlushTime[tableKey] = now;
-
-                // Flush nếu batch đủ lớn
-                if (batch.sqls.size() >= batchSize) {
-                    dbWriteQueue.push({tableKey, std::move(batch)});
-                    tableBuffers.erase(tableKey);
-                    lastFlushTime.erase(tableKey);
-                }
+            // Flush nếu batch chung của bảng đủ lớn (rows hoặc bytes)
+            for (auto& [tableKey, produced] : batchMap) {
+                aggregator.append(tableKey, std::move(produced), rawMsg, ready);
             }
         }
+        pushReady();
 
         // Kiểm tra timeout flush buffer
-        for (auto it = lastFlushTime.begin(); it != lastFlushTime.end();) {
-            const auto& tableKey = it->first;
-            auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - it->second).count();
-
-            if (elapsedMs >= batchFlushIntervalMs) {
-                if (!tableBuffers[tableKey].sqls.empty()) {
-                    OpenSync::Logger::debug("⏳ Timeout flush for table: " + tableKey + ", batch size: " + std::to_string(tableBuffers[tableKey].sqls.size()));
-                    dbWriteQueue.push({tableKey, std::move(tableBuffers[tableKey])});
-                }
-                tableBuffers.erase(tableKey);
-                it = lastFlushTime.erase(it);
-            } else {
-                ++it;
-            }
+        aggregator.collectExpired(std::chrono::steady_clock::now(), ready);
+        for (const auto& [tableKey, batch, orderKey, seq] : ready) {
+            OpenSync::Logger::debug("⏳ Timeout flush for table: " + tableKey + ", batch size: " + std::to_string(batch.sqls.size()));
         }
+        pushReady();
     }
 
-    // 🔥 Khi shutdown, flush toàn bộ còn lại
+    // 🔥 Khi shutdown, flush toàn bộ còn lại (worker nào thoát sau cũng flush phần mình vừa append)
     OpenSync::Logger::info("🛑 Flushing remaining buffers before shutdown...");
-    for (auto& [tableKey, batch] : tableBuffers) {
-        if (!batch.sqls.empty()) {
-            dbWriteQueue.push({tableKey, std::move(batch)});
-        }
-    }
-    tableBuffers.clear();
-    lastFlushTime.clear();
+    aggregator.drainAll(ready);
+    pushReady();
 
     OpenSync::Logger::info("🎯 Worker thread exited cleanly.");
 }
-
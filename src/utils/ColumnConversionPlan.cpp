@@ -0,0 +1,422 @@
+#include "ColumnConversionPlan.h"
+#include "SQLUtils.h"
+#include "../logger/Logger.h"
+#include "../common/TimeUtils.h"
+#include "../schema/OracleSchemaCache.h"
+#include "../schema/PostgreSQLSchemaCache.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+using rapidjson::Value;
+
+namespace {
+
+void appendJsonQuoted(std::string& out, const Value& val) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    val.Accept(writer);
+    SQLUtils::appendQuoted(out, buffer.GetString(), buffer.GetSize());
+}
+
+// ---------- Oracle ----------
+void convertOracleDate(std::string& out, const Value& val, const ColumnConversion&, int timestamp_unit) {
+    int64_t microsec = SQLUtils::extractMicroseconds(val, timestamp_unit);
+    out += "TO_DATE('";
+    TimeUtils::appendMicrosecondsToDate(out, microsec);
+    out += "', 'YYYY-MM-DD')";
+}
+
+void convertOracleTimestamp(std::string& out, const Value& val, const ColumnConversion&, int timestamp_unit) {
+    int64_t microsec = SQLUtils::extractMicroseconds(val, timestamp_unit);
+    out += "TO_TIMESTAMP('";
+    TimeUtils::appendMicrosecondsToTimestamp(out, microsec);
+    out += "', 'YYYY-MM-DD HH24:MI:SS.FF6')";
+}
+
+void convertText(std::string& out, const Value& val, const ColumnConversion&, int) {
+    if (val.IsString()) SQLUtils::appendQuoted(out, val.GetString(), val.GetStringLength());
+    else out += "'?'";
+}
+
+void convertNumber(std::string& out, const Value& val, const ColumnConversion& col, int) {
+    if (val.IsString()) {
+        // Số được parse dạng chuỗi (kParseNumbersAsStringsFlag) → giữ nguyên từng chữ số (NUMBER(38), ID > 2^53)
+        if (SQLUtils::isNumericLiteral(val.GetString(), val.GetStringLength())) {
+            out.append(val.GetString(), val.GetStringLength());
+        } else {
+            OpenSync::Logger::warn("⚠️ Non-numeric value for " + col.tableName + "." + col.name + " (" + col.dataType + "), quoted");
+            SQLUtils::appendQuoted(out, val.GetString(), val.GetStringLength());
+        }
+    } else if (val.IsNumber()) {
+        SQLUtils::appendNumber(out, val);
+    } else {
+        out += "NULL";
+    }
+}
+
+void convertOther(std::string& out, const Value& val, const ColumnConversion&, int) {
+    if (val.IsString()) SQLUtils::appendQuoted(out, val.GetString(), val.GetStringLength());
+    else appendJsonQuoted(out, val);
+}
+
+// ---------- PostgreSQL ----------
+void convertPgTimestamp(std::string& out, const Value& val, const ColumnConversion& col, int timestamp_unit) {
+    int64_t microsec = SQLUtils::extractMicroseconds(val, timestamp_unit);
+    if (microsec == 0) {
+        OpenSync::Logger::debug("⛔ Skipping timestamp=0 (NULL?) at " + col.tableName + "." + col.name);
+        out += "NULL";
+        return;
+    }
+
+    constexpr int64_t MIN_US = -3786825600000000;
+    constexpr int64_t MAX_US = 4102444800000000;
+    if (microsec < MIN_US || microsec > MAX_US) {
+        OpenSync::Logger::debug("⛔ Out-of-range timestamp: " + TimeUtils::convertMicrosecondsToTimestamp(microsec) +
+                                " at " + col.tableName + "." + col.name);
+        out += "NULL";
+        return;
+    }
+
+    out += '\'';
+    TimeUtils::appendMicrosecondsToTimestamp(out, microsec);
+    out += '\'';
+}
+
+void convertPgDate(std::string& out, const Value& val, const ColumnConversion&, int timestamp_unit) {
+    int64_t microsec = SQLUtils::extractMicroseconds(val, timestamp_unit);
+    if (microsec == 0) {
+        out += "NULL";
+        return;
+    }
+    out += '\'';
+    TimeUtils::appendMicrosecondsToDate(out, microsec);
+    out += '\'';
+}
+
+bool isPgNullString(const Value& val) {
+    if (!val.IsString()) return false;
+    const char* s = val.GetString();
+    return val.GetStringLength() == 0 || std::strcmp(s, "NULL") == 0 || std::strcmp(s, "null") == 0;
+}
+
+// ---------- Perfect hash ----------
+inline uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline size_t nextPowerOfTwo(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+constexpr uint32_t MAX_DISPLACEMENT = 1u << 20;
+// Số lần nhân đôi bảng slot tối đa trước khi bỏ perfect hash → tra tuyến tính
+constexpr int MAX_TABLE_GROWTH = 4;
+
+} // namespace
+
+ColumnConversion ColumnConversion::forOracle(const std::string& tableName, const std::string& colName, const OracleColumnInfo& info) {
+    ColumnConversion col;
+    col.name = colName;
+    col.tableName = tableName;
+    col.dataType = info.dataType;
+
+    const std::string& dataType = info.dataType;
+    if (dataType == "DATE") {
+        col.type = ColumnConvertType::ORACLE_DATE;
+        col.convert = &convertOracleDate;
+    } else if (dataType.find("TIMESTAMP") != std::string::npos) {
+        col.type = ColumnConvertType::ORACLE_TIMESTAMP;
+        col.convert = &convertOracleTimestamp;
+    } else if (dataType.find("CHAR") != std::string::npos || dataType.find("CLOB") != std::string::npos || dataType.find("TEXT") != std::string::npos) {
+        col.type = ColumnConvertType::ORACLE_TEXT;
+        col.convert = &convertText;
+    } else if (dataType.find("NUMBER") != std::string::npos || dataType == "FLOAT" || dataType == "DECIMAL") {
+        col.type = ColumnConvertType::ORACLE_NUMBER;
+        col.convert = &convertNumber;
+    } else {
+        col.type = ColumnConvertType::ORACLE_OTHER;
+        col.convert = &convertOther;
+    }
+    return col;
+}
+
+ColumnConversion ColumnConversion::forPostgreSQL(const std::string& tableName, const std::string& colName, const PostgreSQLColumnInfo& info) {
+    ColumnConversion col;
+    col.name = colName;
+    col.tableName = tableName;
+    col.dataType = info.dataType;
+
+    const std::string& dataType = info.dataType;
+    if (dataType == "timestamp" || dataType == "timestamp without time zone") {
+        col.type = ColumnConvertType::PG_TIMESTAMP;
+        col.convert = &convertPgTimestamp;
+    } else if (dataType == "date") {
+        col.type = ColumnConvertType::PG_DATE;
+        col.convert = &convertPgDate;
+    } else if (dataType.find("char") != std::string::npos || dataType == "text") {
+        col.type = ColumnConvertType::PG_TEXT;
+        col.convert = &convertText;
+    } else if (dataType.find("int") != std::string::npos || dataType.find("numeric") != std::string::npos ||
+               dataType.find("float") != std::string::npos || dataType.find("double") != std::string::npos) {
+        col.type = ColumnConvertType::PG_NUMBER;
+        col.convert = &convertNumber;
+    } else {
+        col.type = ColumnConvertType::PG_OTHER;
+        col.convert = &convertOther;
+    }
+    return col;
+}
+
+ColumnConversionPlan::ColumnConversionPlan(std::string tableName, std::vector<ColumnConversion> columns,
+                                           uint64_t schemaVersion, bool foldCase)
+    : tableName(std::move(tableName)), columns(std::move(columns)), version(schemaVersion), foldCase(foldCase) {
+    std::vector<int32_t> indexed;
+    indexed.reserve(this->columns.size());
+    if (!this->foldCase) {
+        for (size_t i = 0; i < this->columns.size(); ++i) indexed.push_back(static_cast<int32_t>(i));
+        buildIndex(indexed);
+        return;
+    }
+
+    // PG: "Foo" và foo là hai cột khác nhau → trùng hash sau khi fold với mọi seed. Các cột trùng được tra
+    // đúng case trước (exactOrdinals); perfect hash chỉ giữ cột lower-case của nhóm (tên JSON upper-case của
+    // Oracle vẫn fold về cột này như trước)
+    std::unordered_map<std::string, std::vector<int32_t>> folded;
+    for (size_t i = 0; i < this->columns.size(); ++i) {
+        std::string lower = this->columns[i].name;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        folded[std::move(lower)].push_back(static_cast<int32_t>(i));
+    }
+    for (const auto& [lower, ordinals] : folded) {
+        if (ordinals.size() == 1) {
+            indexed.push_back(ordinals.front());
+            continue;
+        }
+        std::string names;
+        for (int32_t ordinal : ordinals) {
+            const std::string& name = this->columns[ordinal].name;
+            exactOrdinals.emplace(name, ordinal);
+            if (name == lower) indexed.push_back(ordinal);
+            names += (names.empty() ? "" : ", ") + name;
+        }
+        OpenSync::Logger::warn("⚠️ [PG] Columns " + names + " of " + this->tableName +
+                               " differ only in case → matched case-sensitively first");
+    }
+    std::sort(indexed.begin(), indexed.end());
+    buildIndex(indexed);
+}
+
+std::shared_ptr<const ColumnConversionPlan> ColumnConversionPlan::buildOracle(
+    const std::string& tableName, const std::map<std::string, OracleColumnInfo>& columns, uint64_t schemaVersion) {
+    std::vector<ColumnConversion> cols;
+    cols.reserve(columns.size());
+    for (const auto& [colName, info] : columns) {
+        cols.push_back(ColumnConversion::forOracle(tableName, colName, info));
+    }
+    return std::make_shared<const ColumnConversionPlan>(tableName, std::move(cols), schemaVersion, false);
+}
+
+std::shared_ptr<const ColumnConversionPlan> ColumnConversionPlan::buildPostgreSQL(
+    const std::string& tableName, const std::unordered_map<std::string, PostgreSQLColumnInfo>& columns, uint64_t schemaVersion) {
+    std::vector<ColumnConversion> cols;
+    cols.reserve(columns.size());
+    for (const auto& [colName, info] : columns) {
+        cols.push_back(ColumnConversion::forPostgreSQL(tableName, colName, info));
+    }
+    // Thứ tự ordinal ổn định giữa các lần build
+    std::sort(cols.begin(), cols.end(), [](const ColumnConversion& a, const ColumnConversion& b) { return a.name < b.name; });
+    return std::make_shared<const ColumnConversionPlan>(tableName, std::move(cols), schemaVersion, true);
+}
+
+uint64_t ColumnConversionPlan::hashName(const char* name, size_t len, uint64_t seed) const {
+    uint64_t h = 0xcbf29ce484222325ULL ^ mix64(seed + 1);
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = static_cast<unsigned char>(name[i]);
+        if (foldCase) c = static_cast<unsigned char>(std::tolower(c));
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return mix64(h);
+}
+
+bool ColumnConversionPlan::nameEquals(const ColumnConversion& col, const char* name, size_t len) const {
+    if (col.name.size() != len) return false;
+    if (!foldCase) return std::memcmp(col.name.data(), name, len) == 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (col.name[i] != static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])))) return false;
+    }
+    return true;
+}
+
+void ColumnConversionPlan::buildIndex(const std::vector<int32_t>& indexed) {
+    const size_t n = indexed.size();
+    if (n == 0) return;
+
+    const size_t bucketCount = std::max<size_t>(1, n / 2);
+    std::vector<std::vector<int32_t>> buckets(bucketCount);
+    for (int32_t ordinal : indexed) {
+        const auto& name = columns[ordinal].name;
+        buckets[hashName(name.data(), name.size(), 0) % bucketCount].push_back(ordinal);
+    }
+
+    // Bucket lớn xếp trước → dễ tìm displacement hơn
+    std::vector<size_t> order(bucketCount);
+    for (size_t b = 0; b < bucketCount; ++b) order[b] = b;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    const size_t initialSize = nextPowerOfTwo(n * 2);
+    for (size_t tableSize = initialSize; tableSize <= (initialSize << MAX_TABLE_GROWTH); tableSize <<= 1) {
+        slots.assign(tableSize, -1);
+        displacements.assign(bucketCount, 0);
+        slotMask = tableSize - 1;
+
+        bool ok = true;
+        std::vector<size_t> placed;
+        for (size_t b : order) {
+            const auto& bucket = buckets[b];
+            if (bucket.empty()) continue;
+
+            bool found = false;
+            for (uint32_t d = 1; d < MAX_DISPLACEMENT && !found; ++d) {
+                placed.clear();
+                bool collision = false;
+                for (int32_t ordinal : bucket) {
+                    const auto& name = columns[ordinal].name;
+                    size_t slot = hashName(name.data(), name.size(), d) & slotMask;
+                    if (slots[slot] != -1 || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                        collision = true;
+                        break;
+                    }
+                    placed.push_back(slot);
+                }
+                if (collision) continue;
+
+                for (size_t k = 0; k < bucket.size(); ++k) slots[placed[k]] = bucket[k];
+                displacements[b] = d;
+                found = true;
+            }
+            if (!found) {
+                ok = false;
+                break;
+            }
+        }
+        if (ok) return;
+    }
+
+    // Không dựng được perfect hash (tên trùng sau khi hash) → findOrdinal tra tuyến tính
+    OpenSync::Logger::warn("⚠️ Column index for " + tableName + " could not be built, falling back to linear lookup");
+    displacements.clear();
+    slots.clear();
+    slotMask = 0;
+}
+
+int ColumnConversionPlan::findOrdinal(const char* name, size_t len) const {
+    if (columns.empty()) return -1;
+    if (!exactOrdinals.empty()) {
+        auto it = exactOrdinals.find(std::string(name, len));
+        if (it != exactOrdinals.end()) return it->second;
+    }
+    if (displacements.empty()) {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (nameEquals(columns[i], name, len)) return static_cast<int>(i);
+        }
+        return -1;
+    }
+    uint32_t d = displacements[hashName(name, len, 0) % displacements.size()];
+    if (d == 0) return -1;
+    int32_t ordinal = slots[hashName(name, len, d) & slotMask];
+    if (ordinal < 0 || !nameEquals(columns[ordinal], name, len)) return -1;
+    return ordinal;
+}
+
+void ColumnConversionPlan::appendValue(std::string& out, int ordinal, const Value& val, int timestamp_unit) const {
+    const ColumnConversion& col = columns[ordinal];
+    if (val.IsNull() || (col.isPostgreSQL() && isPgNullString(val))) {
+        out += "NULL";
+        return;
+    }
+
+    const size_t mark = out.size();
+    try {
+        col.convert(out, val, col, timestamp_unit);
+    } catch (const std::exception& ex) {
+        out.resize(mark);
+        out += "NULL";
+        OpenSync::Logger::warn("Failed to convert value for " + col.tableName + "." + col.name +
+                               " with type=" + col.dataType + ": " + ex.what());
+    }
+}
+
+void ColumnConversionPlan::appendValueByName(std::string& out, const char* name, size_t len, const Value& val, int timestamp_unit) const {
+    int ordinal = findOrdinal(name, len);
+    if (ordinal >= 0) {
+        appendValue(out, ordinal, val, timestamp_unit);
+        return;
+    }
+
+    if (foldCase) {
+        std::string lowerCol(name, len);
+        std::transform(lowerCol.begin(), lowerCol.end(), lowerCol.begin(), ::tolower);
+        OpenSync::Logger::warn("❗️[PG] Column not found: " + tableName + "." + lowerCol);
+    } else {
+        OpenSync::Logger::warn("❗️[Ora] Column not found: " + tableName + "." + std::string(name, len));
+    }
+    out += "NULL";
+}
+
+std::shared_ptr<const ColumnConversionPlan> ColumnConversionPlanCache::getPlan(const std::string& dbType, const std::string& tableName) {
+    struct Entry {
+        std::shared_ptr<const ColumnConversionPlan> plan;
+        uint64_t checkedGeneration = 0;
+    };
+    thread_local std::unordered_map<std::string, Entry> oraclePlans;
+    thread_local std::unordered_map<std::string, Entry> postgresPlans;
+
+    if (dbType == "oracle") {
+        auto& cache = OracleSchemaCache::getInstance();
+        const uint64_t generation = cache.getSchemaGeneration();
+        Entry& entry = oraclePlans[tableName];
+        if (entry.plan && entry.checkedGeneration == generation) return entry.plan;
+
+        uint64_t version = 0;
+        auto columns = cache.getColumnInfoSnapshot(tableName, version);
+        if (!entry.plan || entry.plan->schemaVersion() != version) {
+            entry.plan = ColumnConversionPlan::buildOracle(tableName, columns, version);
+            OpenSync::Logger::debug("🧩 Built Oracle conversion plan for " + tableName + " (cols: " +
+                                    std::to_string(columns.size()) + ", version: " + std::to_string(version) + ")");
+        }
+        entry.checkedGeneration = generation;
+        return entry.plan;
+    }
+
+    if (dbType == "postgresql") {
+        auto& cache = PostgreSQLSchemaCache::getInstance();
+        const uint64_t generation = cache.getSchemaGeneration();
+        Entry& entry = postgresPlans[tableName];
+        if (entry.plan && entry.checkedGeneration == generation) return entry.plan;
+
+        uint64_t version = 0;
+        auto columns = cache.getColumnInfoSnapshot(tableName, version);
+        if (!entry.plan || entry.plan->schemaVersion() != version) {
+            entry.plan = ColumnConversionPlan::buildPostgreSQL(tableName, columns, version);
+            OpenSync::Logger::debug("🧩 Built PostgreSQL conversion plan for " + tableName + " (cols: " +
+                                    std::to_string(columns.size()) + ", version: " + std::to_string(version) + ")");
+        }
+        entry.checkedGeneration = generation;
+        return entry.plan;
+    }
+
+    OpenSync::Logger::error("❌ Unsupported dbType in ColumnConversionPlanCache::getPlan: " + dbType);
+    static const auto emptyPlan = std::make_shared<const ColumnConversionPlan>(tableName, std::vector<ColumnConversion>{}, 0, false);
+    return emptyPlan;
+}
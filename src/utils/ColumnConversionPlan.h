@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <rapidjson/document.h>
+#include "../schema/OracleColumnInfo.h"
+#include "../schema/PostgreSQLColumnInfo.h"
+
+// Kiểu cột đã resolve sẵn từ dataType của schema cache (không so sánh chuỗi type theo từng value nữa)
+enum class ColumnConvertType : uint8_t {
+    ORACLE_DATE,
+    ORACLE_TIMESTAMP,
+    ORACLE_TEXT,
+    ORACLE_NUMBER,
+    ORACLE_OTHER,
+    PG_TIMESTAMP,
+    PG_DATE,
+    PG_TEXT,
+    PG_NUMBER,
+    PG_OTHER
+};
+
+struct ColumnConversion;
+
+// Append SQL literal của val vào out
+using ColumnConverter = void (*)(std::string& out, const rapidjson::Value& val,
+                                 const ColumnConversion& col, int timestamp_unit);
+
+struct ColumnConversion {
+    std::string name;       // tên cột như trong schema cache (PG: lower-case)
+    std::string tableName;  // chỉ dùng để log
+    std::string dataType;
+    ColumnConvertType type = ColumnConvertType::ORACLE_OTHER;
+    ColumnConverter convert = nullptr;
+
+    bool isPostgreSQL() const { return type >= ColumnConvertType::PG_TIMESTAMP; }
+
+    static ColumnConversion forOracle(const std::string& tableName, const std::string& colName, const OracleColumnInfo& info);
+    static ColumnConversion forPostgreSQL(const std::string& tableName, const std::string& colName, const PostgreSQLColumnInfo& info);
+};
+
+// Conversion plan cho một bảng tại một schema version:
+// vector theo ordinal + perfect hash (hash-and-displace) từ tên JSON member → ordinal.
+class ColumnConversionPlan {
+public:
+    ColumnConversionPlan(std::string tableName, std::vector<ColumnConversion> columns,
+                         uint64_t schemaVersion, bool foldCase);
+
+    static std::shared_ptr<const ColumnConversionPlan> buildOracle(
+        const std::string& tableName, const std::map<std::string, OracleColumnInfo>& columns, uint64_t schemaVersion);
+    static std::shared_ptr<const ColumnConversionPlan> buildPostgreSQL(
+        const std::string& tableName, const std::unordered_map<std::string, PostgreSQLColumnInfo>& columns, uint64_t schemaVersion);
+
+    // -1 nếu cột không có trong schema
+    int findOrdinal(const char* name, size_t len) const;
+    int findOrdinal(const rapidjson::Value& name) const { return findOrdinal(name.GetString(), name.GetStringLength()); }
+
+    // Convert value của cột ordinal, append vào out; lỗi convert → NULL
+    void appendValue(std::string& out, int ordinal, const rapidjson::Value& val, int timestamp_unit) const;
+    // Như appendValue nhưng lookup theo tên; cột không có trong schema → warn + NULL
+    void appendValueByName(std::string& out, const char* name, size_t len, const rapidjson::Value& val, int timestamp_unit) const;
+
+    const ColumnConversion& column(size_t ordinal) const { return columns[ordinal]; }
+    size_t size() const { return columns.size(); }
+    bool empty() const { return columns.empty(); }
+    uint64_t schemaVersion() const { return version; }
+    const std::string& table() const { return tableName; }
+
+private:
+    uint64_t hashName(const char* name, size_t len, uint64_t seed) const;
+    bool nameEquals(const ColumnConversion& col, const char* name, size_t len) const;
+    void buildIndex(const std::vector<int32_t>& indexed);
+
+    std::string tableName;
+    std::vector<ColumnConversion> columns;
+    uint64_t version = 0;
+    bool foldCase = false;
+    // Chỉ có khi các cột PG khác nhau đúng ở case: tên chính xác → ordinal, tra trước perfect hash
+    std::unordered_map<std::string, int32_t> exactOrdinals;
+
+    std::vector<uint32_t> displacements;  // seed theo bucket
+    std::vector<int32_t> slots;           // slot → ordinal (-1 = trống)
+    uint64_t slotMask = 0;
+};
+
+// Cache plan theo thread (worker) → lookup không lock; chỉ rebuild khi schema generation thay đổi
+class ColumnConversionPlanCache {
+public:
+    // dbType: "oracle" | "postgresql". PostgreSQL: tableName phải lower-case.
+    static std::shared_ptr<const ColumnConversionPlan> getPlan(const std::string& dbType, const std::string& tableName);
+};
@@ -1,12 +1,18 @@
 #include "SQLUtils.h"
+#include "ColumnConversionPlan.h"
 #include "../logger/Logger.h"
 #include "../common/TimeUtils.h"
-#include "../schema/OracleSchemaCache.h"
 #include "../schema/PostgreSQLSchemaCache.h"
+#include "../metrics/MetricsExporter.h"
 #include <sstream>
-#include <iomanip>
 #include <string>
 #include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <atomic>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
@@ -16,12 +22,10 @@ using namespace std;
 std::string SQLUtils::convertToSQLValue(const Value& val) {
     if (val.IsNull()) return "NULL";
     if (val.IsBool()) return val.GetBool() ? "1" : "0";
-    if (val.IsInt64()) return std::to_string(val.GetInt64());
-    if (val.IsUint64()) return std::to_string(val.GetUint64());
-    if (val.IsDouble()) {
-        std::ostringstream oss;
-        oss << std::fixed << std::setprecision(6) << val.GetDouble();
-        return oss.str();
+    if (val.IsNumber()) {
+        std::string out;
+        appendNumber(out, val);
+        return out;
     }
     if (val.IsString()) return quoteString(val.GetString());
 
@@ -52,6 +56,44 @@ bool SQLUtils::isPostgreSQLTimestampOutOfRange(const std::string& timestampStr)
     return false;
 }
 
+bool SQLUtils::isNumericLiteral(const char* str, size_t len) {
+    const char* p = str;
+    const char* end = str + len;
+
+    if (p != end && (*p == '+' || *p == '-')) ++p;
+
+    size_t digits = 0;
+    while (p != end && *p >= '0' && *p <= '9') { ++p; ++digits; }
+    if (p != end && *p == '.') {
+        ++p;
+        while (p != end && *p >= '0' && *p <= '9') { ++p; ++digits; }
+    }
+    if (digits == 0) return false;
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        if (p != end && (*p == '+' || *p == '-')) ++p;
+        size_t expDigits = 0;
+        while (p != end && *p >= '0' && *p <= '9') { ++p; ++expDigits; }
+        if (expDigits == 0) return false;
+    }
+    return p == end;
+}
+
+void SQLUtils::appendNumber(std::string& out, const Value& val) {
+    char buffer[32];
+    std::to_chars_result res{buffer, std::errc()};
+    if (val.IsInt64()) res = std::to_chars(buffer, buffer + sizeof(buffer), val.GetInt64());
+    else if (val.IsUint64()) res = std::to_chars(buffer, buffer + sizeof(buffer), val.GetUint64());
+    else if (val.IsDouble()) res = std::to_chars(buffer, buffer + sizeof(buffer), val.GetDouble());
+
+    if (res.ec != std::errc() || res.ptr == buffer) {
+        out += "NULL";
+        return;
+    }
+    out.append(buffer, static_cast<size_t>(res.ptr - buffer));
+}
+
 std::string SQLUtils::convertToSQLValueWithType(
     const Value& val,
     const std::string& dbType,
@@ -63,40 +105,10 @@ std::string SQLUtils::convertToSQLValueWithType(
 {
     (void)dbType;
     (void)useISO8601ForDebug;
-    if (val.IsNull()) return "NULL";
-
-    const std::string& dataType = colInfo.dataType;
-    try {
-        if (dataType == "DATE") {
-            int64_t microsec = extractMicroseconds(val, timestamp_unit);
-            std::string formatted = TimeUtils::convertMicrosecondsToDate(microsec);
-            return "TO_DATE('" + formatted + "', 'YYYY-MM-DD')";
-        }
-        if (dataType.find("TIMESTAMP") != std::string::npos) {
-            int64_t microsec = extractMicroseconds(val, timestamp_unit);
-            std::string formatted = TimeUtils::convertMicrosecondsToTimestamp(microsec);
-            return "TO_TIMESTAMP('" + formatted + "', 'YYYY-MM-DD HH24:MI:SS.FF6')";
-        }
-        if (dataType.find("CHAR") != std::string::npos || dataType.find("CLOB") != std::string::npos || dataType.find("TEXT") != std::string::npos) {
-            return val.IsString() ? quoteString(val.GetString()) : quoteString("?");
-        }
-        if (dataType.find("NUMBER") != std::string::npos || dataType == "FLOAT" || dataType == "DECIMAL") {
-            if (val.IsNumber()) return std::to_string(val.GetDouble());
-            if (val.IsString()) return val.GetString();
-            return "NULL";
-        }
-        if (val.IsString()) return quoteString(val.GetString());
-
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        val.Accept(writer);
-        return quoteString(buffer.GetString());
-
-    } catch (const std::exception& ex) {
-        OpenSync::Logger::warn("Failed to convert value for " + tableName + "." + colName +
-                     " with type=" + dataType + ": " + ex.what());
-        return "NULL";
-    }
+    ColumnConversionPlan plan(tableName, {ColumnConversion::forOracle(tableName, colName, colInfo)}, 0, false);
+    std::string out;
+    plan.appendValue(out, 0, val, timestamp_unit);
+    return out;
 }
 
 std::string SQLUtils::safeConvert(
@@ -107,35 +119,16 @@ std::string SQLUtils::safeConvert(
     bool useISO8601ForDebug,
     int timestamp_unit)
 {
-    if (dbType == "oracle") {
-        const auto& colInfoMap = OracleSchemaCache::getInstance().getColumnInfo(tableName);
-        auto it = colInfoMap.find(colName);
-        if (it != colInfoMap.end()) {
-            return convertToSQLValueWithType(val, dbType, it->second, tableName, colName, useISO8601ForDebug, timestamp_unit);
-        } else {
-            OpenSync::Logger::warn("❗️[Ora] Column not found: " + tableName + "." + colName);
-            return "NULL";
-        }
-    } else if (dbType == "postgresql") {
-
-	std::string lowerTable = tableName;
-	std::string lowerCol = colName;
-	std::transform(lowerTable.begin(), lowerTable.end(), lowerTable.begin(), ::tolower);
-    	std::transform(lowerCol.begin(), lowerCol.end(), lowerCol.begin(), ::tolower);
-
-	const auto& colInfoMap = PostgreSQLSchemaCache::getInstance().getColumnInfo(lowerTable);
-	auto it = colInfoMap.find(lowerCol);
-	if (it != colInfoMap.end()) {
-            return safeConvertPostgreSQL(val, it->second, lowerTable, lowerCol, useISO8601ForDebug, timestamp_unit);
- 	} else {
-	    OpenSync::Logger::warn("❗️[PG] Column not found: " + lowerTable + "." + lowerCol);
-    	    return "NULL";
-	}
-
-    } else {
+    (void)useISO8601ForDebug;
+    if (dbType != "oracle" && dbType != "postgresql") {
         OpenSync::Logger::error("❌ Unsupported dbType in SQLUtils::safeConvert: " + dbType);
         return "NULL";
     }
+
+    const auto plan = ColumnConversionPlanCache::getPlan(dbType, dbType == "postgresql" ? toLower(tableName) : tableName);
+    std::string out;
+    plan->appendValueByName(out, colName.data(), colName.size(), val, timestamp_unit);
+    return out;
 }
 
 std::string SQLUtils::safeConvert(
@@ -170,15 +163,23 @@ int64_t SQLUtils::extractMicroseconds(const Value& val, int timestamp_unit) {
         value = static_cast<int64_t>(val.GetDouble());
     }
     else if (val.IsString()) {
-        std::string s = val.GetString();
-        if (s == "NULL" || s == "null" || s.empty()) {
+        // kParseNumbersAsStringsFlag → epoch số đến dưới dạng chuỗi
+        const char* s = val.GetString();
+        const char* end = s + val.GetStringLength();
+        if (s == end || std::strcmp(s, "NULL") == 0 || std::strcmp(s, "null") == 0) {
             return 0; // Trả về 0 hoặc sentinel value tùy xử lý phía trên
         }
-        try {
-            value = std::stoll(s);
-        } catch (...) {
-            OpenSync::Logger::warn("⛔ Invalid timestamp string (not numeric): " + s);
-            return 0;
+        const char* begin = (*s == '+') ? s + 1 : s;
+        auto res = std::from_chars(begin, end, value);
+        if (res.ec != std::errc() || res.ptr != end) {
+            // "1.7e15" / "1700000000000000.0"
+            double d = 0;
+            auto resD = std::from_chars(begin, end, d);
+            if (resD.ec != std::errc() || resD.ptr != end) {
+                OpenSync::Logger::warn("⛔ Invalid timestamp string (not numeric): " + std::string(s, end));
+                return 0;
+            }
+            value = static_cast<int64_t>(d);
         }
     }
     else {
@@ -239,18 +240,145 @@ std::string SQLUtils::convertMicrosecondsToDate(double microsec) {
     return TimeUtils::convertMicrosecondsToDate(static_cast<int64_t>(microsec));
 }
 
+namespace {
+
+std::atomic<uint8_t> utf8RepairPolicy{static_cast<uint8_t>(UTF8RepairPolicy::REPLACE)};
+
+// Độ dài chuỗi UTF-8 hợp lệ bắt đầu tại p (lead byte >= 0x80), 0 nếu không hợp lệ
+// (overlong, surrogate, > U+10FFFF, thiếu continuation byte)
+inline size_t validUTF8Sequence(const unsigned char* p, const unsigned char* end) {
+    const unsigned char c = p[0];
+    const size_t avail = static_cast<size_t>(end - p);
+    if (c < 0xC2) return 0;
+    if (c < 0xE0) {
+        return (avail >= 2 && (p[1] & 0xC0) == 0x80) ? 2 : 0;
+    }
+    if (c < 0xF0) {
+        if (avail < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80) return 0;
+        if (c == 0xE0 && p[1] < 0xA0) return 0;   // overlong
+        if (c == 0xED && p[1] >= 0xA0) return 0;  // surrogate
+        return 3;
+    }
+    if (c < 0xF5) {
+        if (avail < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80) return 0;
+        if (c == 0xF0 && p[1] < 0x90) return 0;   // overlong
+        if (c == 0xF4 && p[1] >= 0x90) return 0;  // > U+10FFFF
+        return 4;
+    }
+    return 0;
+}
+
+void appendRepairedByte(std::string& out, unsigned char c, UTF8RepairPolicy policy) {
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+    switch (policy) {
+        case UTF8RepairPolicy::DROP:
+            break;
+        case UTF8RepairPolicy::HEX: {
+            const char hex[4] = {'\\', 'x', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F]};
+            out.append(hex, sizeof(hex));
+            break;
+        }
+        default:
+            out.append("\xEF\xBF\xBD", 3);  // U+FFFD
+            break;
+    }
+}
+
+// Số byte đầu tiên không cần xử lý riêng (ASCII khác ' và NUL)
+inline size_t cleanPrefixLength(const unsigned char* p, const unsigned char* end) {
+    const unsigned char* start = p;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('\'');
+    const __m128i zero = _mm_setzero_si128();
+    while (end - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // movemask lấy bit cao → byte >= 0x80; cộng thêm ' và NUL
+        const __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, zero));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(special, chunk));
+        if (mask != 0) {
+            return static_cast<size_t>(p - start) + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+        p += 16;
+    }
+#endif
+    while (p != end && *p != '\'' && *p != 0 && *p < 0x80) ++p;
+    return static_cast<size_t>(p - start);
+}
+
+} // namespace
+
+void SQLUtils::setUTF8RepairPolicy(UTF8RepairPolicy policy) {
+    utf8RepairPolicy.store(static_cast<uint8_t>(policy), std::memory_order_relaxed);
+}
+
+UTF8RepairPolicy SQLUtils::getUTF8RepairPolicy() {
+    return static_cast<UTF8RepairPolicy>(utf8RepairPolicy.load(std::memory_order_relaxed));
+}
+
+UTF8RepairPolicy SQLUtils::parseUTF8RepairPolicy(const std::string& name) {
+    const std::string lower = toLower(name);
+    if (lower == "drop") return UTF8RepairPolicy::DROP;
+    if (lower == "hex") return UTF8RepairPolicy::HEX;
+    if (lower != "replace") {
+        OpenSync::Logger::warn("⚠️ Unknown utf8_repair_policy '" + name + "', using 'replace'");
+    }
+    return UTF8RepairPolicy::REPLACE;
+}
+
+size_t SQLUtils::appendEscaped(std::string& out, const char* str, size_t len) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+    const unsigned char* end = p + len;
+    const UTF8RepairPolicy policy = getUTF8RepairPolicy();
+    size_t repaired = 0;
+
+    out.reserve(out.size() + len + 2);
+    while (p != end) {
+        // Copy nguyên đoạn sạch (kể cả chuỗi multi-byte hợp lệ)
+        const unsigned char* runStart = p;
+        for (;;) {
+            p += cleanPrefixLength(p, end);
+            if (p == end || *p < 0x80) break;
+            const size_t seq = validUTF8Sequence(p, end);
+            if (seq == 0) break;
+            p += seq;
+        }
+        out.append(reinterpret_cast<const char*>(runStart), static_cast<size_t>(p - runStart));
+        if (p == end) break;
+
+        if (*p == '\'') {
+            out.append("''", 2);
+        } else {
+            // NUL hoặc byte UTF-8 lỗi → PostgreSQL sẽ reject cả batch
+            appendRepairedByte(out, *p, policy);
+            ++repaired;
+        }
+        ++p;
+    }
+
+    if (repaired > 0) {
+        static const char* const POLICY_NAMES[] = {"replace", "drop", "hex"};
+        MetricsExporter::getInstance().incrementCounter("utf8_repaired_total",
+            {{"policy", POLICY_NAMES[static_cast<size_t>(policy)]}}, static_cast<int>(repaired));
+    }
+    return repaired;
+}
+
+void SQLUtils::appendQuoted(std::string& out, const char* str, size_t len) {
+    out += '\'';
+    appendEscaped(out, str, len);
+    out += '\'';
+}
+
 std::string SQLUtils::escapeString(const std::string& input) {
     std::string result;
-    result.reserve(input.size() + 10);
-    for (char c : input) {
-        if (c == '\'') result += "''";
-        else result += c;
-    }
+    appendEscaped(result, input.data(), input.size());
     return result;
 }
 
 std::string SQLUtils::quoteString(const std::string& input) {
-    return "'" + escapeString(input) + "'";
+    std::string result;
+    appendQuoted(result, input.data(), input.size());
+    return result;
 }
 
 std::string SQLUtils::extractTableFromInsert(const std::string& sql) {
@@ -276,69 +404,10 @@ std::string SQLUtils::safeConvertPostgreSQL(
     int timestamp_unit)
 {
     (void)useISO8601ForDebug;
-
-    // ✅ Fix 1: detect null đúng
-    if (val.IsNull() || (val.IsString() && (
-            val.GetString() == std::string("NULL") ||
-            val.GetString() == std::string("null") ||
-            val.GetString() == std::string("")))) {
-        return "NULL";
-    }
-
-    const std::string& dataType = colInfo.dataType;
-
-    try {
-        if (dataType == "timestamp" || dataType == "timestamp without time zone") {
-            int64_t microsec = extractMicroseconds(val, timestamp_unit);
-
-            // ✅ Fix 2: skip timestamp = 0
-            if (microsec == 0) {
-                OpenSync::Logger::debug("⛔ Skipping timestamp=0 (NULL?) at " + tableName + "." + colName);
-                return "NULL";
-            }
-
-            constexpr int64_t MIN_US = -3786825600000000;
-            constexpr int64_t MAX_US = 4102444800000000;
-            if (microsec < MIN_US || microsec > MAX_US) {
-                std::string formatted = TimeUtils::convertMicrosecondsToTimestamp(microsec);
-                OpenSync::Logger::debug("⛔ Out-of-range timestamp: " + formatted + " at " + tableName + "." + colName);
-                return "NULL";
-            }
-
-            std::string formatted = TimeUtils::convertMicrosecondsToTimestamp(microsec);
-            return "'" + formatted + "'";
-        }
-
-        if (dataType == "date") {
-            int64_t microsec = extractMicroseconds(val, timestamp_unit);
-            if (microsec == 0) return "NULL";
-            std::string formatted = TimeUtils::convertMicrosecondsToDate(microsec);
-            return "'" + formatted + "'";
-        }
-
-        if (dataType.find("char") != std::string::npos || dataType == "text") {
-            return val.IsString() ? quoteString(val.GetString()) : quoteString("?");
-        }
-
-        if (dataType.find("int") != std::string::npos || dataType.find("numeric") != std::string::npos ||
-            dataType.find("float") != std::string::npos || dataType.find("double") != std::string::npos) {
-            if (val.IsNumber()) return std::to_string(val.GetDouble());
-            if (val.IsString()) return val.GetString();
-            return "NULL";
-        }
-
-        if (val.IsString()) return quoteString(val.GetString());
-
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        val.Accept(writer);
-        return quoteString(buffer.GetString());
-
-    } catch (const std::exception& ex) {
-        OpenSync::Logger::warn("[PG] Failed to convert value for " + tableName + "." + colName +
-                               " with type=" + dataType + ": " + ex.what());
-        return "NULL";
-    }
+    ColumnConversionPlan plan(tableName, {ColumnConversion::forPostgreSQL(tableName, colName, colInfo)}, 0, true);
+    std::string out;
+    plan.appendValue(out, 0, val, timestamp_unit);
+    return out;
 }
 
 std::string SQLUtils::toLower(const std::string& input) {
@@ -361,7 +430,14 @@ std::string SQLUtils::buildPostgreSQLUpsertSQL(
     const std::string& fullTable,
     const rapidjson::Value& jsonObj)
 {
-    const auto& pkCols = PostgreSQLSchemaCache::getInstance().getPrimaryKeys(fullTable);
+    return buildPostgreSQLUpsertSQL(fullTable, jsonObj, PostgreSQLSchemaCache::getInstance().getPrimaryKeys(fullTable));
+}
+
+std::string SQLUtils::buildPostgreSQLUpsertSQL(
+    const std::string& fullTable,
+    const rapidjson::Value& jsonObj,
+    const std::vector<std::string>& pkCols)
+{
     if (pkCols.empty()) {
 	OpenSync::Logger::warn("⚠️ Cannot build UPSERT SQL: missing primary key for table " + fullTable);
         return "";
@@ -385,8 +461,13 @@ std::string SQLUtils::buildPostgreSQLUpsertSQL(
     sql << "INSERT INTO " << fullTable << " ("
         << SQLUtils::join(cols, ", ") << ") VALUES ("
         << SQLUtils::join(values, ", ") << ")"
-        << " ON CONFLICT (" << SQLUtils::join(pkCols, ", ") << ") DO UPDATE SET "
-        << SQLUtils::join(updates, ", ");
+        << " ON CONFLICT (" << SQLUtils::join(pkCols, ", ") << ")";
+    // "DO UPDATE SET" rỗng là lỗi cú pháp: row chỉ gồm cột khóa thì đã tồn tại là xong
+    if (updates.empty()) {
+        sql << " DO NOTHING";
+    } else {
+        sql << " DO UPDATE SET " << SQLUtils::join(updates, ", ");
+    }
 
     return sql.str();
 }
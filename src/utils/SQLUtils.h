@@ -2,10 +2,18 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <rapidjson/document.h>
 #include "../schema/OracleColumnInfo.h"
 #include "../schema/PostgreSQLColumnInfo.h"
 
+// Xử lý byte UTF-8 không hợp lệ (và NUL) trong text value
+enum class UTF8RepairPolicy : uint8_t {
+    REPLACE = 0,   // U+FFFD
+    DROP = 1,      // bỏ byte lỗi
+    HEX = 2        // \xNN
+};
+
 class SQLUtils {
 public:
     static std::string convertToSQLValue(const rapidjson::Value& val);
@@ -13,6 +21,11 @@ public:
 
     static bool isPostgreSQLTimestampOutOfRange(const std::string& timestampStr);
 
+    // [+-]digits[.digits][(e|E)[+-]digits] → có thể đưa thẳng vào SQL không cần quote
+    static bool isNumericLiteral(const char* str, size_t len);
+    // Append số JSON (int64/uint64/double) bằng std::to_chars: double ở dạng ngắn nhất round-trip
+    static void appendNumber(std::string& out, const rapidjson::Value& val);
+
     static std::string convertToSQLValueWithType(
         const rapidjson::Value& val,
         const std::string& dbType,
@@ -53,6 +66,17 @@ public:
     static std::string escapeString(const std::string& input);
     static std::string quoteString(const std::string& input);
 
+    // Nhân đôi ' và validate UTF-8 trong cùng một lượt (SSE2 bỏ qua các đoạn byte sạch);
+    // byte lỗi được sửa theo UTF8RepairPolicy thay vì làm hỏng cả batch. Trả về số byte đã sửa.
+    static size_t appendEscaped(std::string& out, const char* str, size_t len);
+    // '...' bao quanh appendEscaped
+    static void appendQuoted(std::string& out, const char* str, size_t len);
+
+    static void setUTF8RepairPolicy(UTF8RepairPolicy policy);
+    static UTF8RepairPolicy getUTF8RepairPolicy();
+    // "replace" | "drop" | "hex"; giá trị khác → REPLACE
+    static UTF8RepairPolicy parseUTF8RepairPolicy(const std::string& name);
+
     static int64_t extractMicroseconds(const rapidjson::Value& val, int timestamp_unit);
     static std::string extractTableFromInsert(const std::string& sql);
     static std::string convertToISO8601(const rapidjson::Value& val);
@@ -71,6 +95,9 @@ public:
     static std::string toUpper(const std::string& input);
 
     static std::string buildPostgreSQLUpsertSQL(const std::string& fullTable, const rapidjson::Value& jsonObj);
+    // conflictKeys: cột ON CONFLICT (lowercase, có thể nhiều cột); row chỉ có cột khóa → DO NOTHING
+    static std::string buildPostgreSQLUpsertSQL(const std::string& fullTable, const rapidjson::Value& jsonObj,
+                                                const std::vector<std::string>& conflictKeys);
     static std::string join(const std::vector<std::string>& vec, const std::string& delimiter);
 
 
@@ -0,0 +1,108 @@
+#include "ThreadPlacement.h"
+#include "../reader/ConfigLoader.h"
+#include "../logger/Logger.h"
+#include "../metrics/MetricsExporter.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <cerrno>
+#include <cstring>
+
+ThreadPlacement& ThreadPlacement::getInstance() {
+    static ThreadPlacement instance;
+    return instance;
+}
+
+std::vector<int> ThreadPlacement::parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos) comma = text.size();
+        const std::string part = text.substr(start, comma - start);
+        start = comma + 1;
+
+        try {
+            const size_t dash = part.find('-');
+            if (dash == std::string::npos) {
+                if (!part.empty()) cpus.push_back(std::stoi(part));
+            } else {
+                const int first = std::stoi(part.substr(0, dash));
+                const int last = std::stoi(part.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+            }
+        } catch (...) {
+            OpenSync::Logger::warn("⚠️ Invalid CPU list entry '" + part + "' in \"" + text + "\"");
+        }
+    }
+    return cpus;
+}
+
+void ThreadPlacement::configure(const ConfigLoader& config) {
+    numaLocalAlloc = config.getBool("threads.numa_local_alloc", false);
+
+    for (const char* stage : {"kafka_consumer", "worker", "db_writer"}) {
+        const std::string prefix = std::string("threads.") + stage;
+        StageConfig cfg;
+        cfg.cpus = parseCpuList(config.getConfig(prefix + ".cpus", ""));
+        cfg.spread = config.getConfig(prefix + ".policy", "spread") != "shared";
+        if (!cfg.cpus.empty()) {
+            OpenSync::Logger::info(std::string("📌 Thread placement: ") + stage + " → " +
+                                   config.getConfig(prefix + ".cpus", "") + (cfg.spread ? " (spread)" : " (shared)"));
+        }
+        stages[stage] = std::move(cfg);
+    }
+}
+
+void ThreadPlacement::apply(const std::string& stage, size_t index) {
+    // Tên thread tối đa 15 ký tự (hiện trong top -H, perf, /proc/<pid>/task/*/comm)
+    std::string name = stage.substr(0, 10) + "-" + std::to_string(index);
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+    std::string cpuLabel = "any";
+    auto it = stages.find(stage);
+    if (it != stages.end() && !it->second.cpus.empty()) {
+        const auto& cpus = it->second.cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (it->second.spread) {
+            const int cpu = cpus[index % cpus.size()];
+            CPU_SET(cpu, &set);
+            cpuLabel = std::to_string(cpu);
+        } else {
+            cpuLabel.clear();
+            for (int cpu : cpus) {
+                CPU_SET(cpu, &set);
+                if (!cpuLabel.empty()) cpuLabel += ",";
+                cpuLabel += std::to_string(cpu);
+            }
+        }
+        const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            OpenSync::Logger::warn("⚠️ pthread_setaffinity_np failed for " + name + ": " + std::strerror(rc));
+            cpuLabel = "any";
+        }
+    }
+
+    if (numaLocalAlloc) {
+        // Cấp phát theo node của CPU đang chạy (kể cả khi process bị start với --interleave)
+        if (syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) != 0) {
+            OpenSync::Logger::warn("⚠️ set_mempolicy(MPOL_LOCAL) failed for " + name + ": " + std::strerror(errno));
+        }
+    }
+
+    unsigned cpu = 0;
+    unsigned node = 0;
+    syscall(SYS_getcpu, &cpu, &node, nullptr);
+
+    MetricsExporter::getInstance().setGauge("thread_placement", 1, {
+        {"stage", stage},
+        {"thread", name},
+        {"cpus", cpuLabel},
+        {"numa_node", std::to_string(node)}
+    });
+    OpenSync::Logger::info("🧵 " + name + " on cpu " + std::to_string(cpu) + " (node " + std::to_string(node) +
+                           ", allowed: " + cpuLabel + ")");
+}
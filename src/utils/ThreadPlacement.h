@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class ConfigLoader;
+
+// Đặt tên + CPU affinity + NUMA policy cho thread của từng stage theo section "threads" trong config:
+//   "threads": {
+//     "numa_local_alloc": true,
+//     "kafka_consumer": { "cpus": "0" },
+//     "worker":         { "cpus": "1-7",  "policy": "spread" },
+//     "db_writer":      { "cpus": "8-15", "policy": "shared" }
+//   }
+// spread: thread thứ i ghim vào cpus[i % n]; shared: mọi thread của stage chạy trên cả tập cpus.
+// cpus rỗng → không ghim (vẫn đặt tên thread).
+class ThreadPlacement {
+public:
+    static ThreadPlacement& getInstance();
+
+    void configure(const ConfigLoader& config);
+
+    // Gọi ở đầu thread: stage = "kafka_consumer" | "worker" | "db_writer" | ...
+    void apply(const std::string& stage, size_t index);
+
+    // "0-3,8,10-11" → {0,1,2,3,8,10,11}; phần tử sai format bị bỏ qua
+    static std::vector<int> parseCpuList(const std::string& text);
+
+private:
+    ThreadPlacement() = default;
+
+    struct StageConfig {
+        std::vector<int> cpus;
+        bool spread = true;
+    };
+
+    std::unordered_map<std::string, StageConfig> stages;
+    bool numaLocalAlloc = false;
+};
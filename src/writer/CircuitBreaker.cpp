@@ -0,0 +1,137 @@
+#include "CircuitBreaker.h"
+#include "../logger/Logger.h"
+#include "../metrics/MetricsExporter.h"
+#include <algorithm>
+#include <random>
+
+std::atomic<int> CircuitBreaker::openBreakers{0};
+
+CircuitBreaker::CircuitBreaker(std::string dbType, Options options)
+    : dbType(std::move(dbType)), opts(options) {}
+
+CircuitBreaker::~CircuitBreaker() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (current != State::CLOSED) openBreakers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::chrono::milliseconds CircuitBreaker::backoff(int attempt, int baseMs, int maxMs) {
+    thread_local std::mt19937 rng{std::random_device{}()};
+    const int64_t base = std::max(baseMs, 1);
+    const int64_t cap = std::max<int64_t>(std::min<int64_t>(base << std::min(attempt, 20), maxMs), 1);
+    std::uniform_int_distribution<int64_t> dist(cap / 2, cap);
+    return std::chrono::milliseconds(dist(rng));
+}
+
+bool CircuitBreaker::acquire() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        if (stopping) return current == State::CLOSED;
+        if (current == State::CLOSED) return true;
+        if (current == State::HALF_OPEN && !probeInFlight) {
+            probeInFlight = true;
+            return true;
+        }
+        stateChanged.wait(lock);
+    }
+}
+
+bool CircuitBreaker::tryAcquire() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (current == State::CLOSED) return true;
+    if (current == State::HALF_OPEN && !probeInFlight && !stopping) {
+        probeInFlight = true;
+        return true;
+    }
+    return false;
+}
+
+void CircuitBreaker::recordSuccess() {
+    std::lock_guard<std::mutex> lock(mtx);
+    consecutiveFailures = 0;
+    // Success của lần ghi bắt đầu trước khi OPEN không đóng breaker, chỉ lượt ghi thử mới đóng
+    if (current == State::HALF_OPEN && probeInFlight) closeLocked();
+}
+
+void CircuitBreaker::recordFailure(DBExecResult errorClass, const std::string& error) {
+    if (!DBExceptionHelper::isTransient(errorClass)) {
+        recordSuccess();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (current == State::CLOSED) {
+        if (++consecutiveFailures >= std::max(opts.failureThreshold, 1)) openLocked(error);
+    } else if (current == State::HALF_OPEN && probeInFlight) {
+        ++probeAttempt;
+        openLocked(error);
+    }
+}
+
+void CircuitBreaker::openLocked(const std::string& reason) {
+    const auto now = Clock::now();
+    if (current == State::CLOSED) {
+        openBreakers.fetch_add(1, std::memory_order_relaxed);
+        openedAt = now;
+        probeAttempt = 0;
+        MetricsExporter::getInstance().incrementCounter("db_circuit_breaker_trips_total", {{"db_type", dbType}});
+        OpenSync::Logger::error("🚧 Circuit breaker [" + dbType + "] OPEN after " + std::to_string(consecutiveFailures) +
+                                " consecutive transient failures: " + reason +
+                                " — holding batches and pausing consumption");
+    } else {
+        OpenSync::Logger::warn("🚧 Circuit breaker [" + dbType + "] probe write failed, staying OPEN: " + reason);
+    }
+    current = State::OPEN;
+    probeInFlight = false;
+    nextProbeAt = now + backoff(probeAttempt, opts.probeIntervalMs, opts.maxProbeIntervalMs);
+}
+
+void CircuitBreaker::closeLocked() {
+    const auto openMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - openedAt).count();
+    current = State::CLOSED;
+    probeInFlight = false;
+    probeAttempt = 0;
+    consecutiveFailures = 0;
+    openBreakers.fetch_sub(1, std::memory_order_relaxed);
+    MetricsExporter::getInstance().setGauge("db_circuit_breaker_last_open_ms", static_cast<double>(openMs),
+                                            {{"db_type", dbType}});
+    OpenSync::Logger::info("✅ Circuit breaker [" + dbType + "] CLOSED after " + std::to_string(openMs) + " ms");
+    stateChanged.notify_all();
+}
+
+bool CircuitBreaker::probeDue(Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return current == State::OPEN && now >= nextProbeAt;
+}
+
+void CircuitBreaker::probeSucceeded() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (current != State::OPEN) return;
+    current = State::HALF_OPEN;
+    probeInFlight = false;
+    OpenSync::Logger::info("🔌 Circuit breaker [" + dbType + "] HALF_OPEN: reconnected, trying one batch");
+    stateChanged.notify_all();
+}
+
+void CircuitBreaker::probeFailed() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (current != State::OPEN) return;
+    ++probeAttempt;
+    nextProbeAt = Clock::now() + backoff(probeAttempt, opts.probeIntervalMs, opts.maxProbeIntervalMs);
+}
+
+void CircuitBreaker::stop() {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+    stateChanged.notify_all();
+}
+
+CircuitBreaker::State CircuitBreaker::state() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return current;
+}
+
+void CircuitBreaker::reportMetrics() const {
+    // 0 = CLOSED, 1 = OPEN, 2 = HALF_OPEN
+    MetricsExporter::getInstance().setGauge("db_circuit_breaker_state", static_cast<double>(state()),
+                                            {{"db_type", dbType}});
+}
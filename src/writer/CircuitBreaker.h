@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include "../db/DBException.h"
+
+// Circuit breaker cho một db type. Lỗi tạm thời (CONNECTION_LOST / TIMEOUT) liên tiếp tới ngưỡng → OPEN:
+// DB writer giữ batch và chờ thay vì ghi / connect liên tục, consumer pause partition (anyOpen()).
+// Chỉ thread reconnect nền của WriteDataToDB thử mở lại connection, theo backoff; mở được → HALF_OPEN,
+// đúng một writer ghi thử: thành công → CLOSED, lỗi tạm thời → OPEN với backoff dài hơn.
+class CircuitBreaker {
+public:
+    enum class State { CLOSED, OPEN, HALF_OPEN };
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        int failureThreshold = 5;           // số lần ghi lỗi tạm thời liên tiếp để OPEN
+        int probeIntervalMs = 1000;         // khoảng chờ đầu tiên trước khi reconnect nền
+        int maxProbeIntervalMs = 30000;     // khoảng chờ tối đa giữa các lần reconnect nền
+    };
+
+    CircuitBreaker(std::string dbType, Options options);
+    ~CircuitBreaker();
+
+    CircuitBreaker(const CircuitBreaker&) = delete;
+    CircuitBreaker& operator=(const CircuitBreaker&) = delete;
+
+    // Chờ tới khi được ghi (CLOSED, hoặc lượt ghi thử khi HALF_OPEN).
+    // Sau stop(): không chờ nữa, chỉ true khi đang CLOSED
+    bool acquire();
+    // Như acquire() nhưng không chờ (event loop của AsyncPgWriter): false thì thử lại ở vòng sau
+    bool tryAcquire();
+    void recordSuccess();
+    // Chỉ lỗi tạm thời được tính; lỗi dữ liệu nghĩa là DB vẫn trả lời → như success
+    void recordFailure(DBExecResult errorClass, const std::string& error);
+
+    // Thread reconnect nền
+    bool probeDue(Clock::time_point now) const;
+    void probeSucceeded();      // OPEN → HALF_OPEN
+    void probeFailed();         // lùi lần thử kế tiếp
+
+    // Shutdown: thả các writer đang chờ
+    void stop();
+
+    State state() const;
+    const std::string& type() const { return dbType; }
+    void reportMetrics() const;
+
+    // Có breaker nào không CLOSED → consumer pause partition thay vì đẩy thêm batch vào queue
+    static bool anyOpen() { return openBreakers.load(std::memory_order_relaxed) > 0; }
+
+    // Exponential backoff có jitter: ngẫu nhiên trong [cap/2, cap], cap = min(maxMs, baseMs * 2^attempt),
+    // để các writer / instance không retry cùng một nhịp sau failover
+    static std::chrono::milliseconds backoff(int attempt, int baseMs, int maxMs);
+
+private:
+    void openLocked(const std::string& reason);
+    void closeLocked();
+
+    const std::string dbType;
+    const Options opts;
+
+    mutable std::mutex mtx;
+    std::condition_variable stateChanged;
+    State current = State::CLOSED;
+    int consecutiveFailures = 0;
+    int probeAttempt = 0;
+    bool probeInFlight = false;
+    bool stopping = false;
+    Clock::time_point openedAt{};
+    Clock::time_point nextProbeAt{};
+
+    static std::atomic<int> openBreakers;
+};
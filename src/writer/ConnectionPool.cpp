@@ -0,0 +1,290 @@
+#include "ConnectionPool.h"
+#include "../logger/Logger.h"
+#include "../metrics/MetricsExporter.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+ConnectionPool::ConnectionPool(std::string dbType, Factory factory, Options options)
+    : dbType(std::move(dbType)), factory(std::move(factory)), opts(options) {}
+
+ConnectionPool::~ConnectionPool() {
+    std::deque<IdleConnection> closing;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closing.swap(idle);
+    }
+}
+
+std::unique_ptr<DBConnector> ConnectionPool::openConnection() {
+    auto connector = factory();
+    if (!connector || !connector->connect()) {
+        OpenSync::Logger::error("❌ Connection pool [" + dbType + "]: failed to open connection");
+        return nullptr;
+    }
+    MetricsExporter::getInstance().incrementCounter("db_pool_connections_opened_total", {{"db_type", dbType}});
+    return connector;
+}
+
+std::unique_ptr<DBConnector> ConnectionPool::acquire() {
+    const auto start = Clock::now();
+    auto recordWait = [this, start]() {
+        const uint64_t waitedUs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+        checkouts.fetch_add(1, std::memory_order_relaxed);
+        checkoutWaitUs.fetch_add(waitedUs, std::memory_order_relaxed);
+        uint64_t prev = maxCheckoutWaitUs.load(std::memory_order_relaxed);
+        while (waitedUs > prev && !maxCheckoutWaitUs.compare_exchange_weak(prev, waitedUs, std::memory_order_relaxed)) {}
+    };
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        if (!idle.empty()) {
+            IdleConnection entry = std::move(idle.back());
+            idle.pop_back();
+            lock.unlock();
+
+            // Chỉ ping connection đã lâu không được kiểm tra, còn lại tin trạng thái local
+            const bool stale = Clock::now() - entry.lastChecked >= std::chrono::seconds(opts.healthCheckIntervalSec);
+            if (stale ? entry.connector->ping() : entry.connector->isConnected()) {
+                recordWait();
+                return std::move(entry.connector);
+            }
+
+            failedChecks.fetch_add(1, std::memory_order_relaxed);
+            OpenSync::Logger::warn("⚠️ Connection pool [" + dbType + "]: dropping dead idle connection");
+            entry.connector.reset();
+
+            lock.lock();
+            --total;
+            released.notify_one();
+            continue;
+        }
+
+        if (opts.maxTotal == 0 || total < opts.maxTotal) {
+            ++total;
+            lock.unlock();
+
+            auto connector = openConnection();
+            if (!connector) {
+                lock.lock();
+                --total;
+                released.notify_one();
+                return nullptr;
+            }
+            recordWait();
+            return connector;
+        }
+
+        const auto deadline = start + std::chrono::milliseconds(opts.checkoutTimeoutMs);
+        if (!released.wait_until(lock, deadline, [this]() { return !idle.empty() || total < opts.maxTotal; })) {
+            OpenSync::Logger::error("❌ Connection pool [" + dbType + "]: checkout timed out after " +
+                                    std::to_string(opts.checkoutTimeoutMs) + " ms (" + std::to_string(total) +
+                                    " connections in use)");
+            MetricsExporter::getInstance().incrementCounter("db_pool_checkout_timeouts_total", {{"db_type", dbType}});
+            return nullptr;
+        }
+    }
+}
+
+void ConnectionPool::release(std::unique_ptr<DBConnector> connector, bool healthy) {
+    if (!connector) return;
+
+    const bool keep = healthy && connector->isConnected();
+    std::unique_ptr<DBConnector> closing;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (keep && idle.size() < opts.maxIdle) {
+            const auto now = Clock::now();
+            idle.push_back({std::move(connector), now, now});
+        } else {
+            closing = std::move(connector);
+            --total;
+        }
+    }
+    released.notify_one();
+}
+
+size_t ConnectionPool::warmUp(size_t count) {
+    size_t toOpen = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        const size_t idleRoom = opts.maxIdle > idle.size() ? opts.maxIdle - idle.size() : 0;
+        toOpen = std::min(count, idleRoom);
+        if (opts.maxTotal > 0) toOpen = std::min(toOpen, opts.maxTotal > total ? opts.maxTotal - total : 0);
+        total += toOpen;
+    }
+    if (toOpen == 0) return 0;
+
+    // Connect song song: thời gian khởi động ~ một lần handshake thay vì toOpen lần
+    const auto start = Clock::now();
+    std::vector<std::unique_ptr<DBConnector>> opened(toOpen);
+    std::vector<std::thread> threads;
+    threads.reserve(toOpen);
+    for (size_t i = 0; i < toOpen; ++i) {
+        threads.emplace_back([this, &opened, i]() { opened[i] = openConnection(); });
+    }
+    for (auto& t : threads) t.join();
+
+    size_t ready = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        const auto now = Clock::now();
+        for (auto& connector : opened) {
+            if (connector) {
+                idle.push_back({std::move(connector), now, now});
+                ++ready;
+            } else {
+                --total;
+            }
+        }
+    }
+    released.notify_all();
+
+    const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    OpenSync::Logger::info("🔥 Connection pool [" + dbType + "]: warmed up " + std::to_string(ready) + "/" +
+                           std::to_string(toOpen) + " connections in " + std::to_string(elapsedMs) + " ms");
+    return ready;
+}
+
+void ConnectionPool::maintain() {
+    std::vector<IdleConnection> expired;
+    std::vector<IdleConnection> toCheck;
+    const auto now = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::deque<IdleConnection> keep;
+        for (auto& entry : idle) {
+            if (opts.idleTimeoutSec > 0 && now - entry.lastUsed >= std::chrono::seconds(opts.idleTimeoutSec)) {
+                expired.push_back(std::move(entry));
+                --total;
+            } else if (now - entry.lastChecked >= std::chrono::seconds(opts.healthCheckIntervalSec)) {
+                toCheck.push_back(std::move(entry));
+            } else {
+                keep.push_back(std::move(entry));
+            }
+        }
+        idle.swap(keep);
+    }
+
+    if (!expired.empty()) {
+        OpenSync::Logger::info("🧹 Connection pool [" + dbType + "]: closing " + std::to_string(expired.size()) +
+                               " idle connections");
+        expired.clear();
+    }
+
+    // Ping ngoài lock: thread khác vẫn lấy / trả connection được
+    size_t dead = 0;
+    for (auto& entry : toCheck) {
+        if (entry.connector->ping()) {
+            entry.lastChecked = Clock::now();
+        } else {
+            entry.connector.reset();
+            ++dead;
+        }
+    }
+    if (dead) {
+        failedChecks.fetch_add(dead, std::memory_order_relaxed);
+        OpenSync::Logger::warn("⚠️ Connection pool [" + dbType + "]: " + std::to_string(dead) +
+                               " idle connections failed health check");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // Connection vừa ping đặt ở đầu (ít được ưu tiên hơn connection vừa trả)
+        for (auto& entry : toCheck) {
+            if (entry.connector && idle.size() < opts.maxIdle) {
+                idle.push_front(std::move(entry));
+            } else {
+                --total;
+            }
+        }
+    }
+    toCheck.clear();
+    released.notify_all();
+}
+
+bool ConnectionPool::recover() {
+    std::deque<IdleConnection> checking;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        checking.swap(idle);
+    }
+
+    if (checking.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (opts.maxTotal > 0 && total >= opts.maxTotal) return false;
+            ++total;
+        }
+        auto connector = openConnection();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!connector) {
+            --total;
+            return false;
+        }
+        const auto now = Clock::now();
+        idle.push_back({std::move(connector), now, now});
+        released.notify_one();
+        return true;
+    }
+
+    size_t alive = 0;
+    size_t dropped = 0;
+    bool failed = false;
+    for (auto& entry : checking) {
+        if (failed) break;
+        if (entry.connector->ping() || entry.connector->reconnect()) {
+            entry.lastChecked = Clock::now();
+            ++alive;
+        } else {
+            entry.connector.reset();
+            ++dropped;
+            failed = true;
+        }
+    }
+    if (dropped) failedChecks.fetch_add(dropped, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // Connection chưa kiểm tra giữ nguyên lastChecked: acquire() sẽ ping trước khi dùng
+        for (auto& entry : checking) {
+            if (entry.connector && idle.size() < opts.maxIdle) {
+                idle.push_back(std::move(entry));
+            } else {
+                --total;
+            }
+        }
+    }
+    checking.clear();
+    released.notify_all();
+
+    OpenSync::Logger::info("🔌 Connection pool [" + dbType + "]: recovery " + (alive ? "succeeded" : "failed") +
+                           " (" + std::to_string(alive) + " connections alive)");
+    return alive > 0;
+}
+
+void ConnectionPool::reportMetrics() {
+    size_t totalNow = 0;
+    size_t idleNow = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        totalNow = total;
+        idleNow = idle.size();
+    }
+
+    // Wait time tính theo khoảng giữa hai lần report
+    const uint64_t count = checkouts.exchange(0, std::memory_order_relaxed);
+    const uint64_t waitUs = checkoutWaitUs.exchange(0, std::memory_order_relaxed);
+    const uint64_t maxWaitUs = maxCheckoutWaitUs.exchange(0, std::memory_order_relaxed);
+
+    auto& metrics = MetricsExporter::getInstance();
+    const std::map<std::string, std::string> labels{{"db_type", dbType}};
+    metrics.setGauge("db_connector_pool_size", static_cast<double>(totalNow), labels);
+    metrics.setGauge("db_pool_idle_connections", static_cast<double>(idleNow), labels);
+    metrics.setGauge("db_pool_active_connections", static_cast<double>(totalNow - std::min(idleNow, totalNow)), labels);
+    metrics.setGauge("db_pool_checkouts", static_cast<double>(count), labels);
+    metrics.setGauge("db_pool_checkout_wait_ms_avg", count ? static_cast<double>(waitUs) / count / 1000.0 : 0.0, labels);
+    metrics.setGauge("db_pool_checkout_wait_ms_max", static_cast<double>(maxWaitUs) / 1000.0, labels);
+    metrics.setGauge("db_pool_failed_health_checks", static_cast<double>(failedChecks.load(std::memory_order_relaxed)), labels);
+}
@@ -0,0 +1,83 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include "../db/DBConnector.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Pool connection cho một db type. DB writer giữ connection theo thread (lease trong WriteDataToDB),
+// pool chỉ bị đụng tới khi thread lấy / trả connection: warm-up song song lúc khởi động,
+// kiểm tra liveness (ping) cho connection idle, giới hạn số idle và tổng số connection.
+class ConnectionPool {
+public:
+    using Factory = std::function<std::unique_ptr<DBConnector>()>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        size_t maxIdle = 8;                 // connection idle vượt mức này bị đóng khi trả về
+        size_t maxTotal = 0;                // 0 = không giới hạn; đạt mức này thì acquire() chờ
+        int healthCheckIntervalSec = 30;    // ping connection không dùng lâu hơn khoảng này
+        int idleTimeoutSec = 300;           // connection idle lâu hơn bị đóng (0 = giữ mãi)
+        int checkoutTimeoutMs = 30000;      // chờ tối đa khi pool đầy
+    };
+
+    ConnectionPool(std::string dbType, Factory factory, Options options);
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Connection đã connect và còn sống; nullptr nếu không connect được / hết thời gian chờ
+    std::unique_ptr<DBConnector> acquire();
+    // healthy = false: connection bị đóng thay vì quay lại idle
+    void release(std::unique_ptr<DBConnector> connector, bool healthy = true);
+    // Connection mới chưa connect, không tính vào pool (cloneConnector)
+    std::unique_ptr<DBConnector> create() const { return factory(); }
+
+    // Mở song song tới count connection idle; trả về số connection mở được
+    size_t warmUp(size_t count);
+    // Monitor gọi định kỳ: đóng connection idle quá lâu, ping connection idle quá healthCheckInterval
+    void maintain();
+    // Sau mất kết nối (circuit breaker OPEN): ping / reconnect() lần lượt connection idle, dừng ở lần thất bại
+    // đầu tiên (DB vẫn chưa lên) → mỗi lần thử tốn tối đa một lần connect lỗi; pool rỗng thì mở connection mới.
+    // true nếu có ít nhất một connection dùng được
+    bool recover();
+    // Gauge kích thước pool và thời gian chờ checkout kể từ lần report trước
+    void reportMetrics();
+
+    const std::string& type() const { return dbType; }
+    const Options& options() const { return opts; }
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<DBConnector> connector;
+        Clock::time_point lastUsed;
+        Clock::time_point lastChecked;
+    };
+
+    std::unique_ptr<DBConnector> openConnection();
+
+    const std::string dbType;
+    const Factory factory;
+    const Options opts;
+
+    mutable std::mutex mtx;
+    std::condition_variable released;
+    std::deque<IdleConnection> idle;        // back: vừa trả (nóng nhất)
+    size_t total = 0;                       // idle + đang lease + đang mở
+
+    std::atomic<uint64_t> checkouts{0};
+    std::atomic<uint64_t> checkoutWaitUs{0};
+    std::atomic<uint64_t> maxCheckoutWaitUs{0};
+    std::atomic<uint64_t> failedChecks{0};
+};
+
+#endif // CONNECTION_POOL_H
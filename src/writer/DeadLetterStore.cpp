@@ -0,0 +1,117 @@
+#include "DeadLetterStore.h"
+#include "../logger/Logger.h"
+#include "../metrics/MetricsExporter.h"
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+DeadLetterStore& DeadLetterStore::getInstance() {
+    static DeadLetterStore instance;
+    return instance;
+}
+
+void DeadLetterStore::configure(const std::string& dir, size_t maxFileBytes, const std::string& topic) {
+    std::lock_guard<std::mutex> lock(mtx);
+    this->dir = dir;
+    this->path = dir + "/dead_letter.jsonl";
+    this->topic = topic;
+    this->maxFileBytes = maxFileBytes;
+    if (out.is_open()) out.close();
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+        OpenSync::Logger::error("❌ Cannot create dead-letter dir " + dir + ": " + ec.message());
+        return;
+    }
+    if (openLocked()) {
+        enabled.store(true, std::memory_order_relaxed);
+        OpenSync::Logger::info("🪦 Dead-letter store: " + path);
+    }
+}
+
+bool DeadLetterStore::openLocked() {
+    out.open(path, std::ios::app);
+    if (!out.is_open()) {
+        OpenSync::Logger::error("❌ Cannot open dead-letter file " + path);
+        return false;
+    }
+    std::error_code ec;
+    const auto size = fs::file_size(path, ec);
+    fileBytes = ec ? 0 : static_cast<size_t>(size);
+    return true;
+}
+
+void DeadLetterStore::rotateLocked() {
+    out.close();
+    const auto epoch = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    const std::string rotated = dir + "/dead_letter-" + std::to_string(epoch) + ".jsonl";
+    std::error_code ec;
+    fs::rename(path, rotated, ec);
+    if (ec) OpenSync::Logger::error("❌ Cannot rotate dead-letter file " + path + ": " + ec.message());
+    openLocked();
+}
+
+bool DeadLetterStore::write(const std::string& tableKey, const RowOrigin& origin, const std::string& sql,
+                            DBExecResult errorClass, const std::string& error) {
+    if (!isEnabled()) return false;
+    const std::string errorName = DBExceptionHelper::toString(errorClass);
+    const std::string where = tableKey + " (partition " + std::to_string(origin.partition) +
+                              ", offset " + std::to_string(origin.offset) + ")";
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("ts");
+    writer.String(OpenSync::Logger::getCurrentTimestamp().c_str());
+    writer.Key("table");
+    writer.String(tableKey.c_str(), static_cast<rapidjson::SizeType>(tableKey.size()));
+    writer.Key("topic");
+    writer.String(topic.c_str(), static_cast<rapidjson::SizeType>(topic.size()));
+    writer.Key("partition");
+    writer.Int(origin.partition);
+    writer.Key("offset");
+    writer.Int64(origin.offset);
+    writer.Key("error_class");
+    writer.String(errorName.c_str());
+    writer.Key("error");
+    writer.String(error.c_str(), static_cast<rapidjson::SizeType>(error.size()));
+    writer.Key("sql");
+    writer.String(sql.c_str(), static_cast<rapidjson::SizeType>(sql.size()));
+    writer.EndObject();
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // Lần ghi trước lỗi (đĩa đầy...) → mở lại file
+        if (!out.is_open()) openLocked();
+        if (out.is_open() && maxFileBytes > 0 && fileBytes >= maxFileBytes) rotateLocked();
+
+        bool written = false;
+        if (out.is_open()) {
+            out.write(buffer.GetString(), static_cast<std::streamsize>(buffer.GetSize()));
+            out.put('\n');
+            out.flush();
+            written = static_cast<bool>(out);
+            if (written) {
+                fileBytes += buffer.GetSize() + 1;
+            } else {
+                out.close();
+            }
+        }
+        if (!written) {
+            // Row chưa được giữ ở đâu: caller không được commit batch
+            MetricsExporter::getInstance().incrementCounter("dead_letter_write_errors_total", {{"table", tableKey}});
+            OpenSync::Logger::error("❌ Failed to write dead-letter file " + path + ", row of " + where +
+                                    " not dead-lettered: " + error);
+            return false;
+        }
+    }
+
+    MetricsExporter::getInstance().incrementCounter("dead_letter_rows_total", {{"table", tableKey}, {"error", errorName}});
+    OpenSync::Logger::error("🪦 Dead-lettered row of " + where + ": " + error + " | SQL: " + sql);
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include "../common/TableBatch.h"
+#include "../db/DBException.h"
+
+// Row bị cô lập là nguyên nhân làm hỏng batch (sau khi chia đôi batch và ghi lại) được ghi ra file JSONL cục bộ:
+// một dòng mỗi row gồm bảng, vị trí Kafka, SQL và lỗi, để phần còn lại của batch commit được.
+// File xoay vòng khi vượt maxFileBytes (dead_letter-<epoch>.jsonl).
+class DeadLetterStore {
+public:
+    static DeadLetterStore& getInstance();
+
+    // Gọi trước khi start DB writer; chưa configure thì không cô lập row (batch lỗi bị bỏ như trước)
+    void configure(const std::string& dir, size_t maxFileBytes, const std::string& topic);
+
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // true chỉ khi row đã nằm trong file (đã flush); false: row không được giữ, caller không được commit batch
+    bool write(const std::string& tableKey, const RowOrigin& origin, const std::string& sql,
+               DBExecResult errorClass, const std::string& error);
+
+private:
+    DeadLetterStore() = default;
+
+    bool openLocked();
+    void rotateLocked();
+
+    std::mutex mtx;
+    std::string dir;
+    std::string path;
+    std::string topic;
+    size_t maxFileBytes = 0;
+    size_t fileBytes = 0;
+    std::ofstream out;
+    std::atomic<bool> enabled{false};
+};
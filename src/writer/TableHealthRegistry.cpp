@@ -0,0 +1,405 @@
+#include "TableHealthRegistry.h"
+#include "CircuitBreaker.h"
+#include "../logger/Logger.h"
+#include "../metrics/MetricsExporter.h"
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+TableHealthRegistry& TableHealthRegistry::getInstance() {
+    static TableHealthRegistry instance;
+    return instance;
+}
+
+void TableHealthRegistry::configure(const std::string& holdDir, const Options& options) {
+    std::error_code ec;
+    fs::create_directories(holdDir, ec);
+    if (ec) {
+        OpenSync::Logger::error("❌ Cannot create quarantine hold dir " + holdDir + ": " + ec.message());
+        return;
+    }
+
+    std::vector<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(mapMutex);
+        this->holdDir = holdDir;
+        opts = options;
+        opts.replayBatchSize = std::max<size_t>(opts.replayBatchSize, 1);
+
+        // File hold (và .replay của probe dừng giữa chừng) còn lại từ lần chạy trước: bảng vẫn quarantine
+        // tới khi probe ghi lại hết, dữ liệu mới không được vượt lên trước dữ liệu đang giữ
+        for (const auto& file : fs::directory_iterator(holdDir, ec)) {
+            std::string name = file.path().filename().string();
+            for (const std::string suffix : {".jsonl.replay", ".jsonl"}) {
+                if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                    name.resize(name.size() - suffix.size());
+                    auto& e = entries[name];
+                    if (!e) e = std::make_unique<Entry>();
+                    if (e->state != State::QUARANTINED) {
+                        e->state = State::QUARANTINED;
+                        e->nextProbeAt = Clock::now();
+                        quarantined.fetch_add(1, std::memory_order_relaxed);
+                        pending.push_back(name);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    enabled.store(true, std::memory_order_relaxed);
+
+    OpenSync::Logger::info("🩺 Table health: degraded after " + std::to_string(opts.degradedAfterFailures) +
+                           " failed batches, quarantined after " + std::to_string(opts.quarantineAfterFailures) +
+                           ", hold dir " + holdDir);
+    for (const auto& tableKey : pending) {
+        OpenSync::Logger::warn("🚫 Table " + tableKey + " still has held batches from a previous run, kept in quarantine");
+    }
+}
+
+TableHealthRegistry::Entry& TableHealthRegistry::entry(const std::string& tableKey) {
+    std::lock_guard<std::mutex> lock(mapMutex);
+    auto& e = entries[tableKey];
+    if (!e) {
+        e = std::make_unique<Entry>();
+        auto it = overrides.find(tableKey);
+        if (it != overrides.end()) e->override = it->second;
+        if (e->override == Override::FORCE_QUARANTINE) {
+            e->state = State::QUARANTINED;
+            quarantined.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return *e;
+}
+
+TableHealthRegistry::Entry* TableHealthRegistry::find(const std::string& tableKey) const {
+    std::lock_guard<std::mutex> lock(mapMutex);
+    auto it = entries.find(tableKey);
+    return it != entries.end() ? it->second.get() : nullptr;
+}
+
+std::string TableHealthRegistry::holdPath(const std::string& tableKey) const {
+    std::string name = tableKey;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return holdDir + "/" + name + ".jsonl";
+}
+
+void TableHealthRegistry::scheduleProbeLocked(Entry& e) {
+    e.nextProbeAt = Clock::now() + CircuitBreaker::backoff(e.probeAttempt, opts.probeIntervalSec * 1000,
+                                                           opts.maxProbeIntervalSec * 1000);
+}
+
+void TableHealthRegistry::quarantineLocked(const std::string& tableKey, Entry& e, const std::string& reason) {
+    if (e.state != State::QUARANTINED) quarantined.fetch_add(1, std::memory_order_relaxed);
+    e.state = State::QUARANTINED;
+    e.probeAttempt = 0;
+    scheduleProbeLocked(e);
+    MetricsExporter::getInstance().incrementCounter("table_quarantine_total", {{"table", tableKey}});
+    OpenSync::Logger::error("🚫 Table " + tableKey + " QUARANTINED (" + reason + "): batches are held in " +
+                            holdPath(tableKey) + " until a probe succeeds");
+}
+
+void TableHealthRegistry::recoverLocked(const std::string& tableKey, Entry& e) {
+    if (e.state == State::QUARANTINED) quarantined.fetch_sub(1, std::memory_order_relaxed);
+    e.state = State::HEALTHY;
+    e.consecutiveFailures = 0;
+    e.probeAttempt = 0;
+    e.heldRows = 0;
+    OpenSync::Logger::info("✅ Table " + tableKey + " recovered from quarantine, held batches replayed");
+}
+
+void TableHealthRegistry::recordSuccess(const std::string& tableKey) {
+    if (!isEnabled()) return;
+    Entry& e = entry(tableKey);
+    std::lock_guard<std::mutex> lock(e.mtx);
+
+    // Batch bị giữ cũng đi qua finishApplyTask với success = true: chỉ probe đưa bảng ra khỏi quarantine
+    if (e.state == State::QUARANTINED) return;
+
+    if (e.state == State::DEGRADED) OpenSync::Logger::info("✅ Table " + tableKey + " healthy again");
+    e.state = State::HEALTHY;
+    e.consecutiveFailures = 0;
+}
+
+TableHealthRegistry::FailureAction TableHealthRegistry::recordFailure(const std::string& tableKey, const TableBatch& batch) {
+    if (!isEnabled()) return FailureAction::GIVE_UP;
+    Entry& e = entry(tableKey);
+    std::lock_guard<std::mutex> lock(e.mtx);
+
+    // Lane khác của bảng đã đưa bảng vào quarantine: batch này vào file hold ngay
+    if (e.state == State::QUARANTINED) {
+        return appendLocked(tableKey, e, batch) ? FailureAction::HELD : FailureAction::GIVE_UP;
+    }
+
+    // DB down (circuit breaker OPEN) không phải lỗi của riêng bảng này: ghi lại, không tính
+    if (CircuitBreaker::anyOpen()) return FailureAction::RETRY;
+
+    ++e.consecutiveFailures;
+    if (e.consecutiveFailures >= opts.quarantineAfterFailures) {
+        if (e.override == Override::NEVER_QUARANTINE) return FailureAction::GIVE_UP;
+        // Chính batch tới ngưỡng là dòng đầu của file hold: không batch nào của bảng vượt lên trước nó
+        if (!appendLocked(tableKey, e, batch)) return FailureAction::GIVE_UP;
+        quarantineLocked(tableKey, e, std::to_string(e.consecutiveFailures) + " consecutive failed writes");
+        return FailureAction::HELD;
+    }
+    if (e.state == State::HEALTHY && e.consecutiveFailures >= opts.degradedAfterFailures) {
+        e.state = State::DEGRADED;
+        OpenSync::Logger::warn("⚠️ Table " + tableKey + " DEGRADED after " + std::to_string(e.consecutiveFailures) +
+                               " consecutive failed writes");
+    }
+    return FailureAction::RETRY;
+}
+
+bool TableHealthRegistry::divert(const std::string& tableKey, const TableBatch& batch) {
+    if (quarantined.load(std::memory_order_relaxed) == 0) return false;
+    Entry* e = find(tableKey);
+    if (!e) return false;
+
+    // Probe không giữ lock khi ghi vào DB; lúc probe xác nhận hết file và đưa bảng về HEALTHY thì batch này
+    // chờ lock rồi ghi thẳng vào DB, sau dữ liệu đã giữ
+    std::lock_guard<std::mutex> lock(e->mtx);
+    if (e->state != State::QUARANTINED) return false;
+    return appendLocked(tableKey, *e, batch);
+}
+
+bool TableHealthRegistry::appendLocked(const std::string& tableKey, Entry& e, const TableBatch& batch) {
+    const std::string path = holdPath(tableKey);
+    std::ofstream out(path, std::ios::app);
+    if (!out.is_open()) {
+        OpenSync::Logger::error("❌ Cannot open quarantine hold file " + path);
+        return false;
+    }
+
+    rapidjson::StringBuffer buffer;
+    for (size_t i = 0; i < batch.sqls.size(); ++i) {
+        const RowOrigin origin = i < batch.origins.size() ? batch.origins[i] : RowOrigin{};
+        const std::string& sql = batch.sqls[i];
+        buffer.Clear();
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("partition");
+        writer.Int(origin.partition);
+        writer.Key("offset");
+        writer.Int64(origin.offset);
+        writer.Key("sql");
+        writer.String(sql.c_str(), static_cast<rapidjson::SizeType>(sql.size()));
+        writer.EndObject();
+        out.write(buffer.GetString(), static_cast<std::streamsize>(buffer.GetSize()));
+        out.put('\n');
+    }
+    out.flush();
+    if (!out) {
+        // Batch chưa chắc nằm trọn trong file: ghi vào DB như bình thường (lỗi thì offset không commit)
+        OpenSync::Logger::error("❌ Failed to write quarantine hold file " + path);
+        return false;
+    }
+
+    e.heldRows += batch.sqls.size();
+    MetricsExporter::getInstance().incrementCounter("table_quarantine_held_rows_total", {{"table", tableKey}},
+                                                    static_cast<int>(batch.sqls.size()));
+    return true;
+}
+
+TableHealthRegistry::Override TableHealthRegistry::parseOverride(const std::string& value) {
+    if (value == "on" || value == "force" || value == "quarantine") return Override::FORCE_QUARANTINE;
+    if (value == "off" || value == "never") return Override::NEVER_QUARANTINE;
+    return Override::AUTO;
+}
+
+void TableHealthRegistry::setOverrides(const std::unordered_map<std::string, Override>& newOverrides) {
+    std::lock_guard<std::mutex> lock(mapMutex);
+    overrides = newOverrides;
+    for (const auto& [tableKey, override] : overrides) {
+        auto& e = entries[tableKey];
+        if (!e) e = std::make_unique<Entry>();
+    }
+
+    for (auto& [tableKey, e] : entries) {
+        auto it = overrides.find(tableKey);
+        const Override next = it != overrides.end() ? it->second : Override::AUTO;
+
+        std::lock_guard<std::mutex> entryLock(e->mtx);
+        if (e->override == next) continue;
+        e->override = next;
+
+        if (next == Override::FORCE_QUARANTINE) {
+            if (e->state != State::QUARANTINED) quarantineLocked(tableKey, *e, "forced by filter config");
+        } else if (e->state == State::QUARANTINED) {
+            // Thả bảng: probe ngay để ghi lại dữ liệu đang giữ trước dữ liệu mới
+            e->probeAttempt = 0;
+            e->nextProbeAt = Clock::now();
+            OpenSync::Logger::info("🔓 Table " + tableKey + " released by filter config, replaying held batches");
+        }
+    }
+}
+
+std::vector<std::string> TableHealthRegistry::dueForProbe(Clock::time_point now) {
+    std::vector<std::string> due;
+    if (quarantined.load(std::memory_order_relaxed) == 0) return due;
+
+    std::lock_guard<std::mutex> lock(mapMutex);
+    for (auto& [tableKey, e] : entries) {
+        std::lock_guard<std::mutex> entryLock(e->mtx);
+        if (e->state == State::QUARANTINED && e->override != Override::FORCE_QUARANTINE && now >= e->nextProbeAt) {
+            due.push_back(tableKey);
+        }
+    }
+    return due;
+}
+
+bool TableHealthRegistry::probe(const std::string& tableKey, const ApplyFn& apply) {
+    Entry* e = find(tableKey);
+    if (!e) return false;
+
+    const std::string path = holdPath(tableKey);
+    const std::string replayPath = path + ".replay";
+    size_t replayed = 0;
+
+    for (int round = 0;; ++round) {
+        {
+            std::lock_guard<std::mutex> lock(e->mtx);
+            if (e->state != State::QUARANTINED || e->override == Override::FORCE_QUARANTINE) return false;
+
+            // .replay của lần probe trước (dừng giữa chừng) cũ hơn file hold → ghi lại trước
+            std::error_code ec;
+            if (!fs::exists(replayPath, ec)) {
+                if (!fs::exists(path, ec)) {
+                    // Hết dữ liệu giữ; divert chờ lock này nên không batch nào lọt vào giữa
+                    if (replayed > 0) OpenSync::Logger::info("🩺 Replayed " + std::to_string(replayed) + " held rows of " + tableKey);
+                    recoverLocked(tableKey, *e);
+                    return true;
+                }
+                if (round >= MAX_PROBE_ROUNDS) {
+                    // Dữ liệu mới vào nhanh hơn tốc độ ghi lại: monitor probe tiếp ở vòng sau
+                    e->nextProbeAt = Clock::now();
+                    return false;
+                }
+                fs::rename(path, replayPath, ec);
+                if (ec) {
+                    OpenSync::Logger::error("❌ Cannot move quarantine hold file " + path + ": " + ec.message());
+                    ++e->probeAttempt;
+                    scheduleProbeLocked(*e);
+                    return false;
+                }
+            }
+            if (round == 0) {
+                OpenSync::Logger::info("🩺 Probing quarantined table " + tableKey + " by replaying " + replayPath);
+                MetricsExporter::getInstance().incrementCounter("table_quarantine_probes_total", {{"table", tableKey}});
+            }
+        }
+
+        // Ghi vào DB ngoài lock: writer vẫn append batch mới vào file hold (mới) trong lúc này
+        size_t applied = 0;
+        const bool ok = replayFile(tableKey, replayPath, apply, applied);
+        replayed += applied;
+
+        std::lock_guard<std::mutex> lock(e->mtx);
+        e->heldRows = e->heldRows > applied ? e->heldRows - applied : 0;
+        if (!ok) {
+            ++e->probeAttempt;
+            scheduleProbeLocked(*e);
+            OpenSync::Logger::warn("🚫 Table " + tableKey + " still failing after replaying " + std::to_string(replayed) +
+                                   " held rows, staying in quarantine");
+            return false;
+        }
+    }
+}
+
+bool TableHealthRegistry::replayFile(const std::string& tableKey, const std::string& path, const ApplyFn& apply,
+                                     size_t& replayed) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        OpenSync::Logger::error("❌ Cannot open quarantine replay file " + path);
+        return false;
+    }
+
+    TableBatch batch;
+    std::streamoff applied = 0;     // byte đầu tiên chưa ghi vào DB
+    bool ok = true;
+    std::string line;
+    while (ok) {
+        batch.sqls.clear();
+        batch.origins.clear();
+        std::streamoff chunkEnd = applied;
+        while (batch.sqls.size() < opts.replayBatchSize && std::getline(in, line)) {
+            // Dòng cuối không có '\n' → tellg() = -1 (eof)
+            const std::streamoff pos = in.tellg();
+            chunkEnd = pos >= 0 ? pos : chunkEnd + static_cast<std::streamoff>(line.size()) + 1;
+            rapidjson::Document doc;
+            doc.Parse(line.c_str(), line.size());
+            if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("sql") || !doc["sql"].IsString()) {
+                OpenSync::Logger::error("❌ Skipping malformed line in " + path);
+                continue;
+            }
+            RowOrigin origin;
+            if (doc.HasMember("partition") && doc["partition"].IsInt()) origin.partition = doc["partition"].GetInt();
+            if (doc.HasMember("offset") && doc["offset"].IsInt64()) origin.offset = doc["offset"].GetInt64();
+            batch.sqls.emplace_back(doc["sql"].GetString(), doc["sql"].GetStringLength());
+            batch.origins.push_back(origin);
+        }
+        if (batch.sqls.empty()) break;
+
+        ok = apply(tableKey, batch);
+        if (ok) {
+            applied = chunkEnd;
+            replayed += batch.sqls.size();
+        }
+    }
+    in.close();
+
+    std::error_code ec;
+    if (ok) {
+        fs::remove(path, ec);
+        return true;
+    }
+
+    // Bỏ phần đã ghi khỏi file để lần probe sau không ghi lại
+    if (applied > 0) {
+        const std::string tmpPath = path + ".tmp";
+        std::ifstream src(path, std::ios::binary);
+        std::ofstream dst(tmpPath, std::ios::binary | std::ios::trunc);
+        src.seekg(applied);
+        dst << src.rdbuf();
+        dst.close();
+        src.close();
+        if (dst) {
+            fs::rename(tmpPath, path, ec);
+        } else {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+        if (ec) OpenSync::Logger::error("❌ Cannot compact quarantine replay file " + path + ": " + ec.message());
+    }
+    return false;
+}
+
+TableHealthRegistry::State TableHealthRegistry::state(const std::string& tableKey) const {
+    Entry* e = find(tableKey);
+    if (!e) return State::HEALTHY;
+    std::lock_guard<std::mutex> lock(e->mtx);
+    return e->state;
+}
+
+const char* TableHealthRegistry::toString(State state) {
+    switch (state) {
+        case State::HEALTHY:     return "HEALTHY";
+        case State::DEGRADED:    return "DEGRADED";
+        case State::QUARANTINED: return "QUARANTINED";
+    }
+    return "UNKNOWN";
+}
+
+void TableHealthRegistry::reportMetrics() {
+    auto& metrics = MetricsExporter::getInstance();
+    std::lock_guard<std::mutex> lock(mapMutex);
+    for (auto& [tableKey, e] : entries) {
+        std::lock_guard<std::mutex> entryLock(e->mtx);
+        // 0 = HEALTHY, 1 = DEGRADED, 2 = QUARANTINED
+        metrics.setGauge("table_health_state", static_cast<double>(e->state), {{"table", tableKey}});
+        metrics.setGauge("table_quarantine_held_rows", static_cast<double>(e->heldRows), {{"table", tableKey}});
+    }
+    metrics.setGauge("tables_quarantined", static_cast<double>(quarantined.load(std::memory_order_relaxed)), {});
+}
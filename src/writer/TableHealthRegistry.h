@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../common/TableBatch.h"
+
+// Trạng thái sức khoẻ theo bảng, theo số lần ghi lỗi liên tiếp (lỗi không phải do DB down):
+// HEALTHY → DEGRADED (cảnh báo) → QUARANTINED. Batch lỗi được writer ghi lại (chưa tới ngưỡng) để không batch
+// nào của bảng vượt lên trước nó; tới ngưỡng thì chính batch đó vào file hold cục bộ (<hold_dir>/<bảng>.jsonl),
+// các batch sau của bảng append tiếp vào file và coi như đã xong → offset được commit, writer được giải phóng
+// cho bảng khác thay vì kẹt sau một bảng hỏng (thiếu bảng đích, mất quyền...).
+// Monitor định kỳ probe: ghi lại file hold theo thứ tự, hết file → HEALTHY, lỗi → thử lại sau (backoff).
+class TableHealthRegistry {
+public:
+    enum class State { HEALTHY, DEGRADED, QUARANTINED };
+    // Ghi đè từ filter config ("quarantine": "auto" | "on" | "off"), áp dụng lại mỗi lần reload
+    enum class Override { AUTO, FORCE_QUARANTINE, NEVER_QUARANTINE };
+    // Writer làm gì với batch vừa ghi lỗi
+    enum class FailureAction {
+        RETRY,      // chưa tới ngưỡng: ghi lại chính batch này sau backoff
+        HELD,       // batch đã vào file hold (bảng QUARANTINED): coi như đã ghi
+        GIVE_UP     // không giữ được (tắt quarantine / NEVER_QUARANTINE / lỗi file): batch lỗi, không commit
+    };
+    using Clock = std::chrono::steady_clock;
+    // Ghi một phần file hold vào DB (một lần thử, không chờ DB); false = bảng vẫn lỗi
+    using ApplyFn = std::function<bool(const std::string& tableKey, const TableBatch& batch)>;
+
+    struct Options {
+        int degradedAfterFailures = 2;
+        int quarantineAfterFailures = 5;
+        int probeIntervalSec = 30;
+        int maxProbeIntervalSec = 600;
+        size_t replayBatchSize = 1000;      // số SQL mỗi lần ghi khi probe
+    };
+
+    static TableHealthRegistry& getInstance();
+
+    // Gọi trước khi start DB writer; chưa configure thì không bảng nào bị quarantine
+    void configure(const std::string& holdDir, const Options& options);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Batch của bảng ghi thành công (finishApplyTask)
+    void recordSuccess(const std::string& tableKey);
+    // Batch ghi lỗi sau khi đã cô lập row lỗi (lỗi tạm thời của DB đã được retry trong WriteDataToDB)
+    FailureAction recordFailure(const std::string& tableKey, const TableBatch& batch);
+    // Bảng đang quarantine: append batch vào file hold, true = batch đã được giữ (không ghi vào DB).
+    // false = ghi vào DB như bình thường
+    bool divert(const std::string& tableKey, const TableBatch& batch);
+
+    // tableKey → override; bảng không có trong map trở về AUTO
+    void setOverrides(const std::unordered_map<std::string, Override>& overrides);
+    static Override parseOverride(const std::string& value);
+
+    // Bảng quarantine đã tới lượt probe (không tính bảng bị FORCE_QUARANTINE)
+    std::vector<std::string> dueForProbe(Clock::time_point now);
+    // Ghi lại file hold của bảng qua apply theo từng phần replayBatchSize SQL; hết file → HEALTHY.
+    // File hold được đổi tên sang <file>.replay và ghi lại ngoài lock: divert không chờ DB trong lúc probe
+    bool probe(const std::string& tableKey, const ApplyFn& apply);
+
+    State state(const std::string& tableKey) const;
+    static const char* toString(State state);
+    void reportMetrics();
+
+private:
+    struct Entry {
+        std::mutex mtx;                     // trạng thái + file hold (không giữ trong lúc ghi vào DB)
+        State state = State::HEALTHY;
+        Override override = Override::AUTO;
+        int consecutiveFailures = 0;
+        int probeAttempt = 0;
+        size_t heldRows = 0;
+        Clock::time_point nextProbeAt{};
+    };
+
+    static constexpr int MAX_PROBE_ROUNDS = 8;      // vòng .replay liên tiếp trong một lần probe (dữ liệu mới vẫn vào)
+
+    TableHealthRegistry() = default;
+
+    Entry& entry(const std::string& tableKey);
+    Entry* find(const std::string& tableKey) const;
+    std::string holdPath(const std::string& tableKey) const;
+    bool appendLocked(const std::string& tableKey, Entry& e, const TableBatch& batch);
+    // Ghi lại file (không giữ lock); applied = số row đã ghi. Lỗi: bỏ phần đã ghi khỏi file
+    bool replayFile(const std::string& tableKey, const std::string& path, const ApplyFn& apply, size_t& applied);
+    void quarantineLocked(const std::string& tableKey, Entry& e, const std::string& reason);
+    void recoverLocked(const std::string& tableKey, Entry& e);
+    void scheduleProbeLocked(Entry& e);
+
+    mutable std::mutex mapMutex;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+    std::unordered_map<std::string, Override> overrides;
+    std::string holdDir;
+    Options opts;
+    std::atomic<bool> enabled{false};
+    std::atomic<int> quarantined{0};        // fast path cho divert khi không bảng nào bị quarantine
+};
@@ -1,34 +1,201 @@
 #include "WriteDataToDB.h"
 #include "../logger/Logger.h"
+#include "DeadLetterStore.h"
+#include "TableHealthRegistry.h"
 #include "MetricsExporter.h"
 #include "../db/oracle/OracleConnector.h"
 #include "../sqlbuilder/PostgreSQLSQLBuilder.h"
 #include <malloc.h>
+#include <chrono>
 
 WriteDataToDB::WriteDataToDB() {}
 
 WriteDataToDB::~WriteDataToDB() {
-    dbConnectorPools.clear();
+    stopRetries();
+    if (reconnectThread.joinable()) reconnectThread.join();
+    if (probeThread.joinable()) probeThread.join();
+    connectionPools.clear();
+    circuitBreakers.clear();
     tableSQLBuffer.clear();
 }
 
+namespace {
+// Connection mỗi DB writer thread đang giữ. Tra cứu thread_local thay cho map<thread::id> dưới lock chung;
+// khi thread kết thúc connection quay về pool (weak_ptr: pool có thể đã bị huỷ trước).
+struct ThreadLease {
+    const WriteDataToDB* owner = nullptr;
+    std::string dbType;
+    std::weak_ptr<ConnectionPool> pool;
+    std::unique_ptr<DBConnector> connector;
+    std::chrono::steady_clock::time_point lastChecked;
+};
+
+struct ThreadLeases {
+    std::vector<ThreadLease> leases;
+    ~ThreadLeases() {
+        for (auto& lease : leases) {
+            if (auto pool = lease.pool.lock()) pool->release(std::move(lease.connector));
+        }
+    }
+};
+
+thread_local ThreadLeases threadLeases;
+}
+
+void WriteDataToDB::setConnectionPoolOptions(const ConnectionPool::Options& options) {
+    poolOptions = options;
+}
+
+void WriteDataToDB::setRetryOptions(const RetryOptions& options) {
+    retryOptions = options;
+}
+
+void WriteDataToDB::setCircuitBreakerOptions(const CircuitBreaker::Options& options) {
+    breakerOptions = options;
+}
+
 void WriteDataToDB::addDatabaseConnectorFactory(const std::string& dbType, std::function<std::unique_ptr<DBConnector>()> factory) {
-    connectorFactories[dbType] = std::move(factory);
+    {
+        std::lock_guard<std::mutex> lock(connectorPoolMutex);
+        connectionPools[dbType] = std::make_shared<ConnectionPool>(dbType, std::move(factory), poolOptions);
+        circuitBreakers[dbType] = std::make_shared<CircuitBreaker>(dbType, breakerOptions);
+    }
+    if (!reconnectThread.joinable()) reconnectThread = std::thread(&WriteDataToDB::reconnectLoop, this);
 }
 
-DBConnector* WriteDataToDB::getConnectorForThread(const std::string& dbType) {
-    std::thread::id threadId = std::this_thread::get_id();
+std::shared_ptr<ConnectionPool> WriteDataToDB::findPool(const std::string& dbType) const {
+    std::lock_guard<std::mutex> lock(connectorPoolMutex);
+    auto it = connectionPools.find(dbType);
+    return it != connectionPools.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<CircuitBreaker> WriteDataToDB::findCircuitBreaker(const std::string& dbType) const {
     std::lock_guard<std::mutex> lock(connectorPoolMutex);
+    auto it = circuitBreakers.find(dbType);
+    return it != circuitBreakers.end() ? it->second : nullptr;
+}
+
+void WriteDataToDB::stopRetries() {
+    std::vector<std::shared_ptr<CircuitBreaker>> breakers;
+    {
+        std::lock_guard<std::mutex> lock(connectorPoolMutex);
+        for (const auto& [dbType, breaker] : circuitBreakers) breakers.push_back(breaker);
+    }
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex);
+        stopping.store(true, std::memory_order_relaxed);
+    }
+    reconnectCv.notify_all();
+    for (auto& breaker : breakers) breaker->stop();
+}
+
+void WriteDataToDB::reconnectLoop() {
+    std::unique_lock<std::mutex> lock(reconnectMutex);
+    while (!stopping.load(std::memory_order_relaxed)) {
+        reconnectCv.wait_for(lock, std::chrono::milliseconds(200));
+        if (stopping.load(std::memory_order_relaxed)) break;
+        lock.unlock();
+
+        std::vector<std::pair<std::shared_ptr<ConnectionPool>, std::shared_ptr<CircuitBreaker>>> targets;
+        {
+            std::lock_guard<std::mutex> poolLock(connectorPoolMutex);
+            for (const auto& [dbType, breaker] : circuitBreakers) {
+                auto pool = connectionPools.find(dbType);
+                if (pool != connectionPools.end()) targets.emplace_back(pool->second, breaker);
+            }
+        }
 
-    auto& threadMap = dbConnectorPools[dbType];
-    if (threadMap.find(threadId) == threadMap.end()) {
-        if (connectorFactories.find(dbType) == connectorFactories.end()) {
+        // Chỉ thread này connect lại trong lúc DB down, writer không tự connect → không dồn reconnect khi failover
+        const auto now = CircuitBreaker::Clock::now();
+        for (auto& [pool, breaker] : targets) {
+            if (!breaker->probeDue(now)) continue;
+            MetricsExporter::getInstance().incrementCounter("db_reconnect_attempts_total", {{"db_type", pool->type()}});
+            if (pool->recover()) {
+                breaker->probeSucceeded();
+            } else {
+                breaker->probeFailed();
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+void WriteDataToDB::dropConnectorForThread(const std::string& dbType) {
+    for (auto& lease : threadLeases.leases) {
+        if (lease.owner != this || lease.dbType != dbType || !lease.connector) continue;
+        if (auto pool = lease.pool.lock()) {
+            pool->release(std::move(lease.connector), false);
+        } else {
+            lease.connector.reset();
+        }
+    }
+}
+
+DBConnector* WriteDataToDB::getConnectorForThread(const std::string& dbType) {
+    ThreadLease* lease = nullptr;
+    for (auto& candidate : threadLeases.leases) {
+        if (candidate.owner == this && candidate.dbType == dbType) {
+            lease = &candidate;
+            break;
+        }
+    }
+
+    if (!lease) {
+        auto pool = findPool(dbType);
+        if (!pool) {
             OpenSync::Logger::error("No factory registered for DB type: " + dbType);
             return nullptr;
         }
-        threadMap[threadId] = connectorFactories[dbType]();
+        threadLeases.leases.push_back({this, dbType, pool, nullptr, {}});
+        lease = &threadLeases.leases.back();
+    }
+
+    auto pool = lease->pool.lock();
+    if (!pool) return nullptr;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (lease->connector) {
+        // Connection đứt (failover) hoặc lâu chưa kiểm tra mà ping thất bại → bỏ, lấy connection khác từ pool
+        bool alive = lease->connector->isConnected();
+        if (alive && now - lease->lastChecked >= std::chrono::seconds(pool->options().healthCheckIntervalSec)) {
+            alive = lease->connector->ping();
+            lease->lastChecked = now;
+        }
+        if (!alive) {
+            OpenSync::Logger::warn("⚠️ Dropping broken " + dbType + " connection of this writer thread");
+            pool->release(std::move(lease->connector), false);
+        }
+    }
+
+    if (!lease->connector) {
+        lease->connector = pool->acquire();
+        lease->lastChecked = now;
+    }
+    return lease->connector.get();
+}
+
+size_t WriteDataToDB::warmUpConnections(const std::string& dbType, size_t count) {
+    auto pool = findPool(dbType);
+    return pool ? pool->warmUp(count) : 0;
+}
+
+void WriteDataToDB::maintainConnectionPools() {
+    std::vector<std::shared_ptr<ConnectionPool>> pools;
+    {
+        std::lock_guard<std::mutex> lock(connectorPoolMutex);
+        for (const auto& [dbType, pool] : connectionPools) pools.push_back(pool);
     }
-    return threadMap[threadId].get();
+    for (auto& pool : pools) pool->maintain();
+}
+
+void WriteDataToDB::reportCircuitBreakerMetrics() {
+    std::vector<std::shared_ptr<CircuitBreaker>> breakers;
+    {
+        std::lock_guard<std::mutex> lock(connectorPoolMutex);
+        for (const auto& [dbType, breaker] : circuitBreakers) breakers.push_back(breaker);
+    }
+    for (const auto& breaker : breakers) breaker->reportMetrics();
 }
 
 size_t WriteDataToDB::estimateMemoryUsage() const {
@@ -69,16 +236,58 @@ bool WriteDataToDB::writeToDB(const std::string& dbType, const std::vector<std::
 
 bool WriteDataToDB::writeBatchToDB(const std::string& dbType,
                                    const std::vector<std::string>& sqlBatch,
-                                   const std::string& tableKey) {
-    DBConnector* dbConnector = getConnectorForThread(dbType);
-    if (!dbConnector) return false;
+                                   const std::string& tableKey,
+                                   DBExecResult* errorClassOut) {
+    auto breaker = findCircuitBreaker(dbType);
+    DBConnector* dbConnector = nullptr;
+    bool result = false;
+    if (errorClassOut) *errorClassOut = DBExecResult::CONNECTION_LOST;
+
+    // Lỗi tạm thời: trả connection hỏng về pool, chờ backoff rồi ghi lại cả batch. Lỗi liên tiếp → breaker OPEN,
+    // writer chờ trong acquire() (batch vẫn giữ, offset chưa commit) tới khi thread nền reconnect được
+    for (int attempt = 0;; ++attempt) {
+        if (breaker && !breaker->acquire()) {
+            OpenSync::Logger::error("❌ " + dbType + " unavailable during shutdown, batch of " + tableKey + " not written");
+            return false;
+        }
 
-    if (!dbConnector->isConnected() && !dbConnector->connect()) {
-        OpenSync::Logger::error("Failed to connect to " + dbType);
-        return false;
-    }
+        dbConnector = getConnectorForThread(dbType);
+        DBExecResult errorClass = DBExecResult::CONNECTION_LOST;
+        std::string error = "no connection available";
+        if (dbConnector && (dbConnector->isConnected() || dbConnector->connect())) {
+            result = dbConnector->executeBatchQuery(sqlBatch);
+            errorClass = result ? DBExecResult::SUCCESS : dbConnector->getLastErrorClass();
+            error = dbConnector->getLastError();
+        } else {
+            OpenSync::Logger::error("Failed to connect to " + dbType);
+        }
+        if (errorClassOut) *errorClassOut = errorClass;
 
-    bool result = dbConnector->executeBatchQuery(sqlBatch);
+        if (result || !DBExceptionHelper::isTransient(errorClass)) {
+            if (breaker) breaker->recordSuccess();
+            break;
+        }
+
+        if (breaker) breaker->recordFailure(errorClass, error);
+        dropConnectorForThread(dbType);
+        dbConnector = nullptr;
+        MetricsExporter::getInstance().incrementCounter("db_write_retries_total",
+            {{"db_type", dbType}, {"error", DBExceptionHelper::toString(errorClass)}});
+
+        if (stopping.load(std::memory_order_relaxed) ||
+            (retryOptions.maxAttempts > 0 && attempt + 1 >= retryOptions.maxAttempts)) {
+            OpenSync::Logger::error("❌ Giving up on batch of " + tableKey + " after " + std::to_string(attempt + 1) +
+                                    " attempts: " + error);
+            return false;
+        }
+
+        const auto delay = CircuitBreaker::backoff(attempt, retryOptions.baseDelayMs, retryOptions.maxDelayMs);
+        OpenSync::Logger::warn("🔁 Transient " + dbType + " error on " + tableKey + " (" +
+                               DBExceptionHelper::toString(errorClass) + "), retry " + std::to_string(attempt + 1) +
+                               " in " + std::to_string(delay.count()) + " ms: " + error);
+        std::unique_lock<std::mutex> lock(reconnectMutex);
+        reconnectCv.wait_for(lock, delay, [this]() { return stopping.load(std::memory_order_relaxed); });
+    }
 
     // Nếu thất bại với PostgreSQL do duplicate key thì thử fallback sang UPSERT
     if (!result && dbType == "postgresql") {
@@ -118,6 +327,126 @@ bool WriteDataToDB::writeBatchToDB(const std::string& dbType,
     return result;
 }
 
+bool WriteDataToDB::writeBatchOnce(const std::string& dbType, const std::vector<std::string>& sqlBatch,
+                                   const std::string& tableKey, DBExecResult* errorClassOut) {
+    *errorClassOut = DBExecResult::CONNECTION_LOST;
+    auto breaker = findCircuitBreaker(dbType);
+    // Probe không chiếm lượt ghi thử HALF_OPEN của writer, cũng không chờ trong acquire()
+    if (breaker && breaker->state() != CircuitBreaker::State::CLOSED) return false;
+
+    DBConnector* dbConnector = getConnectorForThread(dbType);
+    if (!dbConnector || !(dbConnector->isConnected() || dbConnector->connect())) {
+        OpenSync::Logger::error("Failed to connect to " + dbType + " for " + tableKey);
+        return false;
+    }
+    if (dbConnector->executeBatchQuery(sqlBatch)) {
+        *errorClassOut = DBExecResult::SUCCESS;
+        if (breaker) breaker->recordSuccess();
+        return true;
+    }
+
+    *errorClassOut = dbConnector->getLastErrorClass();
+    if (DBExceptionHelper::isTransient(*errorClassOut)) {
+        if (breaker) breaker->recordFailure(*errorClassOut, dbConnector->getLastError());
+        dropConnectorForThread(dbType);
+    }
+    return false;
+}
+
+bool WriteDataToDB::waitBeforeRetry(std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> lock(reconnectMutex);
+    return !reconnectCv.wait_for(lock, delay, [this]() { return stopping.load(std::memory_order_relaxed); });
+}
+
+bool WriteDataToDB::isolateFailedRows(const std::string& dbType, const TableBatch& batch, const std::string& tableKey,
+                                      DBExecResult firstError) {
+    // errorClass do writeBatchToDB trả về, không đọc getLastErrorClass(): khi không có statement nào chạy
+    // (mất connection, breaker từ chối) giá trị đó còn là lỗi của batch trước.
+    // Lỗi tạm thời: ghi lại cả batch sau. Lỗi schema: mọi row đều lỗi, chia đôi chỉ đẩy cả bảng vào dead-letter
+    if (firstError == DBExecResult::SUCCESS || DBExceptionHelper::isTransient(firstError) ||
+        firstError == DBExecResult::SCHEMA_MISMATCH) {
+        return false;
+    }
+    DBConnector* dbConnector = getConnectorForThread(dbType);
+    if (!dbConnector || batch.sqls.empty() || !DeadLetterStore::getInstance().isEnabled()) return false;
+
+    OpenSync::Logger::warn("🪓 Bisecting failed batch of " + tableKey + " (" + std::to_string(batch.sqls.size()) +
+                           " statements, " + DBExceptionHelper::toString(firstError) + ")");
+    MetricsExporter::getInstance().incrementCounter("batch_bisect_total", {{"table", tableKey}});
+
+    size_t roundTrips = 0;
+    size_t isolated = 0;
+    std::vector<std::string> slice;
+
+    // [begin, end) đã biết là lỗi: một statement → dead-letter; nhiều hơn → ghi lại từng nửa theo thứ tự,
+    // nửa nào lỗi thì chia tiếp. Nửa thành công đã commit.
+    std::function<bool(size_t, size_t, DBExecResult, const std::string&)> bisect =
+        [&](size_t begin, size_t end, DBExecResult errorClass, const std::string& error) -> bool {
+            if (end - begin == 1) {
+                const RowOrigin origin = begin < batch.origins.size() ? batch.origins[begin] : RowOrigin{};
+                if (!DeadLetterStore::getInstance().write(tableKey, origin, batch.sqls[begin], errorClass, error)) return false;
+                ++isolated;
+                return true;
+            }
+
+            const size_t mid = begin + (end - begin) / 2;
+            for (const auto& [lo, hi] : {std::make_pair(begin, mid), std::make_pair(mid, end)}) {
+                slice.assign(batch.sqls.begin() + static_cast<std::ptrdiff_t>(lo), batch.sqls.begin() + static_cast<std::ptrdiff_t>(hi));
+                ++roundTrips;
+                if (dbConnector->executeBatchQuery(slice)) continue;
+
+                const DBExecResult halfError = dbConnector->getLastErrorClass();
+                if (DBExceptionHelper::isTransient(halfError)) return false;
+                if (!bisect(lo, hi, halfError, dbConnector->getLastError())) return false;
+            }
+            return true;
+        };
+
+    const bool done = bisect(0, batch.sqls.size(), firstError, dbConnector->getLastError());
+
+    MetricsExporter::getInstance().incrementCounter("batch_bisect_round_trips_total", {{"table", tableKey}},
+                                                    static_cast<int>(roundTrips));
+    if (done) {
+        OpenSync::Logger::warn("🪓 Isolated " + std::to_string(isolated) + " failing row(s) of " + tableKey + " in " +
+                               std::to_string(roundTrips) + " round trips, rest of the batch applied");
+    } else {
+        OpenSync::Logger::error("❌ Bisect of " + tableKey + " aborted after " + std::to_string(roundTrips) +
+                                " round trips, batch will not be committed");
+    }
+    return done;
+}
+
+void WriteDataToDB::probeQuarantinedTables(const std::string& dbType) {
+    auto& registry = TableHealthRegistry::getInstance();
+    // DB down: probe chỉ chờ circuit breaker, lỗi không phải của bảng
+    if (CircuitBreaker::anyOpen()) return;
+
+    for (const auto& tableKey : registry.dueForProbe(std::chrono::steady_clock::now())) {
+        registry.probe(tableKey, [this, &dbType](const std::string& key, const TableBatch& batch) {
+            DBExecResult errorClass = DBExecResult::SUCCESS;
+            return writeBatchOnce(dbType, batch.sqls, key, &errorClass) ||
+                   isolateFailedRows(dbType, batch, key, errorClass);
+        });
+    }
+}
+
+void WriteDataToDB::startQuarantineProbes(const std::string& dbType, std::chrono::milliseconds pollInterval) {
+    if (probeThread.joinable()) return;
+    probeThread = std::thread(&WriteDataToDB::quarantineProbeLoop, this, dbType, pollInterval);
+}
+
+void WriteDataToDB::quarantineProbeLoop(std::string dbType, std::chrono::milliseconds pollInterval) {
+    std::unique_lock<std::mutex> lock(reconnectMutex);
+    while (!stopping.load(std::memory_order_relaxed)) {
+        reconnectCv.wait_for(lock, pollInterval, [this]() { return stopping.load(std::memory_order_relaxed); });
+        if (stopping.load(std::memory_order_relaxed)) break;
+        lock.unlock();
+        // Connection của probe là lease thread_local của thread này, trả về pool khi thread kết thúc
+        probeQuarantinedTables(dbType);
+        lock.lock();
+    }
+}
+
 /*
 bool WriteDataToDB::writeBatchToDB(const std::string& dbType,
                                    const std::vector<std::string>& sqlBatch,
@@ -172,19 +501,12 @@ bool WriteDataToDB::writeBatchToDB(const std::string& dbType,
 }
 */
 std::unique_ptr<DBConnector> WriteDataToDB::cloneConnector(const std::string& dbType) {
-    if (connectorFactories.find(dbType) == connectorFactories.end()) {
+    auto pool = findPool(dbType);
+    if (!pool) {
         OpenSync::Logger::error("Cannot clone: No factory registered for DB type " + dbType);
         return nullptr;
     }
-    return connectorFactories[dbType]();
-}
-
-std::mutex& WriteDataToDB::getTableMutex(const std::string& tableKey) {
-    std::lock_guard<std::mutex> lock(mutexMapLock);
-    if (tableMutexMap.find(tableKey) == tableMutexMap.end()) {
-        OpenSync::Logger::info("🧵 Creating mutex for table: " + tableKey);
-    }
-    return tableMutexMap[tableKey];
+    return pool->create();
 }
 
 void WriteDataToDB::reportTableSQLBufferMetrics() {
@@ -228,12 +550,11 @@ std::unordered_map<std::string, std::vector<std::string>> WriteDataToDB::drainTa
 }
 
 void WriteDataToDB::reportMemoryUsagePerDBType() {
-    std::lock_guard<std::mutex> lock(connectorPoolMutex);
-    for (const auto& [dbType, threadMap] : dbConnectorPools) {
-        size_t count = threadMap.size();
-        MetricsExporter::getInstance().setGauge("db_connector_pool_size", count, {
-            {"db_type", dbType}
-        });
+    std::vector<std::shared_ptr<ConnectionPool>> pools;
+    {
+        std::lock_guard<std::mutex> lock(connectorPoolMutex);
+        for (const auto& [dbType, pool] : connectionPools) pools.push_back(pool);
     }
+    for (auto& pool : pools) pool->reportMetrics();
 }
 
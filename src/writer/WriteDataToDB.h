@@ -2,6 +2,9 @@
 #define WRITEDATATODB_H
 
 #include "../db/DBConnector.h"
+#include "ConnectionPool.h"
+#include "CircuitBreaker.h"
+#include "../common/TableBatch.h"
 #include "map"
 #include "unordered_map"
 #include "mutex"
@@ -11,21 +14,60 @@
 #include "string"
 #include "functional"
 #include "queue"
+#include "atomic"
+#include "condition_variable"
 
 class WriteDataToDB {
 public:
+    // Ghi lại batch khi lỗi tạm thời (CONNECTION_LOST / TIMEOUT), backoff tăng dần có jitter
+    struct RetryOptions {
+        int baseDelayMs = 100;
+        int maxDelayMs = 10000;
+        int maxAttempts = 0;    // 0 = tới khi thành công hoặc shutdown (batch không bị bỏ khi DB failover)
+    };
+
     WriteDataToDB();
     ~WriteDataToDB();
 
+    // Gọi trước addDatabaseConnectorFactory: áp dụng cho pool / circuit breaker tạo sau đó
+    void setConnectionPoolOptions(const ConnectionPool::Options& options);
+    void setRetryOptions(const RetryOptions& options);
+    const RetryOptions& getRetryOptions() const { return retryOptions; }
+    void setCircuitBreakerOptions(const CircuitBreaker::Options& options);
+    // Shutdown: writer đang chờ circuit breaker / backoff được thả ra, batch còn lại chỉ ghi thử một lần
+    void stopRetries();
     void addDatabaseConnectorFactory(const std::string& dbType, std::function<std::unique_ptr<DBConnector>()> factory);
+    // Breaker dùng chung của db type (AsyncPgWriter ghi nhận lỗi vào cùng breaker); nullptr nếu chưa đăng ký
+    std::shared_ptr<CircuitBreaker> findCircuitBreaker(const std::string& dbType) const;
+    // Connection lease theo thread (thread_local, không lock); trả về pool khi thread kết thúc
     DBConnector* getConnectorForThread(const std::string& dbType);
+    size_t warmUpConnections(const std::string& dbType, size_t count);
+    void maintainConnectionPools();
+    void reportCircuitBreakerMetrics();
     std::unique_ptr<DBConnector> cloneConnector(const std::string& dbType);
 
     bool writeToDB(const std::string& dbType, const std::vector<std::string>& sqlQueries);
     bool writeBatchToDB(const std::string& dbType, const std::vector<std::string>& sqlBatch);
-    bool writeBatchToDB(const std::string& dbType, const std::vector<std::string>& sqlBatch, const std::string& tableKey);
-
-    std::mutex& getTableMutex(const std::string& tableKey);
+    // errorClass (nếu có): lỗi của lần ghi cuối; CONNECTION_LOST khi không chạy được statement nào
+    // (không có connection, breaker từ chối lúc shutdown)
+    bool writeBatchToDB(const std::string& dbType, const std::vector<std::string>& sqlBatch, const std::string& tableKey,
+                        DBExecResult* errorClass = nullptr);
+    // Một lần thử, không chờ breaker (probe của bảng quarantine): false ngay nếu breaker không CLOSED
+    bool writeBatchOnce(const std::string& dbType, const std::vector<std::string>& sqlBatch, const std::string& tableKey,
+                        DBExecResult* errorClass);
+    // Chờ trước lần ghi lại kế tiếp; false nếu đang shutdown
+    bool waitBeforeRetry(std::chrono::milliseconds delay);
+    // Sau khi writeBatchToDB lỗi với errorClass: chia đôi batch và ghi lại từng nửa tới khi cô lập được row lỗi
+    // (O(log n) round trip mỗi row), row lỗi → DeadLetterStore, phần còn lại được ghi.
+    // false nếu lỗi không phải của statement (tạm thời: connection / timeout), lỗi schema
+    // hoặc không ghi được dead-letter
+    bool isolateFailedRows(const std::string& dbType, const TableBatch& batch, const std::string& tableKey,
+                           DBExecResult errorClass);
+    // Ghi lại file hold của các bảng quarantine đã tới lượt probe (TableHealthRegistry)
+    void probeQuarantinedTables(const std::string& dbType);
+    // Thread riêng gọi probeQuarantinedTables mỗi pollInterval: replay file hold lớn / DB chậm không chặn monitor.
+    // Dừng cùng stopRetries()
+    void startQuarantineProbes(const std::string& dbType, std::chrono::milliseconds pollInterval);
 
     // 🔢 Table SQL Buffer APIs
     void addToTableSQLBuffer(const std::string& tableKey, const std::string& sql);
@@ -39,12 +81,25 @@ public:
     size_t getActiveTableCount() const;
 
 private:
-    std::map<std::string, std::function<std::unique_ptr<DBConnector>()>> connectorFactories;
-    std::map<std::string, std::map<std::thread::id, std::unique_ptr<DBConnector>>> dbConnectorPools;
-    std::mutex connectorPoolMutex;
+    std::shared_ptr<ConnectionPool> findPool(const std::string& dbType) const;
+    // Trả connection của thread về pool như connection hỏng (thread lấy connection khác ở lần ghi sau)
+    void dropConnectorForThread(const std::string& dbType);
+    // Thread nền: breaker OPEN tới lượt thử → ConnectionPool::recover(), thành công thì HALF_OPEN
+    void reconnectLoop();
+    void quarantineProbeLoop(std::string dbType, std::chrono::milliseconds pollInterval);
+
+    ConnectionPool::Options poolOptions;
+    RetryOptions retryOptions;
+    CircuitBreaker::Options breakerOptions;
+    std::map<std::string, std::shared_ptr<ConnectionPool>> connectionPools;
+    std::map<std::string, std::shared_ptr<CircuitBreaker>> circuitBreakers;
+    mutable std::mutex connectorPoolMutex;
 
-    std::unordered_map<std::string, std::mutex> tableMutexMap;
-    std::mutex mutexMapLock;
+    std::atomic<bool> stopping{false};
+    std::mutex reconnectMutex;
+    std::condition_variable reconnectCv;
+    std::thread reconnectThread;
+    std::thread probeThread;
 
     //SQL buffer per table
     //std::unordered_map<std::string, std::vector<std::string>> tableSQLBuffer;